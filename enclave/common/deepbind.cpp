@@ -38,6 +38,11 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 deepbind::deepbind() {}
 
+void deepbind::clear() {
+    modelids.clear();
+    models.clear();
+}
+
 void deepbind::addModelID(model_id_t modelid) {
     modelids.push_back(modelid);
 }
@@ -61,66 +66,53 @@ size_t deepbind::getModelCount() {
 /* The base2index table is used to:
    Convert chars 'A','C','G','T'/'U' to integers 0,1,2,3 respectively.
    Convert char 'N' to UNKNOWN_BASE.
-   Convert anything else to INVALID_BASE. */
+   Convert anything else to INVALID_BASE.
+   Lower case letters are converted like their upper case forms. */
+
+const signed char deepbind::base2code[256] = {
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1,  0, -1,  1, -1, -1, -1,  2, -1, -1, -1, -1, -1, -1,  4, -1,
+	-1, -1, -1, -1,  3,  3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1,  0, -1,  1, -1, -1, -1,  2, -1, -1, -1, -1, -1, -1,  4, -1,
+	-1, -1, -1, -1,  3,  3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
 
 int deepbind::base2index(unsigned char c)
 {
-
-    switch(c) {
-        case 'a':
-        case 'A':
-            return 0;
-
-        case 'c':
-        case 'C':
-            return 1;
-
-        case 'g':
-        case 'G':
-            return 2;
-        
-        case 't':
-        case 'T':
-        case 'u':
-        case 'U':
-            return 3;
-
-        case 'n':
-        case 'N':
-            return UNKNOWN_BASE;
-        
-    }
-    return INVALID_BASE;
-	
+	return base2code[c];
 }
 
-/* The base2comp table is used to:
-   Convert chars ACGT to their complements TGCA.
-   U is converted to A, and A is always converted to T.
-   N is converted to N.
-*/
-
-void deepbind::init_base2comp_table()
+/* Convert a sequence of chars to the index encoding used by the models.
+   Invalid chars are treated as UNKNOWN_BASE; callers validate beforehand. */
+void deepbind::encode_seq(const unsigned char* seq, size_t seqlen, unsigned char* codes)
 {
-	memset(base2comp, '\0', 256);
-	base2comp[(unsigned char)'a'] = base2comp[(unsigned char)'A'] = 'T';
-	base2comp[(unsigned char)'c'] = base2comp[(unsigned char)'C'] = 'G';
-	base2comp[(unsigned char)'g'] = base2comp[(unsigned char)'G'] = 'C';
-	base2comp[(unsigned char)'t'] = base2comp[(unsigned char)'T'] = 'A';
-	base2comp[(unsigned char)'u'] = base2comp[(unsigned char)'U'] = 'A';
-	base2comp[(unsigned char)'n'] = base2comp[(unsigned char)'N'] = 'N';
+	size_t i;
+	for (i = 0; i < seqlen; ++i) {
+		int index = base2code[seq[i]];
+		codes[i] = (unsigned char)(index == INVALID_BASE ? UNKNOWN_BASE : index);
+	}
 }
 
 
-/* Reverse complement a string in-place */
-void deepbind::reverse_complement(unsigned char* seq, size_t seqlen)
+/* Reverse complement an index encoded sequence into dst.
+   Complements of 0,1,2,3 (ACGT) are 3,2,1,0 (TGCA); UNKNOWN_BASE stays. */
+void deepbind::reverse_complement(const unsigned char* seq, unsigned char* dst, size_t seqlen)
 {
-	size_t i, j;
-	for (i = 0, j = seqlen - 1; i <= j; ++i, --j) {
-		unsigned char ci = (unsigned char)seq[i];
-		unsigned char cj = (unsigned char)seq[j];
-		seq[i] = (unsigned char) base2comp[cj];
-		seq[j] = (unsigned char) base2comp[ci];
+	size_t i;
+	for (i = 0; i < seqlen; ++i) {
+		unsigned char c = seq[seqlen - 1 - i];
+		dst[i] = (unsigned char)(c < 4 ? 3 - c : UNKNOWN_BASE);
 	}
 }
 
@@ -147,7 +139,7 @@ int deepbind::indexof_featuremap_coeff(int num_detector, int detector, int pos)
 }
 
 
-float deepbind::apply_model(deepbind_model_t* model, unsigned char* seq, int seq_len)
+float deepbind::apply_model(deepbind_model_t* model, const unsigned char* seq, int seq_len)
 {
 	int n = seq_len;
 	int m = model->detector_len;
@@ -175,8 +167,7 @@ float deepbind::apply_model(deepbind_model_t* model, unsigned char* seq, int seq
 			/* Convolve */
 			float featuremap_ik = 0;
 			for (j = 0; j < m; ++j) {
-				unsigned char c = ((i - m + 1) + j >= 0 && (i - m + 1) + j < n) ? seq[(i - m + 1) + j] : 'N';
-				int index = base2index(c);
+				int index = ((i - m + 1) + j >= 0 && (i - m + 1) + j < n) ? seq[(i - m + 1) + j] : UNKNOWN_BASE;
 				if (index == UNKNOWN_BASE) {
 					for (index = 0; index < 4; ++index){
                     	featuremap_ik += .25f * detectors[indexof_detector_coeff(d, k, j, index)];
@@ -252,7 +243,7 @@ float deepbind::apply_model(deepbind_model_t* model, unsigned char* seq, int seq
 }
 
 float deepbind::predict_seq(size_t modelindex, 
-                        unsigned char* seq, 
+                        const unsigned char* seq, 
                         size_t seqlen,
                         size_t window_size,
                         int average_flag) {
@@ -282,16 +273,39 @@ float deepbind::scan_model(size_t modelindex,
                             size_t seqlen,
                             size_t window_size,
                             int average_flag) {
+    vector<unsigned char> codes(seqlen);
+    encode_seq(seq, seqlen, codes.data());
+    return scan_encoded(modelindex, codes.data(), seqlen, window_size, average_flag);
+}
+
+/* Same as scan_model for a sequence already in the index encoding */
+float deepbind::scan_encoded(size_t modelindex, 
+                            const unsigned char* seq, 
+                            size_t seqlen,
+                            size_t window_size,
+                            int average_flag) {
     float score = predict_seq(modelindex, seq, seqlen, window_size, average_flag);
 
     deepbind_model_t model = getModel(modelindex);
     if (model.reverse_complement) {
         // Reverse complement also needs to be scored. Take the max. 
+        // The complement goes to a scratch copy so that the caller's
+        // sequence is left intact for the next model.
         float rscore;
-        reverse_complement(seq, seqlen);
-        rscore = predict_seq(modelindex, seq, seqlen, window_size, average_flag);
+        vector<unsigned char> rc(seqlen);
+        reverse_complement(seq, rc.data(), seqlen);
+        rscore = predict_seq(modelindex, rc.data(), seqlen, window_size, average_flag);
         if (rscore > score)
             score = rscore;
     }
     return score;
+}
+
+/* Applies a model to the whole of an encoded sequence as one window, without
+   the scan or the reverse complement; for ecall_benchmark */
+float deepbind::apply_encoded(size_t modelindex,
+                            const unsigned char* seq,
+                            size_t seqlen) {
+    deepbind_model_t model = getModel(modelindex);
+    return apply_model(&model, seq, (int)seqlen);
 }
\ No newline at end of file
@@ -11,35 +11,44 @@ class deepbind {
     private:
     vector<model_id_t> modelids;
     vector<deepbind_model_t> models;
-    char base2comp[256];
+    static const signed char base2code[256];
 
 
-    void reverse_complement(unsigned char* seq, size_t seqlen);
+    void reverse_complement(const unsigned char* seq, unsigned char* dst, size_t seqlen);
     int get_num_hidden1(deepbind_model_t* model);
     int get_num_hidden2(deepbind_model_t* model);
     int indexof_detector_coeff(int num_detector, int detector, int pos, int base);
     int indexof_featuremap_coeff(int num_detector, int detector, int pos);
-    float apply_model(deepbind_model_t* model, unsigned char* seq, int seq_len);
+    float apply_model(deepbind_model_t* model, const unsigned char* seq, int seq_len);
     float predict_seq(size_t modelindex, 
-                        unsigned char* seq, 
+                        const unsigned char* seq, 
                         size_t seqlen,
                         size_t window_size,
                         int average_flag);
 
     public:
     deepbind();
+    void clear();
     void addModelID(model_id_t modelid);
     model_id_t getModelID(size_t index);
     void addModelParams(deepbind_model_t model);
-    int base2index(unsigned char c);
+    static int base2index(unsigned char c);
     deepbind_model_t getModel(size_t index);
     size_t getModelCount();
 
-    void init_base2comp_table();
+    void encode_seq(const unsigned char* seq, size_t seqlen, unsigned char* codes);
     float scan_model(size_t modelindex, 
                             unsigned char* seq, 
                             size_t seqlen,
                             size_t window_size,
                             int average_flag);                 
+    float scan_encoded(size_t modelindex, 
+                            const unsigned char* seq, 
+                            size_t seqlen,
+                            size_t window_size,
+                            int average_flag);
+    float apply_encoded(size_t modelindex,
+                            const unsigned char* seq,
+                            size_t seqlen);
 
 };
\ No newline at end of file
@@ -1,178 +1,710 @@
-// Copyright (c) Open Enclave SDK contributors.
-// Licensed under the MIT License.
-
-#include <openenclave/enclave.h>
-
-#include "encryptor.h"
-#include "fileencryptor_t.h"
-#include "shared.h"
-#include "common/trace.h"
-#include <vector>
-
-// Declare a static dispatcher object for enabling for better organization
-// of enclave-wise global variables
-static ecall_dispatcher dispatcher;
-
-#include "deepbind.h"
-static deepbind dbmodel;
-
-int initialize_encryptor(
-    bool encrypt,
-    const char* password,
-    size_t password_len,
-    encryption_header_t* header)
-{
-    return dispatcher.initialize(encrypt, password, password_len, header);
-}
-
-int encrypt_block(
-    bool encrypt,
-    unsigned char* input_buf,
-    unsigned char* output_buf,
-    size_t size)
-{
-    return dispatcher.encrypt_block(encrypt, input_buf, output_buf, size);
-}
-
-void close_encryptor()
-{
-    return dispatcher.close();
-}
-
-/* DEFINITION OF ECALLS */
-
-size_t ecall_checkvalidseq(unsigned char* seq, size_t seqlen) {
-	size_t i;
-	if (seqlen == 0) {
-		// return false;
-    }
-	for (i = 0; i < seqlen; ++i) {
-		unsigned char base = seq[i];
-		if (dbmodel.base2index(base) == INVALID_BASE) {
-			return i;
-		}
-	}
-	// TRACE_ENCLAVE("valid sequence");
-	return 0;
-}
-
-void ecall_addIDtomodel(int major, int minor) {
-    model_id_t id = {major, minor};
-    dbmodel.addModelID(id);
-}
-
-model_id_t ecall_getdbmodelid(size_t index) {
-    model_id_t modelid;
-	modelid.major = dbmodel.getModelID(index).major;
-    modelid.minor = dbmodel.getModelID(index).minor;
-	return modelid;
-}
-
-void ecall_loadparams(deepbind_model_t model) {
-    dbmodel.addModelParams(model);
-}
-
-void ecall_initmodel() {
-	dbmodel.init_base2comp_table();
-}
-
-float ecall_scanmodel(size_t modelindex, 
-						unsigned char* seq, 
-						size_t seqlen,
-						size_t window_size,
-						int average_flag) {
-    
-	return dbmodel.scan_model(modelindex, seq, seqlen, window_size, average_flag);
-}
-
-int ecall_decryptpredict(unsigned char* inbuff, size_t size, bool eof, size_t paddingsize) {
-    unsigned char outbuff[MAX_SEQ_SIZE];
-	dispatcher.encrypt_block(false, inbuff, outbuff, size);
-	
-	if (eof)
-	{
-		size = paddingsize;
-		// TRACE_ENCLAVE("bytes to write = %i", size);
-		
-	}
-
-	// TRACE_ENCLAVE("outbuff is: \n%s", outbuff);
-    // parse decrypted outbuff, predict a score for each model
-    size_t bytesused = 0;
-    size_t seqstart = 0;
-	size_t seqlen = 0;
-	// int sequencecount = 0;
-	bool seqdetected = false;
-
-    while (bytesused < size) {
-		// TRACE_ENCLAVE("outbuff[bytesused] = %c", outbuff[bytesused]);
-        if (outbuff[bytesused] != '\n') {
-            if (dbmodel.base2index(outbuff[bytesused]) == INVALID_BASE) {
-                // whitespace - ignore
-                bytesused++;
-            } else {
-                // not whitespace, add to seq
-                seqlen++;
-                bytesused++;
-				seqdetected = true;
-            }
-        } else {
-            // New line indicates sequence is complete. Predict and print scores
-            // Check valid sequence
-			// TRACE_ENCLAVE("predicting sequence %i", ++sequencecount);
-            if (ecall_checkvalidseq(outbuff+seqstart, seqlen) != 0) {
-                return -1;
-            }
-
-            // Predict and print scores
-            size_t modelcount = dbmodel.getModelCount();
-			// TRACE_ENCLAVE("modelcount = %i", modelcount);
-            float score;
-            vector<float> scores;
-			// TRACE_ENCLAVE("seq = %s", outbuff+seqstart);
-			// TRACE_ENCLAVE("seqlen = %i", seqlen);
-            for (size_t i = 0; i < modelcount; i++) {
-                score = ecall_scanmodel(i, outbuff+seqstart, seqlen, 0, 0);
-                scores.push_back(score);
-				// TRACE_ENCLAVE("score %f", score);
-            }
-            float* scoresarray = &scores[0];
-            oe_result_t result;
-            result = hcall_printscores(scoresarray, modelcount);
-            if (result != OE_OK) {
-                return -2;
-            }
-            bytesused++;
-            seqstart = bytesused;
-			seqlen = 0;
-			seqdetected = false;
-        }
-    }
-    if (eof && seqdetected) {
-        // score remaining sequence, print and return
-        // Predict and print scores
-		// TRACE_ENCLAVE("eof true, predict rest of scores");
-		// TRACE_ENCLAVE("seq = %s", outbuff+seqstart);
-		// TRACE_ENCLAVE("seqstart, size = %i, %i", seqstart, size);
-        size_t modelcount = dbmodel.getModelCount();
-        float score;
-        vector<float> scores;
-        for (size_t i = 0; i < modelcount; i++) {
-            score = ecall_scanmodel(i, outbuff+seqstart, seqlen, 0, 0);
-            scores.push_back(score);
-			// TRACE_ENCLAVE("score %f", score);
-        }
-        float* scoresarray = &scores[0];
-        oe_result_t result;
-        result = hcall_printscores(scoresarray, modelcount);
-        if (result != OE_OK) {
-            return -2;
-        }
-        return 0;
-        
-    }
-    // return number of bytes unused given not end of encrypted file
-    return (int)seqlen;
-	// return 0;
-	
-}
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include <openenclave/enclave.h>
+
+#include "encryptor.h"
+#include "fileencryptor_t.h"
+#include "shared.h"
+#include "scorering.h"
+#include "common/trace.h"
+#include <mutex>
+#include <vector>
+
+// Declare a static dispatcher object for enabling for better organization
+// of enclave-wise global variables. It holds the password session, which all
+// encryptor sessions share.
+static ecall_dispatcher dispatcher;
+
+#include "deepbind.h"
+#include "framer.h"
+
+// Model sets, each its own list of models. Sets are created and loaded before
+// scoring starts and are only read afterwards, so scoring ecalls on several
+// threads can share them.
+static vector<deepbind*> modelsets;
+
+static deepbind* get_modelset(size_t modelset)
+{
+    return modelset < modelsets.size() ? modelsets[modelset] : nullptr;
+}
+
+// Files open at once; each streaming thread of the host holds one, so there
+// is no use for more than there are TCS
+#define MAX_ENCRYPTOR_SESSIONS 8
+
+// An encryptor session is one file being encrypted or decrypted, from
+// initialize_encryptor to close_encryptor. The host refers to it by its index
+// in sessions[].
+struct encryptor_session
+{
+    bool in_use;
+    bool busy; // an ecall is working on the session
+
+    file_cipher cipher;
+
+    // Enclave copy of the chunk currently being processed. Streaming ecalls
+    // take [user_check] host pointers, so each chunk is copied into EPC
+    // exactly once and never read from host memory again.
+    vector<unsigned char> chunkbuffer;
+
+    // Splits decrypted text into records across ecall_decryptpredict calls,
+    // which score them against scoring_set
+    record_framer framer;
+    deepbind* scoring_set;
+
+    // With seal_scores set, score rows collect in sealed_rows and leave the
+    // enclave sealed, a chunk at a time, instead of row by row in plaintext
+    bool seal_scores;
+    vector<float> sealed_rows;
+    size_t sealed_columns;
+    vector<unsigned char> seal_buffer;
+
+    // Record index of the file being decrypted, loaded by ecall_loadindex
+    // and kept until the session is closed (see shared.h)
+    vector<uint64_t> record_index;
+    size_t record_count;
+    size_t record_index_stride;
+    size_t record_index_entries;
+    size_t plaintext_size;
+};
+
+static encryptor_session sessions[MAX_ENCRYPTOR_SESSIONS];
+static std::mutex sessions_lock;
+
+// Claims an open session for the calling ecall. A session serves one ecall at
+// a time: a host that uses it from two threads at once gets an error instead
+// of racing on the cipher state.
+static encryptor_session* acquire_session(size_t session)
+{
+    std::lock_guard<std::mutex> lock(sessions_lock);
+    if (session >= MAX_ENCRYPTOR_SESSIONS || !sessions[session].in_use ||
+        sessions[session].busy)
+        return nullptr;
+    sessions[session].busy = true;
+    return &sessions[session];
+}
+
+static void release_session(encryptor_session* s)
+{
+    std::lock_guard<std::mutex> lock(sessions_lock);
+    s->busy = false;
+}
+
+// Returns a session to the table, dropping its buffers
+static void free_session(encryptor_session* s)
+{
+    vector<unsigned char>().swap(s->chunkbuffer);
+    vector<uint64_t>().swap(s->record_index);
+    s->framer.reset(false);
+    s->scoring_set = nullptr;
+    s->seal_scores = false;
+    vector<float>().swap(s->sealed_rows);
+    vector<unsigned char>().swap(s->seal_buffer);
+
+    std::lock_guard<std::mutex> lock(sessions_lock);
+    s->busy = false;
+    s->in_use = false;
+}
+
+// A [user_check] chunk must lie entirely outside the enclave and hold a whole
+// number of cipher blocks no larger than MAX_STREAM_CHUNK_SIZE.
+static bool is_valid_host_chunk(const void* buf, size_t size)
+{
+    return buf != nullptr && size > 0 && size <= MAX_STREAM_CHUNK_SIZE &&
+           size % CIPHER_BLOCK_SIZE == 0 && oe_is_outside_enclave(buf, size);
+}
+
+static unsigned char* copy_chunk_to_enclave(
+    encryptor_session* s,
+    const unsigned char* buf,
+    size_t size)
+{
+    if (s->chunkbuffer.size() < size)
+        s->chunkbuffer.resize(size);
+    memcpy(&s->chunkbuffer[0], buf, size);
+    return &s->chunkbuffer[0];
+}
+
+int open_session(
+    const char* password,
+    size_t password_len,
+    unsigned int kdf_iterations)
+{
+    return dispatcher.open_session(password, password_len, kdf_iterations);
+}
+
+void close_session()
+{
+    dispatcher.close_session();
+}
+
+int initialize_encryptor(
+    bool encrypt,
+    encryption_header_t* header,
+    size_t* session)
+{
+    encryptor_session* s = nullptr;
+    size_t i;
+    int ret;
+
+    if (header == nullptr || session == nullptr)
+        return 1;
+    {
+        std::lock_guard<std::mutex> lock(sessions_lock);
+        for (i = 0; i < MAX_ENCRYPTOR_SESSIONS; i++) {
+            if (!sessions[i].in_use) {
+                s = &sessions[i];
+                s->in_use = true;
+                s->busy = true;
+                break;
+            }
+        }
+    }
+    if (s == nullptr) {
+        TRACE_ENCLAVE("no free encryptor session");
+        return 1;
+    }
+
+    s->framer.reset(!encrypt && (header->flags & ENCRYPTION_FLAG_PACKED));
+    s->scoring_set = nullptr;
+    s->seal_scores = false;
+    s->sealed_rows.clear();
+    s->record_index.clear();
+    s->record_count = encrypt ? 0 : header->record_count;
+    s->record_index_stride = encrypt ? 0 : header->index_stride;
+    s->record_index_entries = encrypt ? 0 : header->index_entries;
+    s->plaintext_size = encrypt ? 0 : header->file_data_size;
+
+    ret = dispatcher.initialize(encrypt, header, &s->cipher);
+    if (ret != 0) {
+        free_session(s);
+        return ret;
+    }
+    *session = i;
+    release_session(s);
+    return 0;
+}
+
+int ecall_setiv(size_t session, const unsigned char* iv, size_t ivlen)
+{
+    encryptor_session* s = acquire_session(session);
+    if (s == nullptr)
+        return 1;
+    dispatcher.set_iv(&s->cipher, ivlen == IV_SIZE ? iv : nullptr);
+    release_session(s);
+    return 0;
+}
+
+int encrypt_block(
+    size_t session,
+    bool encrypt,
+    const unsigned char* input_buf,
+    unsigned char* output_buf,
+    size_t size)
+{
+    encryptor_session* s;
+    int ret;
+
+    if (!is_valid_host_chunk(input_buf, size) ||
+        !is_valid_host_chunk(output_buf, size))
+        return 1;
+    s = acquire_session(session);
+    if (s == nullptr)
+        return 1;
+
+    // The result is written straight back into the host buffer
+    unsigned char* chunk = copy_chunk_to_enclave(s, input_buf, size);
+    ret = dispatcher.encrypt_block(&s->cipher, encrypt, chunk, output_buf, size);
+    release_session(s);
+    return ret;
+}
+
+int ecall_finishmac(size_t session, unsigned char* mac, size_t macsize)
+{
+    encryptor_session* s;
+    int ret;
+
+    if (mac == nullptr || macsize != HASH_VALUE_SIZE_IN_BYTES)
+        return 1;
+    s = acquire_session(session);
+    if (s == nullptr)
+        return 1;
+    ret = dispatcher.finish_mac(&s->cipher, mac);
+    release_session(s);
+    return ret;
+}
+
+void close_encryptor(size_t session)
+{
+    encryptor_session* s = acquire_session(session);
+    if (s == nullptr)
+        return;
+    dispatcher.close(&s->cipher);
+    free_session(s);
+}
+
+int ecall_rekey(
+    const char* old_password,
+    size_t old_password_len,
+    encryption_header_t* header)
+{
+    if (header == nullptr)
+        return 1;
+    return dispatcher.rekey(old_password, old_password_len, header);
+}
+
+/* DEFINITION OF ECALLS */
+
+size_t ecall_checkvalidseq(unsigned char* seq, size_t seqlen) {
+	size_t i;
+	if (seqlen == 0) {
+		// return false;
+    }
+	for (i = 0; i < seqlen; ++i) {
+		unsigned char base = seq[i];
+		if (deepbind::base2index(base) == INVALID_BASE) {
+			return i;
+		}
+	}
+	// TRACE_ENCLAVE("valid sequence");
+	return 0;
+}
+
+size_t ecall_addmodelset() {
+    modelsets.push_back(new deepbind());
+    return modelsets.size() - 1;
+}
+
+void ecall_addIDtomodel(size_t modelset, int major, int minor) {
+    model_id_t id = {major, minor};
+    deepbind* dbmodel = get_modelset(modelset);
+    if (dbmodel) {
+        dbmodel->addModelID(id);
+    }
+}
+
+model_id_t ecall_getdbmodelid(size_t modelset, size_t index) {
+    model_id_t modelid = {0, 0};
+    deepbind* dbmodel = get_modelset(modelset);
+    if (dbmodel) {
+        modelid = dbmodel->getModelID(index);
+    }
+	return modelid;
+}
+
+void ecall_loadparams(size_t modelset, deepbind_model_t model) {
+    deepbind* dbmodel = get_modelset(modelset);
+    if (dbmodel) {
+        dbmodel->addModelParams(model);
+    }
+}
+
+void ecall_initmodel(size_t modelset) {
+    deepbind* dbmodel = get_modelset(modelset);
+    if (dbmodel) {
+        dbmodel->clear();
+    }
+}
+
+float ecall_scanmodel(size_t modelset,
+						size_t modelindex, 
+						unsigned char* seq, 
+						size_t seqlen,
+						size_t window_size,
+						int average_flag) {
+    deepbind* dbmodel = get_modelset(modelset);
+    if (!dbmodel || modelindex >= dbmodel->getModelCount()) {
+        return 0;
+    }
+	return dbmodel->scan_model(modelindex, seq, seqlen, window_size, average_flag);
+}
+
+int ecall_scoreseq(size_t modelset,
+                   const unsigned char* seq,
+                   size_t seqlen,
+                   float* scores,
+                   size_t maxscores) {
+    deepbind* dbmodel = get_modelset(modelset);
+    if (!dbmodel || seqlen == 0 || dbmodel->getModelCount() > maxscores) {
+        return -1;
+    }
+    // checked and encoded in one pass, and shared by every model of the set
+    vector<unsigned char> codes(seqlen);
+    size_t count = 0;
+    if (encode_bases(seq, seqlen, codes.data(), &count) != 0 || count != seqlen) {
+        return -1;
+    }
+    size_t modelcount = dbmodel->getModelCount();
+    for (size_t i = 0; i < modelcount; i++) {
+        scores[i] = dbmodel->scan_encoded(i, codes.data(), seqlen, 0, 0);
+    }
+    return (int)modelcount;
+}
+
+// Scores spans[0..count) with models [first, first + n) of dbmodel, a row
+// of n scores per sequence; see ecall_scorebatch
+static int score_spans(deepbind* dbmodel,
+                       size_t first,
+                       size_t n,
+                       const seq_span_t* spans,
+                       size_t count,
+                       float* scores,
+                       size_t* badpos) {
+    // each sequence is copied in once, so the host cannot change it while
+    // it is being checked and scored
+    vector<unsigned char> seq;
+    vector<unsigned char> codes;
+    *badpos = 0;
+    for (size_t r = 0; r < count; r++) {
+        const unsigned char* data = spans[r].data;
+        size_t seqlen = spans[r].size;
+        if (data == nullptr || seqlen == 0 || !oe_is_outside_enclave(data, seqlen)) {
+            return -1;
+        }
+        seq.assign(data, data + seqlen);
+        codes.resize(seqlen);
+        size_t encoded = 0;
+        if (encode_bases(seq.data(), seqlen, codes.data(), &encoded) != 0 || encoded != seqlen) {
+            // blanks are not bases either
+            *badpos = ecall_checkvalidseq(seq.data(), seqlen);
+            return (int)r;
+        }
+        for (size_t i = 0; i < n; i++) {
+            scores[r * n + i] = dbmodel->scan_encoded(first + i, codes.data(), seqlen, 0, 0);
+        }
+    }
+    return (int)count;
+}
+
+int ecall_scorebatch(size_t modelset,
+                     const seq_span_t* spans,
+                     size_t count,
+                     float* scores,
+                     size_t maxscores,
+                     size_t* badpos) {
+    deepbind* dbmodel = get_modelset(modelset);
+    if (!dbmodel || count > MAX_SCORE_BATCH || badpos == nullptr) {
+        return -1;
+    }
+    size_t modelcount = dbmodel->getModelCount();
+    if (count * modelcount > maxscores) {
+        return -1;
+    }
+    return score_spans(dbmodel, 0, modelcount, spans, count, scores, badpos);
+}
+
+int ecall_scoremodels(size_t modelset,
+                      size_t firstmodel,
+                      size_t modelcount,
+                      const seq_span_t* spans,
+                      size_t count,
+                      float* scores,
+                      size_t maxscores,
+                      size_t* badpos) {
+    deepbind* dbmodel = get_modelset(modelset);
+    if (!dbmodel || count > MAX_SCORE_BATCH || badpos == nullptr) {
+        return -1;
+    }
+    size_t total = dbmodel->getModelCount();
+    if (firstmodel > total || modelcount > total - firstmodel ||
+        count * modelcount > maxscores) {
+        return -1;
+    }
+    return score_spans(dbmodel, firstmodel, modelcount, spans, count, scores, badpos);
+}
+
+// Serves one request taken off a resident worker's ring. The spans are
+// copied in, and the scores written out to host memory, only once they have
+// been checked to lie there.
+static int serve_request(const score_request_t& request, size_t* badpos) {
+    deepbind* dbmodel = get_modelset(request.modelset);
+    size_t count = request.count;
+    size_t n = request.modelcount;
+    *badpos = 0;
+    if (!dbmodel || count == 0 || count > MAX_SCORE_BATCH || n == 0 ||
+        request.firstmodel > dbmodel->getModelCount() ||
+        n > dbmodel->getModelCount() - request.firstmodel || request.stride < n ||
+        request.stride > MAX_SCORE_BATCH * dbmodel->getModelCount() ||
+        !oe_is_outside_enclave(request.spans, count * sizeof(seq_span_t)) ||
+        !oe_is_outside_enclave(request.scores, ((count - 1) * request.stride + n) * sizeof(float))) {
+        return -1;
+    }
+    vector<seq_span_t> spans(request.spans, request.spans + count);
+    vector<float> scores(count * n);
+    int scored = score_spans(dbmodel, request.firstmodel, n, spans.data(), count, scores.data(), badpos);
+    for (int r = 0; r < scored; r++) {
+        memcpy(request.scores + (size_t)r * request.stride, &scores[(size_t)r * n], n * sizeof(float));
+    }
+    return scored;
+}
+
+int ecall_scoreworker(void* ring) {
+    score_ring* r = (score_ring*)ring;
+    unsigned int idle = 0;
+    if (!r || !oe_is_outside_enclave(r, sizeof(*r))) {
+        return -1;
+    }
+    while (!r->stop.load(std::memory_order_acquire)) {
+        uint64_t head = r->submit_head.load(std::memory_order_relaxed);
+        if (head == r->submit_tail.load(std::memory_order_acquire)) {
+            // spin a while for the next request, then wait on the host
+            if (++idle < SCORE_RING_SPIN) {
+                continue;
+            }
+            hcall_ringidle(ring, head);
+            idle = 0;
+            continue;
+        }
+        idle = 0;
+        score_request_t request = r->requests[head % SCORE_RING_SLOTS];
+        r->submit_head.store(head + 1, std::memory_order_release);
+
+        score_completion_t done;
+        done.tag = request.tag;
+        done.result = serve_request(request, &done.badpos);
+        uint64_t tail = r->done_tail.load(std::memory_order_relaxed);
+        r->completions[tail % SCORE_RING_SLOTS] = done;
+        r->done_tail.store(tail + 1, std::memory_order_release);
+    }
+    return 0;
+}
+
+int ecall_benchmark(int kind, size_t modelset, size_t modelindex, const unsigned char* seq, size_t seqlen, size_t iterations) {
+    if (kind == BENCH_ECALL) {
+        return 0;
+    }
+    if (kind == BENCH_OCALL) {
+        for (size_t i = 0; i < iterations; i++) {
+            if (hcall_benchnop() != OE_OK) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+    deepbind* dbmodel = get_modelset(modelset);
+    if (!dbmodel || modelindex >= dbmodel->getModelCount() || seqlen == 0 ||
+        (kind != BENCH_APPLY_MODEL && kind != BENCH_SCAN_MODEL)) {
+        return -1;
+    }
+    // scan_model takes its text writable, so it scans a copy; the scores
+    // are summed so that the loop is not optimised away
+    vector<unsigned char> text(seq, seq + seqlen);
+    vector<unsigned char> codes(seqlen);
+    volatile float sum = 0;
+    dbmodel->encode_seq(text.data(), seqlen, codes.data());
+    for (size_t i = 0; i < iterations; i++) {
+        if (kind == BENCH_APPLY_MODEL) {
+            sum = sum + dbmodel->apply_encoded(modelindex, codes.data(), seqlen);
+        } else {
+            sum = sum + dbmodel->scan_model(modelindex, text.data(), seqlen, 0, 0);
+        }
+    }
+    return 0;
+}
+
+// Seals the rows collected by the session into one chunk and hands it to the
+// host in a single ocall
+static int flush_sealed_rows(encryptor_session* s, bool last) {
+    sealed_chunk_header_t header;
+    size_t size = s->sealed_rows.size() * sizeof(float);
+
+    memset(&header, 0, sizeof(header));
+    header.flags = last ? SEALED_CHUNK_LAST : 0;
+    header.columns = (unsigned int)s->sealed_columns;
+    header.rows = (unsigned int)(s->sealed_columns ? s->sealed_rows.size() / s->sealed_columns : 0);
+    header.size = (unsigned int)size;
+    s->seal_buffer.resize(sizeof(header) + size);
+    if (dispatcher.seal_chunk(
+            &s->cipher,
+            &header,
+            (const unsigned char*)s->sealed_rows.data(),
+            &s->seal_buffer[sizeof(header)]) != 0) {
+        return -1;
+    }
+    memcpy(&s->seal_buffer[0], &header, sizeof(header));
+    s->sealed_rows.clear();
+    if (hcall_sealedscores(s->seal_buffer.data(), s->seal_buffer.size()) != OE_OK) {
+        return -2;
+    }
+    return 0;
+}
+
+// Scores one framed record, already validated and in the index encoding,
+// against every model of the session's set and hands the scores to the host,
+// along with the record's name if it has one. Sealed rows carry no names.
+static int score_record(void* context, const char* name, const unsigned char* seq, size_t seqlen) {
+    encryptor_session* s = (encryptor_session*)context;
+    deepbind* scoring_set = s->scoring_set;
+    size_t modelcount = scoring_set->getModelCount();
+    vector<float> scores(modelcount);
+    for (size_t i = 0; i < modelcount; i++) {
+        scores[i] = scoring_set->scan_encoded(i, seq, seqlen, 0, 0);
+    }
+    if (s->seal_scores) {
+        s->sealed_columns = modelcount;
+        s->sealed_rows.insert(s->sealed_rows.end(), scores.begin(), scores.end());
+        if (s->sealed_rows.size() * sizeof(float) + modelcount * sizeof(float) > SEALED_CHUNK_SIZE) {
+            return flush_sealed_rows(s, false);
+        }
+        return 0;
+    }
+    if (hcall_printscores(scores.data(), modelcount, name) != OE_OK) {
+        return -2;
+    }
+    return 0;
+}
+
+int ecall_decryptpredict(size_t session, size_t modelset, const unsigned char* inbuff, size_t size, bool eof, size_t datasize, framer_stats_t* stats) {
+    deepbind* dbmodel = get_modelset(modelset);
+    if (!dbmodel || !is_valid_host_chunk(inbuff, size) || datasize > size) {
+        return -1;
+    }
+    encryptor_session* s = acquire_session(session);
+    if (s == nullptr) {
+        return -1;
+    }
+    s->scoring_set = dbmodel;
+    // Scoring does not check the data MAC, so it is not computed either
+    s->cipher.mac_active = false;
+
+    // decrypt in place inside the enclave copy of the chunk
+    unsigned char* outbuff = copy_chunk_to_enclave(s, inbuff, size);
+    int ret = dispatcher.encrypt_block(&s->cipher, false, outbuff, outbuff, size);
+    if (ret == 0) {
+        // only the first datasize bytes are plaintext, the rest is padding
+        ret = s->framer.feed(outbuff, datasize, eof, score_record, s);
+        s->framer.get_stats(stats);
+        // Rows are not held across calls, so every row of this chunk has
+        // left the enclave when it returns
+        if (ret >= 0 && s->seal_scores && !s->sealed_rows.empty()) {
+            int flushed = flush_sealed_rows(s, false);
+            if (flushed != 0) {
+                ret = flushed;
+            }
+        }
+    } else {
+        ret = -1;
+    }
+    release_session(s);
+    return ret;
+}
+
+int ecall_loadindex(size_t session, const unsigned char* inbuff, size_t size) {
+    if (!is_valid_host_chunk(inbuff, size)) {
+        return -1;
+    }
+    encryptor_session* s = acquire_session(session);
+    if (s == nullptr) {
+        return -1;
+    }
+    int ret = 0;
+    unsigned char* outbuff;
+
+    if (s->record_index_stride == 0) {
+        ret = -1;
+        goto exit;
+    }
+    s->cipher.mac_active = false;
+    outbuff = copy_chunk_to_enclave(s, inbuff, size);
+    if (dispatcher.encrypt_block(&s->cipher, false, outbuff, outbuff, size) != 0) {
+        ret = -1;
+        goto exit;
+    }
+
+    // Entries must be record starts inside the data, in file order; the
+    // zero padding after the last entry is dropped
+    for (size_t pos = 0; pos + RECORD_INDEX_ENTRY_SIZE <= size &&
+                         s->record_index.size() < s->record_index_entries;
+         pos += RECORD_INDEX_ENTRY_SIZE) {
+        uint64_t offset;
+        memcpy(&offset, outbuff + pos, sizeof(offset));
+        if (offset >= s->plaintext_size ||
+            (!s->record_index.empty() && offset <= s->record_index.back())) {
+            TRACE_ENCLAVE("invalid record index entry %zu", s->record_index.size());
+            s->record_index.clear();
+            ret = -1;
+            goto exit;
+        }
+        s->record_index.push_back(offset);
+    }
+exit:
+    release_session(s);
+    return ret;
+}
+
+int ecall_seekrecord(size_t session, size_t first, size_t count, size_t* offset) {
+    encryptor_session* s = acquire_session(session);
+    if (s == nullptr) {
+        return -1;
+    }
+    int ret = 0;
+    size_t entry, start;
+
+    if (s->record_index_stride == 0 ||
+        s->record_index.size() != s->record_index_entries ||
+        (s->record_count + s->record_index_stride - 1) / s->record_index_stride !=
+            s->record_index_entries ||
+        first >= s->record_count || count == 0) {
+        ret = -1;
+        goto exit;
+    }
+
+    // Decrypting starts at the cipher block holding the nearest indexed
+    // record; the framer drops what comes before the first selected record
+    entry = first / s->record_index_stride;
+    start = (size_t)s->record_index[entry];
+    *offset = start - start % CIPHER_BLOCK_SIZE;
+    s->framer.seek(start - *offset, first - entry * s->record_index_stride, count);
+exit:
+    release_session(s);
+    return ret;
+}
+
+int ecall_sealscores(size_t session, unsigned long long first_sequence) {
+    encryptor_session* s = acquire_session(session);
+    if (s == nullptr) {
+        return -1;
+    }
+    s->seal_scores = true;
+    s->sealed_rows.clear();
+    s->sealed_columns = s->scoring_set ? s->scoring_set->getModelCount() : 0;
+    s->cipher.seal_sequence = first_sequence;
+    release_session(s);
+    return 0;
+}
+
+int ecall_finishscores(size_t session, unsigned int columns) {
+    encryptor_session* s = acquire_session(session);
+    if (s == nullptr) {
+        return -1;
+    }
+    int ret = -1;
+    if (s->seal_scores) {
+        s->sealed_columns = columns;
+        ret = flush_sealed_rows(s, true);
+        s->seal_scores = false;
+    }
+    release_session(s);
+    return ret;
+}
+
+int ecall_opensealed(size_t session, const unsigned char* chunk, size_t size, unsigned char* rows) {
+    sealed_chunk_header_t header;
+    if (chunk == nullptr || rows == nullptr || size < sizeof(header) ||
+        size - sizeof(header) > SEALED_CHUNK_SIZE) {
+        return -1;
+    }
+    memcpy(&header, chunk, sizeof(header));
+    if (header.size != size - sizeof(header) ||
+        (size_t)header.rows * header.columns * sizeof(float) != header.size) {
+        return -1;
+    }
+    encryptor_session* s = acquire_session(session);
+    if (s == nullptr) {
+        return -1;
+    }
+    int ret = dispatcher.open_chunk(&s->cipher, &header, chunk + sizeof(header), rows) == 0 ? 0 : -1;
+    release_session(s);
+    return ret;
+}
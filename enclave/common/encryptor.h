@@ -1,67 +1,147 @@
-// Copyright (c) Open Enclave SDK contributors.
-// Licensed under the MIT License.
-
-#pragma once
-
-#include <mbedtls/aes.h>
-#include <mbedtls/ctr_drbg.h>
-#include <mbedtls/entropy.h>
-#include <openenclave/enclave.h>
-#include <string>
-
-#include "shared.h"
-
-using namespace std;
-
-class ecall_dispatcher
-{
-  private:
-    struct aes_context* m_aescontext;
-    bool m_encrypt;
-    string m_password;
-
-    encryption_header_t* m_header;
-
-    // initialization vector
-    unsigned char m_operating_iv[IV_SIZE];
-
-    // key for encrypting  data
-    unsigned char m_encryption_key[ENCRYPTION_KEY_SIZE_IN_BYTES];
-
-  public:
-    ecall_dispatcher();
-    int initialize(
-        bool encrypt,
-        const char* password,
-        size_t password_len,
-        encryption_header_t* header);
-    int encrypt_block(
-        bool encrypt,
-        unsigned char* input_buf,
-        unsigned char* output_buf,
-        size_t size);
-    void close();
-
-  private:
-    int generate_password_key(
-        const char* password,
-        unsigned char* salt,
-        unsigned char* key,
-        unsigned int key_size);
-    int generate_encryption_key(unsigned char* key, unsigned int key_size);
-    int prepare_encryption_header(encryption_header_t* header, string password);
-    int parse_encryption_header(encryption_header_t* header, string password);
-    int cipher_encryption_key(
-        bool encrypt,
-        unsigned char* input_data,
-        unsigned int input_data_size,
-        unsigned char* encrypt_key,
-        unsigned char* salt,
-        unsigned char* output_data,
-        unsigned int output_data_size);
-    int Sha256(
-        const uint8_t* data,
-        size_t data_size,
-        uint8_t sha256[HASH_VALUE_SIZE_IN_BYTES]);
-    int process_encryption_header(encryption_header_t* header);
-};
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <mbedtls/aes.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/gcm.h>
+#include <mbedtls/md.h>
+#include <openenclave/enclave.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "shared.h"
+
+using namespace std;
+
+// Password keys a session keeps: its own plus recently used ones of other
+// sessions' files
+#define MAX_SESSION_PASSWORD_KEYS 8
+
+// A password-derived key kept by the session, identified by the salt and
+// iteration count it was derived with
+struct password_key_entry
+{
+    unsigned char salt[SALT_SIZE_IN_BYTES];
+    unsigned int iterations;
+    unsigned char key[ENCRYPTION_KEY_SIZE_IN_BYTES];
+};
+
+// Cipher state of one file being encrypted or decrypted. Each encryptor
+// session owns one, so several files can stream through the enclave at once.
+struct file_cipher
+{
+    mbedtls_aes_context aes;
+    bool encrypt;
+    unsigned char operating_iv[IV_SIZE];
+    unsigned char initial_iv[IV_SIZE]; // the header salt
+
+    // HMAC of the plaintext passing through encrypt_block, until finish_mac
+    mbedtls_md_context_t mac;
+    bool mac_active;
+
+    // AES-GCM context sealing score chunks (see shared.h). Nonces are the
+    // random seal_nonce drawn at initialize with the chunk sequence number
+    // mixed into its last bytes.
+    mbedtls_gcm_context seal;
+    unsigned char seal_nonce[SEALED_NONCE_SIZE];
+    unsigned long long seal_sequence; // of the next chunk sealed or opened
+};
+
+class ecall_dispatcher
+{
+  private:
+    // Guards the session state below, which every file shares
+    std::mutex m_lock;
+
+    // Session state, kept from open_session to close_session so that any
+    // number of files can be processed without repeating key derivation
+    bool m_session_open;
+    string m_password;
+    unsigned char m_digest[HASH_VALUE_SIZE_IN_BYTES];
+    unsigned int m_kdf_iterations;
+    unsigned char m_kdf_salt[SALT_SIZE_IN_BYTES];
+    vector<password_key_entry> m_password_keys;
+    // Key of the last old password rekey derived, identified by its digest.
+    // Files encrypted in one session share a salt, so rotating them all
+    // derives the old key once.
+    bool m_old_key_valid;
+    unsigned char m_old_digest[HASH_VALUE_SIZE_IN_BYTES];
+    password_key_entry m_old_key;
+    mbedtls_ctr_drbg_context m_ctr_drbg;
+    mbedtls_entropy_context m_entropy;
+
+  public:
+    ecall_dispatcher();
+    int open_session(
+        const char* password,
+        size_t password_len,
+        unsigned int kdf_iterations);
+    void close_session();
+    int initialize(
+        bool encrypt,
+        encryption_header_t* header,
+        file_cipher* cipher);
+    int encrypt_block(
+        file_cipher* cipher,
+        bool encrypt,
+        unsigned char* input_buf,
+        unsigned char* output_buf,
+        size_t size);
+    void set_iv(file_cipher* cipher, const unsigned char* iv);
+    int finish_mac(file_cipher* cipher, unsigned char* mac);
+    int seal_chunk(
+        file_cipher* cipher,
+        sealed_chunk_header_t* header,
+        const unsigned char* input_buf,
+        unsigned char* output_buf);
+    int open_chunk(
+        file_cipher* cipher,
+        const sealed_chunk_header_t* header,
+        const unsigned char* input_buf,
+        unsigned char* output_buf);
+    void close(file_cipher* cipher);
+    int rekey(
+        const char* old_password,
+        size_t old_password_len,
+        encryption_header_t* header);
+
+  private:
+    void close_session_locked();
+    int generate_password_key(
+        const char* password,
+        const unsigned char* salt,
+        unsigned int iterations,
+        unsigned char* key,
+        unsigned int key_size);
+    const unsigned char* get_password_key(
+        const unsigned char* salt,
+        unsigned int iterations);
+    int generate_random(unsigned char* buf, size_t size);
+    int prepare_encryption_header(
+        encryption_header_t* header,
+        unsigned char* encryption_key);
+    int parse_encryption_header(
+        encryption_header_t* header,
+        unsigned char* encryption_key);
+    int check_encryption_header(const encryption_header_t* header);
+    int cipher_encryption_key(
+        bool encrypt,
+        unsigned char* input_data,
+        unsigned int input_data_size,
+        const unsigned char* encrypt_key,
+        unsigned char* salt,
+        unsigned char* output_data,
+        unsigned int output_data_size);
+    int Sha256(
+        const uint8_t* data,
+        size_t data_size,
+        uint8_t sha256[HASH_VALUE_SIZE_IN_BYTES]);
+    int process_encryption_header(
+        bool encrypt,
+        encryption_header_t* header,
+        unsigned char* encryption_key);
+};
@@ -0,0 +1,323 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include <stdint.h>
+#include <string.h>
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+#include "deepbind.h"
+#include "framer.h"
+
+// Hands the pieces of text records found by the parser to the framer
+struct record_framer::text_sink
+{
+    record_framer* framer;
+    record_handler handler;
+    void* context;
+
+    int bases(const unsigned char* data, size_t size)
+    {
+        return framer->encode_text(data, size);
+    }
+    int record(uint64_t start, const char* name)
+    {
+        (void)start;
+        return framer->emit(handler, context, name);
+    }
+};
+
+// Encodes text[0..size) into the index encoding, dropping blanks, and sets
+// *count to the number of codes written to codes, which must have room for
+// size. Returns -1 if the text holds anything but bases and blanks.
+//
+// With SSSE3, 16 characters are classified at a time. OR-ing 0x20 folds the
+// bases to lower case, all in 0x61..0x75. Characters with 6 or 7 in the high
+// nibble then look up their code by low nibble (pshufb) in one of two
+// tables; everything else is invalid unless it is a blank. Blocks without
+// blanks, the usual case, are stored as they are; the others are compacted
+// one character at a time.
+int encode_bases(const unsigned char* text, size_t size, unsigned char* codes, size_t* count)
+{
+    size_t n = 0;
+    size_t i = 0;
+#if defined(__SSSE3__)
+    const __m128i codes6 = _mm_setr_epi8(
+        -1, 0, -1, 1, -1, -1, -1, 2, -1, -1, -1, -1, -1, -1, UNKNOWN_BASE, -1);
+    const __m128i codes7 = _mm_setr_epi8(
+        -1, -1, -1, -1, 3, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    const __m128i none = _mm_set1_epi8(-1);
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(text + i));
+        __m128i folded = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        __m128i low = _mm_and_si128(folded, nibble);
+        __m128i high = _mm_and_si128(_mm_srli_epi16(folded, 4), nibble);
+        __m128i in6 = _mm_cmpeq_epi8(high, _mm_set1_epi8(6));
+        __m128i in7 = _mm_cmpeq_epi8(high, _mm_set1_epi8(7));
+        __m128i code = _mm_or_si128(
+            _mm_and_si128(in6, _mm_shuffle_epi8(codes6, low)),
+            _mm_and_si128(in7, _mm_shuffle_epi8(codes7, low)));
+        // outside both tables code is 0, so also check the range
+        __m128i valid = _mm_andnot_si128(
+            _mm_cmpeq_epi8(code, none), _mm_or_si128(in6, in7));
+        int blank = seq_blank_mask(v);
+        if ((_mm_movemask_epi8(valid) | blank) != 0xffff)
+            return -1;
+        if (blank == 0)
+        {
+            _mm_storeu_si128((__m128i*)(codes + n), code);
+            n += 16;
+            continue;
+        }
+        for (size_t k = i; k < i + 16; k++)
+        {
+            if (!seq_is_blank(text[k]))
+                codes[n++] = (unsigned char)deepbind::base2index(text[k]);
+        }
+    }
+#endif
+    for (; i < size; i++)
+    {
+        int index = deepbind::base2index(text[i]);
+        if (index == INVALID_BASE)
+        {
+            if (!seq_is_blank(text[i]))
+                return -1;
+            continue;
+        }
+        codes[n++] = (unsigned char)index;
+    }
+    *count = n;
+    return 0;
+}
+
+// Returns how many bytes must be available at p to hold the packed record
+// that starts there: first its fixed header, then its run table, then the
+// whole record. Returns 0 if the record header is malformed.
+static size_t packed_bytes_needed(const unsigned char* p, size_t avail)
+{
+    uint32_t length;
+    uint32_t runs;
+    size_t header;
+
+    if (avail < PACKED_RECORD_HEADER_SIZE)
+        return PACKED_RECORD_HEADER_SIZE;
+    memcpy(&length, p, sizeof(length));
+    memcpy(&runs, p + sizeof(length), sizeof(runs));
+    if (length > MAX_PACKED_RECORD_LENGTH || runs > length)
+        return 0;
+
+    header = PACKED_RECORD_HEADER_SIZE + (size_t)runs * PACKED_RUN_SIZE;
+    if (avail < header)
+        return header;
+    return header + (length + 3) / 4;
+}
+
+record_framer::record_framer()
+    : m_packed(false), m_records(0), m_bytes(0), m_skip_bytes(0),
+      m_skip_records(0), m_selected(0), m_limited(false)
+{
+}
+
+void record_framer::reset(bool packed)
+{
+    m_packed = packed;
+    m_parser.reset();
+    m_carry.clear();
+    m_codes.clear();
+    m_records = 0;
+    m_bytes = 0;
+    m_skip_bytes = 0;
+    m_skip_records = 0;
+    m_selected = 0;
+    m_limited = false;
+}
+
+// Prepares for data that starts skip_bytes before a record boundary. The
+// following skip_records records are dropped, the next count records are
+// passed to the handler and feed() then returns FRAMER_DONE. Statistics keep
+// accumulating across seeks.
+void record_framer::seek(size_t skip_bytes, size_t skip_records, size_t count)
+{
+    m_parser.reset();
+    m_carry.clear();
+    m_codes.clear();
+    m_skip_bytes = skip_bytes;
+    m_skip_records = skip_records;
+    m_selected = count;
+    m_limited = true;
+}
+
+int record_framer::emit(record_handler handler, void* context, const char* name)
+{
+    int ret = 0;
+    if (m_codes.empty())
+        return 0;
+    if (m_skip_records > 0)
+    {
+        m_skip_records--;
+        m_codes.clear();
+        return 0;
+    }
+    m_records++;
+    ret = handler(context, name, m_codes.data(), m_codes.size());
+    m_codes.clear();
+    if (ret == 0 && m_limited && --m_selected == 0)
+        ret = FRAMER_DONE;
+    return ret;
+}
+
+// Frames the records in data[0..size). Records completed by this chunk are
+// passed to handler along with context; a trailing unfinished record is
+// carried to the next call, or emitted as the final record when eof is set.
+// Returns -1 if the data is not a valid sequence stream, FRAMER_DONE once a
+// seek() selection is complete.
+int record_framer::feed(
+    const unsigned char* data,
+    size_t size,
+    bool eof,
+    record_handler handler,
+    void* context)
+{
+    if (m_limited && m_selected == 0)
+        return FRAMER_DONE;
+    m_bytes += size;
+    if (m_skip_bytes > 0)
+    {
+        size_t skip = m_skip_bytes < size ? m_skip_bytes : size;
+        m_skip_bytes -= skip;
+        data += skip;
+        size -= skip;
+    }
+    return m_packed ? feed_packed(data, size, eof, handler, context)
+                    : feed_text(data, size, eof, handler, context);
+}
+
+// Appends the index encoding of a run of sequence text to the current
+// record, dropping blanks
+int record_framer::encode_text(const unsigned char* data, size_t size)
+{
+    size_t start = m_codes.size();
+    size_t count = 0;
+    m_codes.resize(start + size);
+    if (encode_bases(data, size, &m_codes[start], &count) != 0)
+        return -1;
+    m_codes.resize(start + count);
+    return 0;
+}
+
+int record_framer::feed_text(
+    const unsigned char* data,
+    size_t size,
+    bool eof,
+    record_handler handler,
+    void* context)
+{
+    text_sink sink = {this, handler, context};
+    int ret = m_parser.parse(data, size, sink);
+    if (ret == 0 && eof)
+        ret = m_parser.finish(sink);
+    return ret;
+}
+
+// Expands one complete packed record into the index encoding
+int record_framer::unpack_record(const unsigned char* record)
+{
+    uint32_t length;
+    uint32_t runs;
+    const unsigned char* bases;
+
+    memcpy(&length, record, sizeof(length));
+    memcpy(&runs, record + sizeof(length), sizeof(runs));
+    bases = record + PACKED_RECORD_HEADER_SIZE + (size_t)runs * PACKED_RUN_SIZE;
+
+    m_codes.resize(length);
+    for (uint32_t i = 0; i < length; i++)
+        m_codes[i] = (unsigned char)((bases[i / 4] >> (2 * (i % 4))) & 3);
+
+    for (uint32_t r = 0; r < runs; r++)
+    {
+        uint32_t run[2];
+        memcpy(
+            run,
+            record + PACKED_RECORD_HEADER_SIZE + (size_t)r * PACKED_RUN_SIZE,
+            sizeof(run));
+        if (run[0] > length || run[1] > length - run[0])
+            return -1;
+        memset(&m_codes[0] + run[0], UNKNOWN_BASE, run[1]);
+    }
+    return 0;
+}
+
+int record_framer::feed_packed(
+    const unsigned char* data,
+    size_t size,
+    bool eof,
+    record_handler handler,
+    void* context)
+{
+    int ret = 0;
+    size_t pos = 0;
+    size_t need = 0;
+
+    // Complete the record carried over from the previous chunk first
+    if (!m_carry.empty())
+    {
+        for (;;)
+        {
+            need = packed_bytes_needed(m_carry.data(), m_carry.size());
+            if (need == 0)
+                return -1;
+            if (m_carry.size() >= need || pos == size)
+                break;
+            size_t take = need - m_carry.size();
+            if (take > size - pos)
+                take = size - pos;
+            m_carry.insert(m_carry.end(), data + pos, data + pos + take);
+            pos += take;
+        }
+        if (m_carry.size() < need)
+            return eof ? -1 : 0;
+
+        ret = unpack_record(m_carry.data());
+        m_carry.clear();
+        if (ret == 0)
+            ret = emit(handler, context, NULL);
+        if (ret != 0)
+            return ret;
+    }
+
+    // Records wholly inside this chunk are unpacked where they are
+    while (pos < size)
+    {
+        need = packed_bytes_needed(data + pos, size - pos);
+        if (need == 0)
+            return -1;
+        if (size - pos < need)
+        {
+            m_carry.assign(data + pos, data + size);
+            break;
+        }
+        ret = unpack_record(data + pos);
+        if (ret == 0)
+            ret = emit(handler, context, NULL);
+        if (ret != 0)
+            return ret;
+        pos += need;
+    }
+
+    // A packed stream must end on a record boundary
+    if (eof && !m_carry.empty())
+        return -1;
+    return 0;
+}
+
+void record_framer::get_stats(framer_stats_t* stats)
+{
+    stats->records = m_records;
+    stats->bytes = m_bytes;
+    stats->carry = m_packed ? m_carry.size() : m_codes.size();
+}
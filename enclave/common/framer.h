@@ -0,0 +1,74 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <vector>
+#include "seqformat.h"
+#include "shared.h"
+
+using namespace std;
+
+// Called once for every complete record with the context given to feed(),
+// the record's name (NULL unless the stream is FASTA or FASTQ) and the
+// sequence in the engine's index encoding (see deepbind::base2index). A
+// non-zero return value stops framing and is passed back to the caller of
+// feed().
+typedef int (*record_handler)(
+    void* context,
+    const char* name,
+    const unsigned char* seq,
+    size_t seqlen);
+
+// Checks and encodes sequence text in one pass, dropping blanks
+int encode_bases(const unsigned char* text, size_t size, unsigned char* codes, size_t* count);
+
+// Returned by feed() once the records selected by seek() have all been
+// passed to the handler
+#define FRAMER_DONE 1
+
+// record_framer splits a stream of decrypted data into records regardless
+// of how the stream is cut into chunks. The unfinished record at the end of
+// a chunk is kept in enclave memory and completed by the following chunk, so
+// records of any length survive any chunk size.
+//
+// Text streams are sequence text in any of the formats of seqformat.h: one
+// sequence per line, FASTA or FASTQ. Packed streams hold the 2-bit records
+// described in shared.h.
+//
+// After seek() the framer starts part way into a stream, at a record found
+// through the record index, and stops after a given number of records.
+class record_framer
+{
+  private:
+    bool m_packed;
+    seq_text_parser m_parser;
+    vector<unsigned char> m_carry;   // unfinished record carried across feeds
+    vector<unsigned char> m_codes;   // index encoding of the current record
+    size_t m_records;
+    size_t m_bytes;
+    size_t m_skip_bytes;   // plaintext to drop before the first record
+    size_t m_skip_records; // records to drop before the selection
+    size_t m_selected;     // records left to pass on, if m_limited
+    bool m_limited;
+
+  public:
+    record_framer();
+    void reset(bool packed);
+    void seek(size_t skip_bytes, size_t skip_records, size_t count);
+    int feed(
+        const unsigned char* data,
+        size_t size,
+        bool eof,
+        record_handler handler,
+        void* context);
+    void get_stats(framer_stats_t* stats);
+
+  private:
+    struct text_sink;
+    int feed_text(const unsigned char* data, size_t size, bool eof, record_handler handler, void* context);
+    int feed_packed(const unsigned char* data, size_t size, bool eof, record_handler handler, void* context);
+    int encode_text(const unsigned char* data, size_t size);
+    int unpack_record(const unsigned char* record);
+    int emit(record_handler handler, void* context, const char* name);
+};
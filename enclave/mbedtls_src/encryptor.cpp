@@ -1,117 +1,360 @@
-// Copyright (c) Open Enclave SDK contributors.
-// Licensed under the MIT License.
-
-#include <mbedtls/aes.h>
-#include <mbedtls/ctr_drbg.h>
-#include <mbedtls/entropy.h>
-#include <string.h>
-
-#include "common/encryptor.h"
-#include "common/trace.h"
-
-struct aes_context
-{
-    mbedtls_aes_context ctx;
-};
-
-ecall_dispatcher::ecall_dispatcher() : m_encrypt(true), m_header(nullptr)
-{
-}
-
-int ecall_dispatcher::initialize(
-    bool encrypt,
-    const char* password,
-    size_t password_size,
-    encryption_header_t* header)
-{
-    int ret = 0;
-    //TRACE_ENCLAVE(
-        // "ecall_dispatcher::initialize : %s request",
-        // encrypt ? "encrypting" : "decrypting");
-
-    if (header == nullptr)
-    {
-        //TRACE_ENCLAVE("initialize() failed as nullptr was passed in place of "
-                    //   "(encryption_header_t *)");
-        goto exit;
-    }
-
-    m_password = string(password, password + password_size);
-    m_encrypt = encrypt;
-    m_header = header;
-
-    memset((void*)m_encryption_key, 0, ENCRYPTION_KEY_SIZE_IN_BYTES);
-
-    ret = process_encryption_header(header);
-    if (ret != 0)
-    {
-        //TRACE_ENCLAVE("process_encryption_header failed with %d", ret);
-        goto exit;
-    }
-
-    // initialize aes context
-    m_aescontext = (struct aes_context*)malloc(sizeof(struct aes_context));
-    if (m_aescontext == nullptr)
-    {
-        ret = 1;
-        //TRACE_ENCLAVE("allocate m_aescontext failed with %d", ret);
-        goto exit;
-    }
-
-    mbedtls_aes_init(&(m_aescontext->ctx));
-
-    // set aes key
-    if (encrypt)
-        ret = mbedtls_aes_setkey_enc(
-            &(m_aescontext->ctx), m_encryption_key, ENCRYPTION_KEY_SIZE);
-    else
-        ret = mbedtls_aes_setkey_dec(
-            &(m_aescontext->ctx), m_encryption_key, ENCRYPTION_KEY_SIZE);
-
-    if (ret != 0)
-    {
-        //TRACE_ENCLAVE("mbedtls_aes_setkey_dec failed with %d", ret);
-        goto exit;
-    }
-
-    // init iv
-    memcpy(m_operating_iv, m_header->salt, IV_SIZE);
-exit:
-    return ret;
-}
-
-int ecall_dispatcher::encrypt_block(
-    bool encrypt,
-    unsigned char* input_buffer,
-    unsigned char* output_buffer,
-    size_t size)
-{
-    int ret = 0;
-
-    // //TRACE_ENCLAVE("encrypt_block starting... %i", size);
-    ret = mbedtls_aes_crypt_cbc(
-        &(m_aescontext->ctx),
-        encrypt ? MBEDTLS_AES_ENCRYPT : MBEDTLS_AES_DECRYPT,
-        size,           // input data length in bytes,
-        m_operating_iv, // Initialization vector (updated after use)
-        input_buffer,
-        output_buffer);
-    if (ret != 0)
-    {
-        //TRACE_ENCLAVE("mbedtls_aes_crypt_cbc failed with %d", ret);
-    }
-    return ret;
-}
-
-void ecall_dispatcher::close()
-{
-    if (m_encrypt)
-    {
-        oe_host_free(m_header);
-        m_header = nullptr;
-    }
-
-    // free aes context
-    mbedtls_aes_free(&(m_aescontext->ctx));
-    //TRACE_ENCLAVE("ecall_dispatcher::close");
-}
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include <mbedtls/aes.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/gcm.h>
+#include <mbedtls/md.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "common/encryptor.h"
+#include "common/trace.h"
+
+ecall_dispatcher::ecall_dispatcher()
+    : m_session_open(false), m_kdf_iterations(0), m_old_key_valid(false)
+{
+}
+
+// Opens a session for password. The password digest and the salt for new
+// files are computed here, once, and the DRBG is seeded once for all the
+// salts and data keys generated during the session. The password key for the
+// salt is derived by the first file encrypted, so that sessions that only
+// decrypt derive none but the keys of their files.
+int ecall_dispatcher::open_session(
+    const char* password,
+    size_t password_size,
+    unsigned int kdf_iterations)
+{
+    int ret = 0;
+    const char seed[] = "file_encryptor_sample";
+
+    if (kdf_iterations < MIN_KDF_ITERATIONS ||
+        kdf_iterations > MAX_KDF_ITERATIONS)
+    {
+        TRACE_ENCLAVE("kdf iterations %u out of range", kdf_iterations);
+        return 1;
+    }
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    close_session_locked();
+    m_password = string(password, password + password_size);
+    m_kdf_iterations = kdf_iterations;
+
+    mbedtls_entropy_init(&m_entropy);
+    mbedtls_ctr_drbg_init(&m_ctr_drbg);
+    m_session_open = true;
+
+    ret = mbedtls_ctr_drbg_seed(
+        &m_ctr_drbg,
+        mbedtls_entropy_func,
+        &m_entropy,
+        (const unsigned char*)seed,
+        strlen(seed));
+    if (ret != 0)
+    {
+        TRACE_ENCLAVE("mbedtls_ctr_drbg_seed() failed with -0x%04x", -ret);
+        goto exit;
+    }
+
+    ret = Sha256(
+        (const uint8_t*)m_password.c_str(), m_password.length(), m_digest);
+    if (ret != 0)
+        goto exit;
+
+    // The salt of files encrypted in this session
+    ret = generate_random(m_kdf_salt, sizeof(m_kdf_salt));
+
+exit:
+    if (ret != 0)
+        close_session_locked();
+    return ret;
+}
+
+// Wipes the password and every key derived from it. Files already
+// initialized keep their expanded data keys until they are closed.
+void ecall_dispatcher::close_session()
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    close_session_locked();
+}
+
+void ecall_dispatcher::close_session_locked()
+{
+    if (!m_session_open)
+        return;
+    for (size_t i = 0; i < m_password_keys.size(); i++)
+        oe_memset_s(
+            &m_password_keys[i], sizeof(m_password_keys[i]), 0,
+            sizeof(m_password_keys[i]));
+    m_password_keys.clear();
+    oe_memset_s(&m_old_key, sizeof(m_old_key), 0, sizeof(m_old_key));
+    oe_memset_s(m_old_digest, sizeof(m_old_digest), 0, sizeof(m_old_digest));
+    m_old_key_valid = false;
+    if (!m_password.empty())
+        oe_memset_s(&m_password[0], m_password.size(), 0, m_password.size());
+    m_password.clear();
+    oe_memset_s(m_digest, sizeof(m_digest), 0, sizeof(m_digest));
+    mbedtls_ctr_drbg_free(&m_ctr_drbg);
+    mbedtls_entropy_free(&m_entropy);
+    m_session_open = false;
+}
+
+// Labels mixed into the data key to get the key of the data MAC, so that the
+// same key is never used for both AES and HMAC,
+static const char data_mac_label[] = "sgxdb data mac";
+// and of the key sealing score chunks
+static const char seal_key_label[] = "sgxdb score seal";
+
+// Sets up cipher for one file: the header is filled in or checked under the
+// session lock, then the data key is expanded into the file's own context,
+// the data MAC is started and the score sealing key is set
+int ecall_dispatcher::initialize(
+    bool encrypt,
+    encryption_header_t* header,
+    file_cipher* cipher)
+{
+    int ret = 0;
+    unsigned char encryption_key[ENCRYPTION_KEY_SIZE_IN_BYTES];
+    unsigned char mac_key_input[ENCRYPTION_KEY_SIZE_IN_BYTES + sizeof(data_mac_label)];
+    unsigned char mac_key[HASH_VALUE_SIZE_IN_BYTES];
+    unsigned char seal_key_input[ENCRYPTION_KEY_SIZE_IN_BYTES + sizeof(seal_key_label)];
+    unsigned char seal_key[HASH_VALUE_SIZE_IN_BYTES];
+    //TRACE_ENCLAVE(
+        // "ecall_dispatcher::initialize : %s request",
+        // encrypt ? "encrypting" : "decrypting");
+
+    if (header == nullptr || cipher == nullptr)
+    {
+        //TRACE_ENCLAVE("initialize() failed as nullptr was passed in place of "
+                    //   "(encryption_header_t *)");
+        return 1;
+    }
+
+    memset(encryption_key, 0, sizeof(encryption_key));
+    // initialized up front so that every failure path can free them
+    mbedtls_aes_init(&cipher->aes);
+    mbedtls_md_init(&cipher->mac);
+    mbedtls_gcm_init(&cipher->seal);
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (!m_session_open)
+        {
+            TRACE_ENCLAVE("initialize() called without an open session");
+            ret = 1;
+            goto exit;
+        }
+        ret = process_encryption_header(encrypt, header, encryption_key);
+        if (ret == 0)
+            ret = generate_random(cipher->seal_nonce, sizeof(cipher->seal_nonce));
+    }
+    if (ret != 0)
+    {
+        //TRACE_ENCLAVE("process_encryption_header failed with %d", ret);
+        goto exit;
+    }
+
+    // initialize aes context
+    cipher->encrypt = encrypt;
+    cipher->mac_active = false;
+    cipher->seal_sequence = 0;
+
+    // set aes key
+    if (encrypt)
+        ret = mbedtls_aes_setkey_enc(
+            &cipher->aes, encryption_key, ENCRYPTION_KEY_SIZE);
+    else
+        ret = mbedtls_aes_setkey_dec(
+            &cipher->aes, encryption_key, ENCRYPTION_KEY_SIZE);
+
+    if (ret != 0)
+    {
+        //TRACE_ENCLAVE("mbedtls_aes_setkey_dec failed with %d", ret);
+        goto exit;
+    }
+
+    // start the data MAC
+    memcpy(mac_key_input, encryption_key, sizeof(encryption_key));
+    memcpy(mac_key_input + sizeof(encryption_key), data_mac_label, sizeof(data_mac_label));
+    ret = Sha256(mac_key_input, sizeof(mac_key_input), mac_key);
+    if (ret != 0)
+        goto exit;
+    ret = mbedtls_md_setup(
+        &cipher->mac, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 1);
+    if (ret == 0)
+        ret = mbedtls_md_hmac_starts(&cipher->mac, mac_key, sizeof(mac_key));
+    if (ret != 0)
+    {
+        TRACE_ENCLAVE("starting the data mac failed with -0x%04x", -ret);
+        goto exit;
+    }
+    cipher->mac_active = true;
+
+    // set the score sealing key
+    memcpy(seal_key_input, encryption_key, sizeof(encryption_key));
+    memcpy(seal_key_input + sizeof(encryption_key), seal_key_label, sizeof(seal_key_label));
+    ret = Sha256(seal_key_input, sizeof(seal_key_input), seal_key);
+    if (ret == 0)
+        ret = mbedtls_gcm_setkey(
+            &cipher->seal, MBEDTLS_CIPHER_ID_AES, seal_key, ENCRYPTION_KEY_SIZE);
+    if (ret != 0)
+    {
+        TRACE_ENCLAVE("setting the seal key failed with -0x%04x", -ret);
+        goto exit;
+    }
+
+    // init iv
+    memcpy(cipher->initial_iv, header->salt, IV_SIZE);
+    memcpy(cipher->operating_iv, cipher->initial_iv, IV_SIZE);
+exit:
+    if (ret != 0)
+    {
+        mbedtls_aes_free(&cipher->aes);
+        mbedtls_md_free(&cipher->mac);
+        mbedtls_gcm_free(&cipher->seal);
+    }
+    oe_memset_s(encryption_key, sizeof(encryption_key), 0, sizeof(encryption_key));
+    oe_memset_s(mac_key_input, sizeof(mac_key_input), 0, sizeof(mac_key_input));
+    oe_memset_s(mac_key, sizeof(mac_key), 0, sizeof(mac_key));
+    oe_memset_s(seal_key_input, sizeof(seal_key_input), 0, sizeof(seal_key_input));
+    oe_memset_s(seal_key, sizeof(seal_key), 0, sizeof(seal_key));
+    return ret;
+}
+
+// Restarts the CBC chain for a seek: iv is the ciphertext block before the
+// next block to be processed, or nullptr to seek to the start of the data
+void ecall_dispatcher::set_iv(file_cipher* cipher, const unsigned char* iv)
+{
+    memcpy(cipher->operating_iv, iv ? iv : cipher->initial_iv, IV_SIZE);
+}
+
+int ecall_dispatcher::encrypt_block(
+    file_cipher* cipher,
+    bool encrypt,
+    unsigned char* input_buffer,
+    unsigned char* output_buffer,
+    size_t size)
+{
+    int ret = 0;
+
+    // //TRACE_ENCLAVE("encrypt_block starting... %i", size);
+    // The MAC covers the plaintext: the input when encrypting, the output
+    // when decrypting
+    if (encrypt && cipher->mac_active)
+    {
+        ret = mbedtls_md_hmac_update(&cipher->mac, input_buffer, size);
+        if (ret != 0)
+            return ret;
+    }
+    ret = mbedtls_aes_crypt_cbc(
+        &cipher->aes,
+        encrypt ? MBEDTLS_AES_ENCRYPT : MBEDTLS_AES_DECRYPT,
+        size,                 // input data length in bytes,
+        cipher->operating_iv, // Initialization vector (updated after use)
+        input_buffer,
+        output_buffer);
+    if (ret != 0)
+    {
+        //TRACE_ENCLAVE("mbedtls_aes_crypt_cbc failed with %d", ret);
+    }
+    else if (!encrypt && cipher->mac_active)
+    {
+        ret = mbedtls_md_hmac_update(&cipher->mac, output_buffer, size);
+    }
+    return ret;
+}
+
+// Ends the data MAC, which then covers everything encrypted or decrypted
+// since initialize. Blocks processed afterwards, such as the record index,
+// are not included.
+int ecall_dispatcher::finish_mac(file_cipher* cipher, unsigned char* mac)
+{
+    if (!cipher->mac_active)
+        return 1;
+    cipher->mac_active = false;
+    return mbedtls_md_hmac_finish(&cipher->mac, mac);
+}
+
+// The nonce of a chunk: the cipher's random nonce with the chunk sequence
+// number mixed into its last 8 bytes, so no two chunks of a run share one
+static void seal_chunk_nonce(
+    const file_cipher* cipher,
+    unsigned long long sequence,
+    unsigned char* nonce)
+{
+    memcpy(nonce, cipher->seal_nonce, SEALED_NONCE_SIZE);
+    for (size_t i = 0; i < sizeof(sequence); i++)
+        nonce[SEALED_NONCE_SIZE - 1 - i] ^= (unsigned char)(sequence >> (8 * i));
+}
+
+// Seals header->size bytes of score rows from input_buf into output_buf. The
+// caller fills in flags, rows, columns and size; the rest of the header is
+// set here and authenticated along with the data.
+int ecall_dispatcher::seal_chunk(
+    file_cipher* cipher,
+    sealed_chunk_header_t* header,
+    const unsigned char* input_buf,
+    unsigned char* output_buf)
+{
+    header->magic = SEALED_CHUNK_MAGIC;
+    header->sequence = cipher->seal_sequence++;
+    seal_chunk_nonce(cipher, header->sequence, header->nonce);
+    return mbedtls_gcm_crypt_and_tag(
+        &cipher->seal,
+        MBEDTLS_GCM_ENCRYPT,
+        header->size,
+        header->nonce,
+        sizeof(header->nonce),
+        (const unsigned char*)header,
+        offsetof(sealed_chunk_header_t, tag),
+        input_buf,
+        output_buf,
+        sizeof(header->tag),
+        header->tag);
+}
+
+// Opens a chunk sealed by seal_chunk. Chunks must be opened in the order
+// they were sealed, starting from the cipher's seal_sequence.
+int ecall_dispatcher::open_chunk(
+    file_cipher* cipher,
+    const sealed_chunk_header_t* header,
+    const unsigned char* input_buf,
+    unsigned char* output_buf)
+{
+    int ret = 0;
+
+    if (header->magic != SEALED_CHUNK_MAGIC ||
+        header->sequence != cipher->seal_sequence)
+    {
+        TRACE_ENCLAVE("sealed chunk out of sequence");
+        return 1;
+    }
+    ret = mbedtls_gcm_auth_decrypt(
+        &cipher->seal,
+        header->size,
+        header->nonce,
+        sizeof(header->nonce),
+        (const unsigned char*)header,
+        offsetof(sealed_chunk_header_t, tag),
+        header->tag,
+        sizeof(header->tag),
+        input_buf,
+        output_buf);
+    if (ret != 0)
+    {
+        TRACE_ENCLAVE("sealed chunk %llu failed authentication", header->sequence);
+        return ret;
+    }
+    cipher->seal_sequence++;
+    return 0;
+}
+
+void ecall_dispatcher::close(file_cipher* cipher)
+{
+    // mbedtls_aes_free, mbedtls_md_free and mbedtls_gcm_free zeroize the keys
+    mbedtls_aes_free(&cipher->aes);
+    mbedtls_md_free(&cipher->mac);
+    mbedtls_gcm_free(&cipher->seal);
+    //TRACE_ENCLAVE("ecall_dispatcher::close");
+}
@@ -1,444 +1,527 @@
-// Copyright (c) Open Enclave SDK contributors.
-// Licensed under the MIT License.
-
-#include <mbedtls/aes.h>
-#include <mbedtls/config.h>
-#include <mbedtls/ctr_drbg.h>
-#include <mbedtls/entropy.h>
-#include <mbedtls/error.h>
-#include <mbedtls/md.h>
-#include <mbedtls/pk.h>
-#include <mbedtls/pkcs5.h>
-#include <mbedtls/rsa.h>
-#include <mbedtls/sha256.h>
-
-#include "common/encryptor.h"
-#include "common/trace.h"
-
-#define ENCRYPT_OPERATION true
-#define DECRYPT_OPERATION false
-
-// Compute the sha256 hash of given data.
-int ecall_dispatcher::Sha256(
-    const uint8_t* data,
-    size_t data_size,
-    uint8_t sha256[HASH_VALUE_SIZE_IN_BYTES])
-{
-    int ret = 0;
-    mbedtls_sha256_context ctx;
-
-    mbedtls_sha256_init(&ctx);
-
-    ret = mbedtls_sha256_starts_ret(&ctx, 0);
-    if (ret)
-        goto exit;
-
-    ret = mbedtls_sha256_update_ret(&ctx, data, data_size);
-    if (ret)
-        goto exit;
-
-    ret = mbedtls_sha256_finish_ret(&ctx, sha256);
-    if (ret)
-        goto exit;
-
-exit:
-    mbedtls_sha256_free(&ctx);
-    return ret;
-}
-
-// This routine uses the mbed_tls library to derive an AES key from the input
-// password and produces a password-based key.
-int ecall_dispatcher::generate_password_key(
-    const char* password,
-    unsigned char* salt,
-    unsigned char* key,
-    unsigned int key_size)
-{
-    mbedtls_md_context_t sha_ctx;
-    const mbedtls_md_info_t* info_sha;
-    int ret = 0;
-    mbedtls_md_init(&sha_ctx);
-
-    // TRACE_ENCLAVE("generate_password_key");
-
-    memset(key, 0, key_size);
-    info_sha = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
-    if (info_sha == nullptr)
-    {
-        ret = 1;
-        goto exit;
-    }
-
-    // setting up hash algorithm context
-    ret = mbedtls_md_setup(&sha_ctx, info_sha, 1);
-    if (ret != 0)
-    {
-        TRACE_ENCLAVE("mbedtls_md_setup() failed with -0x%04x", -ret);
-        goto exit;
-    }
-
-    // Derive a key from a password using PBKDF2.
-    // PBKDF2 (Password-Based Key Derivation Function 2) are key derivation
-    // functions with a sliding computational cost, aimed to reduce the
-    // vulnerability of encrypted keys to brute force attacks. See
-    // (https://en.wikipedia.org/wiki/PBKDF2) for more details.
-    ret = mbedtls_pkcs5_pbkdf2_hmac(
-        &sha_ctx,                       // Generic HMAC context
-        (const unsigned char*)password, // Password to use when generating key
-        strlen((const char*)password),  // Length of password
-        salt,                           // salt to use when generating key
-        SALT_SIZE_IN_BYTES,             // size of salt
-        100000,                         // iteration count
-        key_size,                       // length of generated key in bytes
-        key);                           // generated key
-    if (ret != 0)
-    {
-        TRACE_ENCLAVE("mbedtls_pkcs5_pbkdf2_hmac failed with -0x%04x", -ret);
-        goto exit;
-    }
-    // TRACE_ENCLAVE("Key based on password successfully generated");
-exit:
-    mbedtls_md_free(&sha_ctx);
-    return ret;
-}
-
-// Generate an encryption key: this is the key used to encrypt data
-int ecall_dispatcher::generate_encryption_key(
-    unsigned char* key,
-    unsigned int key_size)
-{
-    mbedtls_ctr_drbg_context ctr_drbg;
-    mbedtls_entropy_context entropy;
-    const char pers[] = "EncryptionKey";
-    int ret = 0;
-
-    TRACE_ENCLAVE("generate_encryption_key:");
-
-    mbedtls_entropy_init(&entropy);
-    mbedtls_ctr_drbg_init(&ctr_drbg);
-    memset(key, 0, key_size);
-
-    // mbedtls_ctr_drbg_seed seeds and sets up the CTR_DRBG entropy source for
-    // future reseeds.
-    ret = mbedtls_ctr_drbg_seed(
-        &ctr_drbg,
-        mbedtls_entropy_func,
-        &entropy,
-        (unsigned char*)pers,
-        sizeof(pers));
-    if (ret != 0)
-    {
-        TRACE_ENCLAVE("mbedtls_ctr_drbg_init failed with -0x%04x\n", -ret);
-        goto exit;
-    }
-
-    // mbedtls_ctr_drbg_random uses CTR_DRBG to generate random data
-    ret = mbedtls_ctr_drbg_random(&ctr_drbg, key, key_size);
-    if (ret != 0)
-    {
-        TRACE_ENCLAVE("mbedtls_ctr_drbg_random failed with -0x%04x\n", -ret);
-        goto exit;
-    }
-    TRACE_ENCLAVE(
-        "Encryption key successfully generated: a %d byte key (hex):  ",
-        key_size);
-
-exit:
-    mbedtls_ctr_drbg_free(&ctr_drbg);
-    mbedtls_entropy_free(&entropy);
-    return ret;
-}
-
-// The encryption key is encrypted before it was written back to the encryption
-// header as part of the encryption metadata.
-int ecall_dispatcher::cipher_encryption_key(
-    bool encrypt,
-    unsigned char* input_data,
-    unsigned int input_data_size,
-    unsigned char* encrypt_key,
-    unsigned char* iv,
-    unsigned char* output_data,
-    unsigned int output_data_size)
-{
-    int ret = 0;
-    (void)output_data_size;
-    mbedtls_aes_context aescontext;
-
-    // TRACE_ENCLAVE(
-    //     "cipher_encryption_key: %s", encrypt ? "encrypting" : "decrypting");
-
-    // init context
-    mbedtls_aes_init(&aescontext);
-
-    // set aes key
-    if (encrypt)
-    {
-        ret = mbedtls_aes_setkey_enc(
-            &aescontext, encrypt_key, ENCRYPTION_KEY_SIZE);
-    }
-    else
-    {
-        ret = mbedtls_aes_setkey_dec(
-            &aescontext, encrypt_key, ENCRYPTION_KEY_SIZE);
-    }
-    if (ret != 0)
-    {
-        // TRACE_ENCLAVE("mbedtls_aes_setkey_enc/dec failed with %d", ret);
-        goto exit;
-    }
-
-    ret = mbedtls_aes_crypt_cbc(
-        &aescontext,
-        encrypt ? MBEDTLS_AES_ENCRYPT : MBEDTLS_AES_DECRYPT,
-        input_data_size, // input data length in bytes,
-        iv,              // Initialization vector (updated after use)
-        input_data,
-        output_data);
-    if (ret != 0)
-    {
-        // TRACE_ENCLAVE("mbedtls_aes_crypt_cbc failed with %d", ret);
-    }
-exit:
-    // free aes context
-    mbedtls_aes_free(&aescontext);
-    // TRACE_ENCLAVE("ecall_dispatcher::cipher_encryption_key");
-    return ret;
-}
-
-// For an encryption operation, the encryptor creates encryption metadata for
-// writing back to the encryption header, which includes the following fields:
-// digest: a hash value of the password
-// key: encrypted version of the encryption key
-//
-// Operations involves the following operations:
-//  1)derive a key from the password
-//  2)produce a encryption key
-//  3)generate a digest for the password
-//  4)encrypt the encryption key with a password key
-//
-int ecall_dispatcher::prepare_encryption_header(
-    encryption_header_t* header,
-    string password)
-{
-    mbedtls_ctr_drbg_context ctr_drbg;
-    mbedtls_entropy_context entropy;
-    int ret = 0;
-    unsigned char digest[HASH_VALUE_SIZE_IN_BYTES]; // sha256 digest of password
-    unsigned char
-        password_key[ENCRYPTION_KEY_SIZE_IN_BYTES]; // password generated key,
-                                                    // used to encrypt
-                                                    // encryption_key using
-                                                    // AES256-CBC
-    unsigned char
-        encrypted_key[ENCRYPTION_KEY_SIZE_IN_BYTES]; // encrypted encryption_key
-                                                     // using AES256-CBC
-    unsigned char salt[SALT_SIZE_IN_BYTES];
-    const char seed[] = "file_encryptor_sample";
-
-    if (header == nullptr)
-    {
-        // TRACE_ENCLAVE("prepare_encryption_header() failed with null argument"
-        //               " for encryption_header_t*");
-        goto exit;
-    }
-
-    mbedtls_entropy_init(&entropy);
-    mbedtls_ctr_drbg_init(&ctr_drbg);
-
-    // Initialize CTR-DRBG seed
-    ret = mbedtls_ctr_drbg_seed(
-        &ctr_drbg,
-        mbedtls_entropy_func,
-        &entropy,
-        (const unsigned char*)seed,
-        strlen(seed));
-    if (ret != 0)
-    {
-        // TRACE_ENCLAVE("mbedtls_ctr_drbg_seed() failed with -0x%04x", -ret);
-        goto exit;
-    }
-
-    // Generate random salt
-    ret = mbedtls_ctr_drbg_random(&ctr_drbg, salt, sizeof(salt));
-    if (ret != 0)
-    {
-        // TRACE_ENCLAVE("mbedtls_ctr_drbg_random() failed with -0x%04x", -ret);
-        goto exit;
-    }
-    memcpy(header->salt, salt, sizeof(salt));
-
-    // TRACE_ENCLAVE("prepare_encryption_header");
-    // derive a key from the password using PBDKF2
-    ret = generate_password_key(
-        password.c_str(), salt, password_key, sizeof(password_key));
-    if (ret != 0)
-    {
-        // TRACE_ENCLAVE("password_key");
-        for (unsigned int i = 0; i < sizeof(password_key); i++)
-            // TRACE_ENCLAVE(
-            //     "password_key[%d] =0x%02x", i, (unsigned int)(password_key[i]));
-        goto exit;
-    }
-
-    // produce a encryption key
-    // TRACE_ENCLAVE("produce a encryption key");
-    ret = generate_encryption_key(
-        (unsigned char*)m_encryption_key, ENCRYPTION_KEY_SIZE_IN_BYTES);
-    if (ret != 0)
-    {
-        // TRACE_ENCLAVE("Enclave: m_encryption_key");
-        for (unsigned int i = 0; i < ENCRYPTION_KEY_SIZE_IN_BYTES; i++)
-            // TRACE_ENCLAVE(
-            //     "m_encryption_key[%d] =0x%02x", i, m_encryption_key[i]);
-        goto exit;
-    }
-
-    // generate a digest for the password
-    // TRACE_ENCLAVE("generate a digest for the password");
-    ret = Sha256((const uint8_t*)password.c_str(), password.length(), digest);
-    if (ret)
-    {
-        TRACE_ENCLAVE("Sha256 failed with %d", ret);
-        goto exit;
-    }
-
-    memcpy(header->digest, digest, sizeof(digest));
-
-    // encrypt the encryption key with a password key
-    // TRACE_ENCLAVE("encrypt the encryption key with a psswd key");
-    ret = cipher_encryption_key(
-        ENCRYPT_OPERATION,
-        m_encryption_key,
-        ENCRYPTION_KEY_SIZE_IN_BYTES,
-        password_key,
-        salt, // iv for encryption, decryption. In this sample we use
-              // the salt in encryption header as iv.
-        encrypted_key,
-        sizeof(encrypted_key));
-    if (ret != 0)
-    {
-        // TRACE_ENCLAVE("EncryptEncryptionKey failed with [%d]", ret);
-        goto exit;
-    }
-    memcpy(header->encrypted_key, encrypted_key, sizeof(encrypted_key));
-    // TRACE_ENCLAVE("Done with prepare_encryption_header successfully.");
-exit:
-    mbedtls_ctr_drbg_free(&ctr_drbg);
-    mbedtls_entropy_free(&entropy);
-    return ret;
-}
-
-// Parse an input header for validating the password and getting the encryption
-// key in preparation for decryption/encryption operations
-//  1)Check password by comparing their digests
-//  2)reproduce a password key from the password
-//  3)decrypt the encryption key with a password key
-int ecall_dispatcher::parse_encryption_header(
-    encryption_header_t* header,
-    string password)
-{
-    int ret = 0;
-    if (header == nullptr)
-    {
-        // TRACE_ENCLAVE("parse_encryption_header() failed with a null argument"
-        //               " for encryption_header_t*");
-        goto exit;
-    }
-
-    unsigned char digest[HASH_VALUE_SIZE_IN_BYTES];
-    unsigned char password_key[ENCRYPTION_KEY_SIZE_IN_BYTES];
-    unsigned char salt[SALT_SIZE_IN_BYTES];
-
-    // check password by comparing their digests
-    ret =
-        Sha256((const uint8_t*)m_password.c_str(), m_password.length(), digest);
-    if (ret)
-    {
-        // TRACE_ENCLAVE("Sha256 failed with %d", ret);
-        goto exit;
-    }
-
-    if (memcmp(header->digest, digest, sizeof(digest)) != 0)
-    {
-        // TRACE_ENCLAVE("incorrect password");
-        ret = 1;
-        goto exit;
-    }
-
-    memcpy(salt, header->salt, sizeof(salt));
-
-    // derive a key from the password using PBDKF2
-    ret = generate_password_key(
-        password.c_str(), salt, password_key, sizeof(password_key));
-    if (ret != 0)
-    {
-        // TRACE_ENCLAVE("generate_password_key failed with %d", ret);
-        goto exit;
-    }
-
-    // decrypt the "encrypted encryption key" using the password key
-    ret = cipher_encryption_key(
-        DECRYPT_OPERATION,
-        header->encrypted_key,
-        ENCRYPTION_KEY_SIZE_IN_BYTES,
-        password_key,
-        salt, // iv for encryption, decryption. In this sample we use
-              // the salt in encryption header as iv.
-        (unsigned char*)m_encryption_key,
-        ENCRYPTION_KEY_SIZE_IN_BYTES);
-    if (ret != 0)
-    {
-        // TRACE_ENCLAVE("Enclave: m_encryption_key");
-        for (unsigned int i = 0; i < ENCRYPTION_KEY_SIZE_IN_BYTES; i++)
-            // TRACE_ENCLAVE(
-            //     "m_encryption_key[%d] =0x%02x", i, m_encryption_key[i]);
-        goto exit;
-    }
-
-exit:
-    return ret;
-}
-
-int ecall_dispatcher::process_encryption_header(encryption_header_t* header)
-{
-    int ret = 0;
-
-    if (header == nullptr)
-    {
-        // TRACE_ENCLAVE("process_encryption_header() failed with a null argument"
-                    //   " for encryption_header_t*");
-        goto exit;
-    }
-
-    if (m_encrypt)
-    {
-        // allocate host memory for the header and it will be returned back to
-        // the host
-        m_header =
-            (encryption_header_t*)oe_host_malloc(sizeof(encryption_header_t));
-        if (m_header == nullptr)
-        {
-            ret = 1;
-            goto exit;
-        }
-
-        ret = prepare_encryption_header(m_header, m_password);
-        if (ret != 0)
-        {
-            // TRACE_ENCLAVE("prepare_encryption_header failed with %d", ret);
-            goto exit;
-        }
-        memcpy(header, m_header, sizeof(encryption_header_t));
-    }
-    else
-    {
-        ret = parse_encryption_header(m_header, m_password);
-        if (ret != 0)
-        {
-            // TRACE_ENCLAVE("parse_encryption_header failed with %d", ret);
-            goto exit;
-        }
-    }
-exit:
-    return ret;
-}
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include <mbedtls/aes.h>
+#include <mbedtls/config.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/error.h>
+#include <mbedtls/md.h>
+#include <mbedtls/pk.h>
+#include <mbedtls/pkcs5.h>
+#include <mbedtls/rsa.h>
+#include <mbedtls/sha256.h>
+
+#include "common/encryptor.h"
+#include "common/trace.h"
+
+#define ENCRYPT_OPERATION true
+#define DECRYPT_OPERATION false
+
+// Compute the sha256 hash of given data.
+int ecall_dispatcher::Sha256(
+    const uint8_t* data,
+    size_t data_size,
+    uint8_t sha256[HASH_VALUE_SIZE_IN_BYTES])
+{
+    int ret = 0;
+    mbedtls_sha256_context ctx;
+
+    mbedtls_sha256_init(&ctx);
+
+    ret = mbedtls_sha256_starts_ret(&ctx, 0);
+    if (ret)
+        goto exit;
+
+    ret = mbedtls_sha256_update_ret(&ctx, data, data_size);
+    if (ret)
+        goto exit;
+
+    ret = mbedtls_sha256_finish_ret(&ctx, sha256);
+    if (ret)
+        goto exit;
+
+exit:
+    mbedtls_sha256_free(&ctx);
+    return ret;
+}
+
+// This routine uses the mbed_tls library to derive an AES key from the input
+// password and produces a password-based key.
+int ecall_dispatcher::generate_password_key(
+    const char* password,
+    const unsigned char* salt,
+    unsigned int iterations,
+    unsigned char* key,
+    unsigned int key_size)
+{
+    mbedtls_md_context_t sha_ctx;
+    const mbedtls_md_info_t* info_sha;
+    int ret = 0;
+    mbedtls_md_init(&sha_ctx);
+
+    // TRACE_ENCLAVE("generate_password_key");
+
+    memset(key, 0, key_size);
+    info_sha = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+    if (info_sha == nullptr)
+    {
+        ret = 1;
+        goto exit;
+    }
+
+    // setting up hash algorithm context
+    ret = mbedtls_md_setup(&sha_ctx, info_sha, 1);
+    if (ret != 0)
+    {
+        TRACE_ENCLAVE("mbedtls_md_setup() failed with -0x%04x", -ret);
+        goto exit;
+    }
+
+    // Derive a key from a password using PBKDF2.
+    // PBKDF2 (Password-Based Key Derivation Function 2) are key derivation
+    // functions with a sliding computational cost, aimed to reduce the
+    // vulnerability of encrypted keys to brute force attacks. See
+    // (https://en.wikipedia.org/wiki/PBKDF2) for more details.
+    ret = mbedtls_pkcs5_pbkdf2_hmac(
+        &sha_ctx,                       // Generic HMAC context
+        (const unsigned char*)password, // Password to use when generating key
+        strlen((const char*)password),  // Length of password
+        salt,                           // salt to use when generating key
+        SALT_SIZE_IN_BYTES,             // size of salt
+        iterations,                     // iteration count
+        key_size,                       // length of generated key in bytes
+        key);                           // generated key
+    if (ret != 0)
+    {
+        TRACE_ENCLAVE("mbedtls_pkcs5_pbkdf2_hmac failed with -0x%04x", -ret);
+        goto exit;
+    }
+    // TRACE_ENCLAVE("Key based on password successfully generated");
+exit:
+    mbedtls_md_free(&sha_ctx);
+    return ret;
+}
+
+// Returns the password key for salt and iterations, deriving it only if the
+// session has not derived it before. Files from one session share a salt, so
+// a session typically derives a single key however many files it handles.
+const unsigned char* ecall_dispatcher::get_password_key(
+    const unsigned char* salt,
+    unsigned int iterations)
+{
+    for (size_t i = 0; i < m_password_keys.size(); i++)
+    {
+        if (m_password_keys[i].iterations == iterations &&
+            memcmp(m_password_keys[i].salt, salt, SALT_SIZE_IN_BYTES) == 0)
+            return m_password_keys[i].key;
+    }
+
+    password_key_entry entry;
+    memcpy(entry.salt, salt, SALT_SIZE_IN_BYTES);
+    entry.iterations = iterations;
+    if (generate_password_key(
+            m_password.c_str(),
+            salt,
+            iterations,
+            entry.key,
+            sizeof(entry.key)) != 0)
+        return nullptr;
+
+    // Keep the session's own key and the most recent others
+    if (m_password_keys.size() >= MAX_SESSION_PASSWORD_KEYS)
+    {
+        size_t oldest = 0;
+        if (m_password_keys[0].iterations == m_kdf_iterations &&
+            memcmp(m_password_keys[0].salt, m_kdf_salt, SALT_SIZE_IN_BYTES) == 0)
+            oldest = 1;
+        oe_memset_s(
+            &m_password_keys[oldest], sizeof(m_password_keys[oldest]), 0,
+            sizeof(m_password_keys[oldest]));
+        m_password_keys.erase(m_password_keys.begin() + (long)oldest);
+    }
+    m_password_keys.push_back(entry);
+    oe_memset_s(&entry, sizeof(entry), 0, sizeof(entry));
+    return m_password_keys.back().key;
+}
+
+// Fills buf with random bytes from the session DRBG, which was seeded once by
+// open_session: salts and data keys no longer reseed from entropy per file
+int ecall_dispatcher::generate_random(unsigned char* buf, size_t size)
+{
+    int ret = mbedtls_ctr_drbg_random(&m_ctr_drbg, buf, size);
+    if (ret != 0)
+        TRACE_ENCLAVE("mbedtls_ctr_drbg_random failed with -0x%04x\n", -ret);
+    return ret;
+}
+
+// The encryption key is encrypted before it was written back to the encryption
+// header as part of the encryption metadata.
+int ecall_dispatcher::cipher_encryption_key(
+    bool encrypt,
+    unsigned char* input_data,
+    unsigned int input_data_size,
+    const unsigned char* encrypt_key,
+    unsigned char* iv,
+    unsigned char* output_data,
+    unsigned int output_data_size)
+{
+    int ret = 0;
+    (void)output_data_size;
+    mbedtls_aes_context aescontext;
+
+    // TRACE_ENCLAVE(
+    //     "cipher_encryption_key: %s", encrypt ? "encrypting" : "decrypting");
+
+    // init context
+    mbedtls_aes_init(&aescontext);
+
+    // set aes key
+    if (encrypt)
+    {
+        ret = mbedtls_aes_setkey_enc(
+            &aescontext, encrypt_key, ENCRYPTION_KEY_SIZE);
+    }
+    else
+    {
+        ret = mbedtls_aes_setkey_dec(
+            &aescontext, encrypt_key, ENCRYPTION_KEY_SIZE);
+    }
+    if (ret != 0)
+    {
+        // TRACE_ENCLAVE("mbedtls_aes_setkey_enc/dec failed with %d", ret);
+        goto exit;
+    }
+
+    ret = mbedtls_aes_crypt_cbc(
+        &aescontext,
+        encrypt ? MBEDTLS_AES_ENCRYPT : MBEDTLS_AES_DECRYPT,
+        input_data_size, // input data length in bytes,
+        iv,              // Initialization vector (updated after use)
+        input_data,
+        output_data);
+    if (ret != 0)
+    {
+        // TRACE_ENCLAVE("mbedtls_aes_crypt_cbc failed with %d", ret);
+    }
+exit:
+    // free aes context
+    mbedtls_aes_free(&aescontext);
+    // TRACE_ENCLAVE("ecall_dispatcher::cipher_encryption_key");
+    return ret;
+}
+
+// For an encryption operation, the encryptor creates encryption metadata for
+// writing back to the encryption header, which includes the following fields:
+// digest: a hash value of the password
+// key: encrypted version of the encryption key
+//
+// Operations involves the following operations:
+//  1)take the session's password key, derived by open_session
+//  2)produce a encryption key
+//  3)take the session's digest of the password
+//  4)encrypt the encryption key with a password key
+//
+int ecall_dispatcher::prepare_encryption_header(
+    encryption_header_t* header,
+    unsigned char* encryption_key)
+{
+    int ret = 0;
+    const unsigned char* password_key = nullptr; // password generated key,
+                                                 // used to encrypt
+                                                 // encryption_key using
+                                                 // AES256-CBC
+    unsigned char
+        encrypted_key[ENCRYPTION_KEY_SIZE_IN_BYTES]; // encrypted encryption_key
+                                                     // using AES256-CBC
+    unsigned char salt[SALT_SIZE_IN_BYTES];
+
+    if (header == nullptr)
+    {
+        // TRACE_ENCLAVE("prepare_encryption_header() failed with null argument"
+        //               " for encryption_header_t*");
+        goto exit;
+    }
+
+    // Generate random salt
+    ret = generate_random(salt, sizeof(salt));
+    if (ret != 0)
+    {
+        // TRACE_ENCLAVE("mbedtls_ctr_drbg_random() failed with -0x%04x", -ret);
+        goto exit;
+    }
+    memset(header, 0, sizeof(*header));
+    memcpy(header->salt, salt, sizeof(salt));
+    memcpy(header->kdf_salt, m_kdf_salt, sizeof(m_kdf_salt));
+    header->magic = ENCRYPTION_HEADER_MAGIC;
+    header->version = ENCRYPTION_HEADER_VERSION;
+    header->kdf_iterations = m_kdf_iterations;
+
+    // TRACE_ENCLAVE("prepare_encryption_header");
+    // the password key was derived with PBDKF2 when the session was opened
+    password_key = get_password_key(m_kdf_salt, m_kdf_iterations);
+    if (password_key == nullptr)
+    {
+        ret = 1;
+        goto exit;
+    }
+
+    // produce a encryption key
+    // TRACE_ENCLAVE("produce a encryption key");
+    ret = generate_random(encryption_key, ENCRYPTION_KEY_SIZE_IN_BYTES);
+    if (ret != 0)
+    {
+        // TRACE_ENCLAVE("Enclave: encryption_key");
+        goto exit;
+    }
+
+    memcpy(header->digest, m_digest, sizeof(m_digest));
+
+    // encrypt the encryption key with a password key
+    // TRACE_ENCLAVE("encrypt the encryption key with a psswd key");
+    ret = cipher_encryption_key(
+        ENCRYPT_OPERATION,
+        encryption_key,
+        ENCRYPTION_KEY_SIZE_IN_BYTES,
+        password_key,
+        salt, // iv for encryption, decryption. In this sample we use
+              // the salt in encryption header as iv.
+        encrypted_key,
+        sizeof(encrypted_key));
+    if (ret != 0)
+    {
+        // TRACE_ENCLAVE("EncryptEncryptionKey failed with [%d]", ret);
+        goto exit;
+    }
+    memcpy(header->encrypted_key, encrypted_key, sizeof(encrypted_key));
+    // TRACE_ENCLAVE("Done with prepare_encryption_header successfully.");
+exit:
+    return ret;
+}
+
+// Parse an input header for validating the password and getting the encryption
+// key in preparation for decryption/encryption operations
+//  1)Check password by comparing their digests
+//  2)reproduce a password key from the password
+//  3)decrypt the encryption key with a password key
+int ecall_dispatcher::parse_encryption_header(
+    encryption_header_t* header,
+    unsigned char* encryption_key)
+{
+    int ret = 0;
+    if (header == nullptr)
+    {
+        // TRACE_ENCLAVE("parse_encryption_header() failed with a null argument"
+        //               " for encryption_header_t*");
+        goto exit;
+    }
+
+    const unsigned char* password_key;
+    unsigned char salt[SALT_SIZE_IN_BYTES];
+
+    ret = check_encryption_header(header);
+    if (ret != 0)
+        goto exit;
+
+    // check password by comparing their digests; the session's digest was
+    // computed when it was opened
+    if (memcmp(header->digest, m_digest, sizeof(m_digest)) != 0)
+    {
+        // TRACE_ENCLAVE("incorrect password");
+        ret = 1;
+        goto exit;
+    }
+
+    memcpy(salt, header->salt, sizeof(salt));
+
+    // derive a key from the password using PBDKF2, unless the session already
+    // has, typically for the file's session of origin
+    password_key = get_password_key(header->kdf_salt, header->kdf_iterations);
+    if (password_key == nullptr)
+    {
+        // TRACE_ENCLAVE("generate_password_key failed");
+        ret = 1;
+        goto exit;
+    }
+
+    // decrypt the "encrypted encryption key" using the password key
+    ret = cipher_encryption_key(
+        DECRYPT_OPERATION,
+        header->encrypted_key,
+        ENCRYPTION_KEY_SIZE_IN_BYTES,
+        password_key,
+        salt, // iv for encryption, decryption. In this sample we use
+              // the salt in encryption header as iv.
+        encryption_key,
+        ENCRYPTION_KEY_SIZE_IN_BYTES);
+    if (ret != 0)
+    {
+        // TRACE_ENCLAVE("Enclave: encryption_key");
+        goto exit;
+    }
+
+exit:
+    return ret;
+}
+
+// Rejects headers of other formats and iteration counts outside the range
+// this enclave derives keys for
+int ecall_dispatcher::check_encryption_header(const encryption_header_t* header)
+{
+    if (header->magic != ENCRYPTION_HEADER_MAGIC ||
+        header->version != ENCRYPTION_HEADER_VERSION)
+    {
+        TRACE_ENCLAVE("unsupported encryption header version");
+        return 1;
+    }
+
+    if (header->kdf_iterations < MIN_KDF_ITERATIONS ||
+        header->kdf_iterations > MAX_KDF_ITERATIONS)
+    {
+        TRACE_ENCLAVE("unsupported kdf iteration count");
+        return 1;
+    }
+    return 0;
+}
+
+// Rotates the password of an encrypted file without touching its data:
+//  1)check old_password against the header digest
+//  2)decrypt the data key with the old password key
+//  3)encrypt it again with the session's password key, which has its own
+//    salt and iteration count
+//  4)store the session's salt, iteration count and digest in the header
+// The data key never leaves the enclave and the header salt, which is also
+// the IV of the data, is kept.
+int ecall_dispatcher::rekey(
+    const char* old_password,
+    size_t old_password_len,
+    encryption_header_t* header)
+{
+    int ret = 0;
+    string password(old_password, old_password + old_password_len);
+    unsigned char digest[HASH_VALUE_SIZE_IN_BYTES];
+    unsigned char encryption_key[ENCRYPTION_KEY_SIZE_IN_BYTES];
+    unsigned char salt[SALT_SIZE_IN_BYTES];
+    const unsigned char* password_key = nullptr;
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    if (!m_session_open)
+    {
+        TRACE_ENCLAVE("rekey() called without an open session");
+        ret = 1;
+        goto exit;
+    }
+    ret = check_encryption_header(header);
+    if (ret != 0)
+        goto exit;
+
+    ret = Sha256((const uint8_t*)password.c_str(), password.length(), digest);
+    if (ret != 0)
+        goto exit;
+    if (memcmp(header->digest, digest, sizeof(digest)) != 0)
+    {
+        // TRACE_ENCLAVE("incorrect password");
+        ret = 1;
+        goto exit;
+    }
+
+    // the old password key, derived only if the last file had another
+    if (!m_old_key_valid || memcmp(m_old_digest, digest, sizeof(digest)) != 0 ||
+        m_old_key.iterations != header->kdf_iterations ||
+        memcmp(m_old_key.salt, header->kdf_salt, SALT_SIZE_IN_BYTES) != 0)
+    {
+        m_old_key_valid = false;
+        memcpy(m_old_key.salt, header->kdf_salt, SALT_SIZE_IN_BYTES);
+        m_old_key.iterations = header->kdf_iterations;
+        ret = generate_password_key(
+            password.c_str(),
+            m_old_key.salt,
+            m_old_key.iterations,
+            m_old_key.key,
+            sizeof(m_old_key.key));
+        if (ret != 0)
+            goto exit;
+        memcpy(m_old_digest, digest, sizeof(digest));
+        m_old_key_valid = true;
+    }
+
+    memcpy(salt, header->salt, sizeof(salt));
+    ret = cipher_encryption_key(
+        DECRYPT_OPERATION,
+        header->encrypted_key,
+        ENCRYPTION_KEY_SIZE_IN_BYTES,
+        m_old_key.key,
+        salt,
+        encryption_key,
+        ENCRYPTION_KEY_SIZE_IN_BYTES);
+    if (ret != 0)
+        goto exit;
+
+    password_key = get_password_key(m_kdf_salt, m_kdf_iterations);
+    if (password_key == nullptr)
+    {
+        ret = 1;
+        goto exit;
+    }
+    memcpy(salt, header->salt, sizeof(salt));
+    ret = cipher_encryption_key(
+        ENCRYPT_OPERATION,
+        encryption_key,
+        ENCRYPTION_KEY_SIZE_IN_BYTES,
+        password_key,
+        salt,
+        header->encrypted_key,
+        ENCRYPTION_KEY_SIZE_IN_BYTES);
+    if (ret != 0)
+        goto exit;
+
+    memcpy(header->kdf_salt, m_kdf_salt, sizeof(m_kdf_salt));
+    header->kdf_iterations = m_kdf_iterations;
+    memcpy(header->digest, m_digest, sizeof(m_digest));
+
+exit:
+    oe_memset_s(encryption_key, sizeof(encryption_key), 0, sizeof(encryption_key));
+    if (!password.empty())
+        oe_memset_s(&password[0], password.size(), 0, password.size());
+    return ret;
+}
+
+// Called with m_lock held, as the session's DRBG and key cache are shared by
+// every file
+int ecall_dispatcher::process_encryption_header(
+    bool encrypt,
+    encryption_header_t* header,
+    unsigned char* encryption_key)
+{
+    int ret = 0;
+
+    if (header == nullptr)
+    {
+        // TRACE_ENCLAVE("process_encryption_header() failed with a null argument"
+                    //   " for encryption_header_t*");
+        goto exit;
+    }
+
+    // The header is marshalled in and out of the enclave by the ecall, so it
+    // is filled in, or parsed, in place
+    if (encrypt)
+    {
+        ret = prepare_encryption_header(header, encryption_key);
+        if (ret != 0)
+        {
+            // TRACE_ENCLAVE("prepare_encryption_header failed with %d", ret);
+            goto exit;
+        }
+    }
+    else
+    {
+        ret = parse_encryption_header(header, encryption_key);
+        if (ret != 0)
+        {
+            // TRACE_ENCLAVE("parse_encryption_header failed with %d", ret);
+            goto exit;
+        }
+    }
+exit:
+    return ret;
+}
@@ -0,0 +1,245 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#define _CRT_SECURE_NO_WARNINGS
+#include "bench.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+static int timed_run(const std::function<int(uint64_t)>& run, uint64_t iterations, double* seconds)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int ret = run(iterations);
+    *seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return ret;
+}
+
+int bench_measure(
+    const std::function<int(uint64_t)>& run,
+    double min_seconds,
+    size_t repeats,
+    bench_result* result)
+{
+    std::vector<double> times;
+    uint64_t iterations = 1;
+    double seconds = 0;
+
+    // the warm-up run also pages in whatever the runs touch
+    while (min_seconds > 0)
+    {
+        if (timed_run(run, iterations, &seconds) != 0)
+            return 1;
+        if (seconds >= min_seconds || iterations >= ((uint64_t)1 << 40))
+            break;
+        iterations *= 2;
+    }
+    for (size_t r = 0; r < repeats; r++)
+    {
+        if (timed_run(run, iterations, &seconds) != 0)
+            return 1;
+        times.push_back(seconds / (double)iterations);
+    }
+    std::sort(times.begin(), times.end());
+    result->iterations = iterations;
+    result->repeats = repeats;
+    result->best = times.empty() ? 0 : times[0];
+    result->median = times.empty() ? 0 : times[times.size() / 2];
+    return 0;
+}
+
+static std::string json_string(const std::string& value)
+{
+    std::string out = "\"";
+    for (size_t i = 0; i < value.size(); i++)
+    {
+        unsigned char c = (unsigned char)value[i];
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += (char)c;
+        }
+        else if (c < 0x20)
+        {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", c);
+            out += escape;
+        }
+        else
+            out += (char)c;
+    }
+    return out + "\"";
+}
+
+static std::string json_number(double value)
+{
+    char text[64];
+    if (!isfinite(value))
+        return "null";
+    snprintf(text, sizeof(text), "%.9g", value);
+    return text;
+}
+
+static void json_member(std::string* object, const char* key, const std::string& value)
+{
+    if (!object->empty())
+        *object += ", ";
+    *object += json_string(key) + ": " + value;
+}
+
+void bench_report::context(const char* key, const std::string& value)
+{
+    json_member(&m_context, key, json_string(value));
+}
+
+void bench_report::context(const char* key, double value)
+{
+    json_member(&m_context, key, json_number(value));
+}
+
+void bench_report::param(const char* key, const std::string& value)
+{
+    json_member(&m_params, key, json_string(value));
+}
+
+void bench_report::param(const char* key, double value)
+{
+    json_member(&m_params, key, json_number(value));
+}
+
+void bench_report::add(const char* name, const bench_result& result, double bytes)
+{
+    std::string entry;
+    std::string ns;
+
+    json_member(&entry, "name", json_string(name));
+    json_member(&entry, "params", "{" + m_params + "}");
+    json_member(&entry, "iterations", json_number((double)result.iterations));
+    json_member(&entry, "repeats", json_number((double)result.repeats));
+    json_member(&ns, "median", json_number(result.median * 1e9));
+    json_member(&ns, "min", json_number(result.best * 1e9));
+    json_member(&entry, "ns_per_op", "{" + ns + "}");
+    if (bytes > 0 && result.median > 0)
+        json_member(&entry, "mb_per_s", json_number(bytes / result.median / 1e6));
+    if (!m_benchmarks.empty())
+        m_benchmarks += ",\n    ";
+    m_benchmarks += "{" + entry + "}";
+    m_params.clear();
+}
+
+int bench_report::write(FILE* file) const
+{
+    std::string text = "{\n  \"context\": {" + m_context + "},\n  \"benchmarks\": [\n    " +
+                       m_benchmarks + "\n  ]\n}\n";
+    if (fwrite(text.data(), 1, text.size(), file) != text.size() || fflush(file) != 0)
+        return 1;
+    return 0;
+}
+
+std::string shape_name(const bench_shape& shape)
+{
+    char name[64];
+    char hidden[16] = "";
+    if (shape.num_hidden)
+        snprintf(hidden, sizeof(hidden), "-h%d", shape.num_hidden);
+    snprintf(name, sizeof(name), "d%dx%d%s%s%s", shape.num_detectors, shape.detector_len,
+             shape.has_avg_pooling ? "-avg" : "", hidden, shape.reverse_complement ? "-rc" : "");
+    return name;
+}
+
+// A linear congruential generator: fixed, so that runs can be compared
+static uint32_t next_random(uint32_t* state)
+{
+    *state = *state * 1103515245u + 12345u;
+    return *state >> 16;
+}
+
+static float* random_params(size_t count, uint32_t* state)
+{
+    float* params = (float*)malloc(sizeof(float) * (count ? count : 1));
+    for (size_t i = 0; i < count; i++)
+        params[i] = (float)(next_random(state) & 0x7fff) / 32768.0f - 0.5f;
+    return params;
+}
+
+deepbind_model_t* synthetic_model(const bench_shape& shape, uint32_t seed)
+{
+    deepbind_model_t* model = (deepbind_model_t*)malloc(sizeof(deepbind_model_t));
+    uint32_t state = seed;
+    int hidden1 = shape.has_avg_pooling ? shape.num_detectors * 2 : shape.num_detectors;
+    int hidden2 = shape.num_hidden ? shape.num_hidden : 1;
+
+    memset(model, 0, sizeof(*model));
+    // model ids that no parameter file has
+    model->id.major = 90000;
+    model->id.minor = (int)seed;
+    model->reverse_complement = shape.reverse_complement;
+    model->num_detectors = shape.num_detectors;
+    model->detector_len = shape.detector_len;
+    model->has_avg_pooling = shape.has_avg_pooling;
+    model->num_hidden = shape.num_hidden;
+    model->detectors = random_params((size_t)(shape.num_detectors * shape.detector_len * 4), &state);
+    model->thresholds = random_params((size_t)shape.num_detectors, &state);
+    model->weights1 = random_params((size_t)(hidden1 * hidden2), &state);
+    model->biases1 = random_params((size_t)hidden2, &state);
+    model->weights2 = random_params((size_t)shape.num_hidden, &state);
+    model->biases2 = random_params(shape.num_hidden ? 1 : 0, &state);
+    return model;
+}
+
+void free_model(deepbind_model_t* model)
+{
+    if (!model)
+        return;
+    free(model->detectors);
+    free(model->thresholds);
+    free(model->weights1);
+    free(model->biases1);
+    free(model->weights2);
+    free(model->biases2);
+    free(model);
+}
+
+void synthetic_bases(unsigned char* bases, size_t count, uint32_t* state)
+{
+    for (size_t i = 0; i < count; i++)
+        bases[i] = (unsigned char)"ACGT"[next_random(state) & 3];
+}
+
+int write_synthetic_sequences(const char* path, uint64_t size, uint32_t seed)
+{
+    std::vector<unsigned char> buffer;
+    uint32_t state = seed;
+    uint64_t written = 0;
+    FILE* file = fopen(path, "wb");
+    int ret = 0;
+
+    if (!file)
+        return 1;
+    buffer.reserve(1024 * 1024 + SYNTHETIC_MAX_LENGTH + 1);
+    while (written < size)
+    {
+        size_t length = SYNTHETIC_MIN_LENGTH +
+                        next_random(&state) % (SYNTHETIC_MAX_LENGTH - SYNTHETIC_MIN_LENGTH + 1);
+        size_t at = buffer.size();
+        buffer.resize(at + length + 1);
+        synthetic_bases(&buffer[at], length, &state);
+        buffer[at + length] = '\n';
+        written += length + 1;
+        if (buffer.size() >= 1024 * 1024 || written >= size)
+        {
+            if (fwrite(&buffer[0], 1, buffer.size(), file) != buffer.size())
+            {
+                ret = 1;
+                break;
+            }
+            buffer.clear();
+        }
+    }
+    if (fclose(file) != 0)
+        ret = 1;
+    return ret;
+}
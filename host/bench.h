@@ -0,0 +1,92 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <functional>
+#include <string>
+#include <vector>
+#include "../shared.h"
+
+// Support for the bench operation: timing, a JSON report, and synthetic
+// models and sequences. Everything synthetic comes from a fixed seed, so
+// that two runs of one build score and encrypt the same data.
+
+#ifdef _WIN32
+#define BENCH_NULL_DEVICE "NUL"
+#else
+#define BENCH_NULL_DEVICE "/dev/null"
+#endif
+
+// A measurement is repeated BENCH_REPEATS times, after a warm-up run that
+// doubles the iterations until one run takes BENCH_MIN_SECONDS
+#define BENCH_REPEATS 5
+#define BENCH_MIN_SECONDS 0.02
+
+struct bench_result
+{
+    uint64_t iterations; // per repeat
+    size_t repeats;
+    double median;       // seconds per iteration
+    double best;
+};
+
+// Times run(iterations), which returns non-zero if it failed. With
+// min_seconds 0 there is no warm-up and every run is of one iteration, for
+// end-to-end runs that take a while. Returns non-zero if any run failed.
+int bench_measure(
+    const std::function<int(uint64_t)>& run,
+    double min_seconds,
+    size_t repeats,
+    bench_result* result);
+
+// bench_report collects results and writes them as one JSON object:
+// {"context": {...}, "benchmarks": [{"name": ..., "params": {...},
+// "iterations": ..., "repeats": ..., "ns_per_op": {"median": ..., "min": ...},
+// "mb_per_s": ...}, ...]}, mb_per_s only where an operation has a size
+class bench_report
+{
+  private:
+    std::string m_context;
+    std::string m_benchmarks;
+    std::string m_params; // of the benchmark being described
+
+  public:
+    void context(const char* key, const std::string& value);
+    void context(const char* key, double value);
+    void param(const char* key, const std::string& value);
+    void param(const char* key, double value);
+    // Adds a benchmark with the params given since the last one, bytes
+    // being the size of one operation, or 0
+    void add(const char* name, const bench_result& result, double bytes);
+    int write(FILE* file) const;
+};
+
+// A model shape: the fields of deepbind_model_t that set its cost
+struct bench_shape
+{
+    int reverse_complement;
+    int num_detectors;
+    int detector_len;
+    int has_avg_pooling;
+    int num_hidden;
+};
+std::string shape_name(const bench_shape& shape);
+
+// A model of shape with parameters drawn from seed, allocated as load_model
+// allocates them; free_model frees either
+deepbind_model_t* synthetic_model(const bench_shape& shape, uint32_t seed);
+void free_model(deepbind_model_t* model);
+
+// Fills bases[0..count) with A, C, G and T drawn from *state
+void synthetic_bases(unsigned char* bases, size_t count, uint32_t* state);
+
+// Writes about size bytes of sequence text to path, one record per line of
+// SYNTHETIC_MIN_LENGTH to SYNTHETIC_MAX_LENGTH bases, drawn from seed.
+// Returns non-zero on failure.
+#define SYNTHETIC_MIN_LENGTH 20
+#define SYNTHETIC_MAX_LENGTH 200
+int write_synthetic_sequences(const char* path, uint64_t size, uint32_t seed);
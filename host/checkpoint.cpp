@@ -0,0 +1,135 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#define _CRT_SECURE_NO_WARNINGS
+#include "checkpoint.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static int sync_file(FILE* file)
+{
+    if (fflush(file) != 0)
+        return 1;
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0 ? 0 : 1;
+#else
+    return fsync(fileno(file)) == 0 ? 0 : 1;
+#endif
+}
+
+checkpoint_writer::checkpoint_writer(
+    const string& path,
+    FILE* output,
+    const scoring_checkpoint_t& state)
+    : m_path(path), m_output(output), m_flush(NULL), m_flush_context(NULL),
+      m_state(state), m_saved(chrono::steady_clock::now())
+{
+}
+
+void checkpoint_writer::set_flush(output_flush flush, void* context)
+{
+    m_flush = flush;
+    m_flush_context = context;
+}
+
+int checkpoint_writer::add_records(size_t records, size_t chunks)
+{
+    m_state.records += records;
+    m_state.chunks += chunks;
+    if (chrono::steady_clock::now() - m_saved <
+        chrono::seconds(CHECKPOINT_INTERVAL_SECONDS))
+        return 0;
+    return save();
+}
+
+int checkpoint_writer::save()
+{
+    string temp = m_path + ".tmp";
+    FILE* file = NULL;
+    long size;
+
+    // The rows must be on disk before a checkpoint that counts them
+    if ((m_flush && m_flush(m_flush_context) != 0) || sync_file(m_output) != 0 || (size = ftell(m_output)) < 0)
+        return 1;
+    m_state.magic = CHECKPOINT_MAGIC;
+    m_state.output_size = (size_t)size;
+
+    file = fopen(temp.c_str(), "wb");
+    if (!file)
+        return 1;
+    if (fwrite(&m_state, 1, sizeof(m_state), file) != sizeof(m_state) ||
+        sync_file(file) != 0)
+    {
+        fclose(file);
+        remove(temp.c_str());
+        return 1;
+    }
+    fclose(file);
+#ifdef _WIN32
+    // rename does not replace an existing file here
+    remove(m_path.c_str());
+#endif
+    if (rename(temp.c_str(), m_path.c_str()) != 0)
+        return 1;
+    m_saved = chrono::steady_clock::now();
+    return 0;
+}
+
+int read_checkpoint(const char* path, scoring_checkpoint_t* state, bool* found)
+{
+    FILE* file = fopen(path, "rb");
+    size_t count;
+
+    *found = false;
+    if (!file)
+        return errno == ENOENT ? 0 : 1;
+    count = fread(state, 1, sizeof(*state), file);
+    fclose(file);
+    if (count != sizeof(*state) || state->magic != CHECKPOINT_MAGIC)
+        return 1;
+    *found = true;
+    return 0;
+}
+
+int remove_checkpoint(const char* path)
+{
+    if (remove(path) != 0 && errno != ENOENT)
+        return 1;
+    return 0;
+}
+
+FILE* open_truncated(const char* path, size_t size)
+{
+    FILE* file = fopen(path, "r+b");
+    struct stat st;
+    int ret = 0;
+
+    if (!file)
+        return NULL;
+    if (fstat(fileno(file), &st) != 0 || (size_t)st.st_size < size)
+    {
+        fclose(file);
+        return NULL;
+    }
+#ifdef _WIN32
+    ret = _chsize_s(_fileno(file), (long long)size);
+#else
+    ret = ftruncate(fileno(file), (off_t)size);
+#endif
+    if (ret != 0 || fseek(file, 0, SEEK_END) != 0)
+    {
+        fclose(file);
+        return NULL;
+    }
+    return file;
+}
@@ -0,0 +1,74 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdio.h>
+#include <chrono>
+#include <string>
+#include "../shared.h"
+
+#define CHECKPOINT_MAGIC 0x4b434458 // "XDCK"
+#define CHECKPOINT_INTERVAL_SECONDS 30
+
+// scoring_checkpoint_t records how far a decrypt run has got, so that it can
+// continue after the process dies. Score rows written after the checkpoint
+// are cut off again on resume, so every record is scored into the output
+// exactly once.
+// salt, file_data_size: identify the encrypted file being scored
+// selection: hash of the records selected and the model set used
+// records: score rows written, counted across the selected records
+// chunks: sealed score chunks written, if the scores are sealed
+// output_size: size of the score file holding those rows
+typedef struct _scoring_checkpoint
+{
+    unsigned int magic;
+    unsigned int reserved;
+    unsigned char salt[SALT_SIZE_IN_BYTES];
+    size_t file_data_size;
+    size_t selection;
+    size_t records;
+    size_t chunks;
+    size_t output_size;
+} scoring_checkpoint_t;
+
+// Called by checkpoint_writer with its context before the output is synced,
+// to write out rows the caller still buffers; returns non-zero on failure
+typedef int (*output_flush)(void* context);
+
+// checkpoint_writer counts the rows written to a score file and saves a
+// checkpoint for it at most every CHECKPOINT_INTERVAL_SECONDS. The score file
+// is synced before each checkpoint, and each checkpoint replaces the last in
+// one rename, so a crash leaves either the old or the new one.
+class checkpoint_writer
+{
+  private:
+    std::string m_path;
+    FILE* m_output;
+    output_flush m_flush;
+    void* m_flush_context;
+    scoring_checkpoint_t m_state;
+    std::chrono::steady_clock::time_point m_saved;
+
+  public:
+    checkpoint_writer(
+        const std::string& path,
+        FILE* output,
+        const scoring_checkpoint_t& state);
+    void set_flush(output_flush flush, void* context);
+    int add_records(size_t records, size_t chunks);
+    int save();
+    const scoring_checkpoint_t& state() const
+    {
+        return m_state;
+    }
+};
+
+// Reads the checkpoint at path; *found is false if there is none
+int read_checkpoint(const char* path, scoring_checkpoint_t* state, bool* found);
+int remove_checkpoint(const char* path);
+
+// Opens an existing output file for appending after cutting it back to size
+// bytes, or returns NULL if it is shorter than that
+FILE* open_truncated(const char* path, size_t size);
@@ -0,0 +1,428 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include "daemon.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+// Connections served at once; further ones are closed straight away
+#define MAX_DAEMON_CLIENTS 64
+
+// Latencies kept per operation for the percentiles
+#define DAEMON_LATENCY_SAMPLES 65536
+
+// How often blocked threads look for a shutdown, in milliseconds
+#define DAEMON_POLL_INTERVAL 200
+
+#define DAEMON_READ_SIZE (64 * 1024)
+
+static atomic<bool> stopping(false);
+
+static void on_stop_signal(int)
+{
+    stopping = true;
+}
+
+// Counting semaphore over the enclave's TCS slots. Every request that makes
+// ecalls holds a slot for as long as it is in the enclave, so any number of
+// clients can be connected without running out of TCS.
+class slot_pool
+{
+  private:
+    mutex m_lock;
+    condition_variable m_freed;
+    size_t m_free;
+
+  public:
+    explicit slot_pool(size_t slots) : m_free(slots)
+    {
+    }
+    void acquire()
+    {
+        unique_lock<mutex> lock(m_lock);
+        m_freed.wait(lock, [this]() { return m_free > 0; });
+        m_free--;
+    }
+    void release()
+    {
+        {
+            lock_guard<mutex> lock(m_lock);
+            m_free++;
+        }
+        m_freed.notify_one();
+    }
+};
+
+// Ring of the most recent latencies of one operation
+class latency_log
+{
+  private:
+    mutex m_lock;
+    vector<uint64_t> m_samples;
+    size_t m_next;
+    uint64_t m_count;
+    uint64_t m_max;
+
+  public:
+    latency_log() : m_next(0), m_count(0), m_max(0)
+    {
+    }
+
+    void add(uint64_t us)
+    {
+        lock_guard<mutex> lock(m_lock);
+        if (m_samples.size() < DAEMON_LATENCY_SAMPLES)
+            m_samples.push_back(us);
+        else
+            m_samples[m_next] = us;
+        m_next = (m_next + 1) % DAEMON_LATENCY_SAMPLES;
+        m_count++;
+        m_max = max(m_max, us);
+    }
+
+    void get(uint32_t type, daemon_latency_t* out)
+    {
+        vector<uint64_t> sorted;
+        {
+            lock_guard<mutex> lock(m_lock);
+            sorted = m_samples;
+            out->count = m_count;
+            out->max_us = m_max;
+        }
+        out->type = type;
+        out->reserved = 0;
+        sort(sorted.begin(), sorted.end());
+        out->p50_us = percentile(sorted, 50);
+        out->p90_us = percentile(sorted, 90);
+        out->p99_us = percentile(sorted, 99);
+    }
+
+  private:
+    static uint64_t percentile(const vector<uint64_t>& sorted, size_t p)
+    {
+        if (sorted.empty())
+            return 0;
+        return sorted[(sorted.size() - 1) * p / 100];
+    }
+};
+
+struct daemon_state
+{
+    const daemon_handlers* handlers;
+    slot_pool* slots;
+    latency_log latencies[DAEMON_STATS]; // indexed by request type
+    atomic<size_t> clients;
+};
+
+// Sends all of data, waiting out short writes
+static bool send_all(int fd, const unsigned char* data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        data += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+static void append_frame(
+    vector<unsigned char>* out,
+    const daemon_frame_header& request,
+    uint16_t status,
+    const void* payload,
+    size_t length)
+{
+    daemon_frame_header header;
+    header.magic = DAEMON_MAGIC;
+    header.type = request.type;
+    header.status = status;
+    header.id = request.id;
+    header.length = (uint32_t)length;
+    const unsigned char* bytes = (const unsigned char*)&header;
+    out->insert(out->end(), bytes, bytes + sizeof(header));
+    if (length > 0)
+        out->insert(out->end(), (const unsigned char*)payload, (const unsigned char*)payload + length);
+}
+
+static void append_error(
+    vector<unsigned char>* out,
+    const daemon_frame_header& request,
+    uint16_t status,
+    const string& message)
+{
+    append_frame(out, request, status, message.data(), message.size());
+}
+
+// Splits a file request payload into its three NUL terminated fields
+static bool parse_file_request(
+    const unsigned char* payload,
+    size_t length,
+    string* password,
+    string* input,
+    string* output)
+{
+    string* fields[] = {password, input, output};
+    size_t pos = 0;
+    for (size_t i = 0; i < 3; i++)
+    {
+        const void* end = memchr(payload + pos, '\0', length - pos);
+        if (end == NULL)
+            return false;
+        size_t size = (size_t)((const unsigned char*)end - (payload + pos));
+        fields[i]->assign((const char*)payload + pos, size);
+        pos += size + 1;
+    }
+    return pos == length && !input->empty() && !output->empty();
+}
+
+// Serves one complete request and queues its response in out
+static void serve_request(
+    daemon_state* state,
+    const daemon_frame_header& request,
+    const unsigned char* payload,
+    vector<unsigned char>* out)
+{
+    const daemon_handlers& handlers = *state->handlers;
+    auto start = chrono::steady_clock::now();
+    string message;
+    int ret = 0;
+
+    switch (request.type)
+    {
+        case DAEMON_SCORE:
+        {
+            vector<float> scores;
+            size_t rows = 0;
+            state->slots->acquire();
+            ret = handlers.score((const char*)payload, request.length, &scores, &rows, &message);
+            state->slots->release();
+            if (ret != 0)
+                break;
+            uint32_t counts[2] = {(uint32_t)rows, (uint32_t)handlers.modelcount};
+            vector<unsigned char> response(sizeof(counts) + scores.size() * sizeof(float));
+            memcpy(&response[0], counts, sizeof(counts));
+            if (!scores.empty())
+                memcpy(&response[sizeof(counts)], scores.data(), scores.size() * sizeof(float));
+            append_frame(out, request, DAEMON_OK, response.data(), response.size());
+            break;
+        }
+        case DAEMON_ENCRYPT:
+        case DAEMON_DECRYPT:
+        {
+            string password, input, output;
+            if (!parse_file_request(payload, request.length, &password, &input, &output))
+            {
+                append_error(out, request, DAEMON_BAD_REQUEST, "malformed file request");
+                return;
+            }
+            state->slots->acquire();
+            ret = handlers.process_file(request.type == DAEMON_ENCRYPT, password, input, output, &message);
+            state->slots->release();
+            if (ret == 0)
+                append_frame(out, request, DAEMON_OK, NULL, 0);
+            break;
+        }
+        case DAEMON_STATS:
+        {
+            daemon_latency_t stats[DAEMON_STATS - 1];
+            for (uint32_t type = DAEMON_SCORE; type < DAEMON_STATS; type++)
+                state->latencies[type].get(type, &stats[type - 1]);
+            append_frame(out, request, DAEMON_OK, stats, sizeof(stats));
+            return;
+        }
+        default:
+            append_error(out, request, DAEMON_BAD_REQUEST, "unknown request type");
+            return;
+    }
+
+    if (ret != 0)
+        append_error(out, request, DAEMON_FAILED, message);
+    state->latencies[request.type].add((uint64_t)chrono::duration_cast<chrono::microseconds>(
+                                           chrono::steady_clock::now() - start)
+                                           .count());
+}
+
+// Reads requests from one client until it disconnects. Pipelined requests
+// arrive together, so every complete request in the buffer is served before
+// the responses go out in one send.
+static void serve_client(daemon_state* state, int fd)
+{
+    vector<unsigned char> in;
+    vector<unsigned char> out;
+    size_t used = 0; // bytes of in already served
+
+    while (!stopping)
+    {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        int ready = poll(&pfd, 1, DAEMON_POLL_INTERVAL);
+        if (ready < 0 && errno != EINTR)
+            break;
+        if (ready <= 0)
+            continue;
+
+        size_t have = in.size();
+        in.resize(have + DAEMON_READ_SIZE);
+        ssize_t n = recv(fd, &in[have], DAEMON_READ_SIZE, 0);
+        if (n < 0 && errno == EINTR)
+        {
+            in.resize(have);
+            continue;
+        }
+        if (n <= 0)
+            break;
+        in.resize(have + (size_t)n);
+
+        bool bad = false;
+        while (in.size() - used >= sizeof(daemon_frame_header))
+        {
+            daemon_frame_header request;
+            memcpy(&request, &in[used], sizeof(request));
+            if (request.magic != DAEMON_MAGIC || request.length > MAX_DAEMON_PAYLOAD)
+            {
+                append_error(&out, request, DAEMON_BAD_REQUEST, "bad frame header");
+                bad = true;
+                break;
+            }
+            if (in.size() - used - sizeof(request) < request.length)
+                break;
+            serve_request(state, request, in.data() + used + sizeof(request), &out);
+            used += sizeof(request) + request.length;
+        }
+        in.erase(in.begin(), in.begin() + (ptrdiff_t)used);
+        used = 0;
+
+        if (!out.empty() && !send_all(fd, out.data(), out.size()))
+            break;
+        out.clear();
+        // The stream cannot be resynchronised after a bad header
+        if (bad)
+            break;
+    }
+    close(fd);
+    state->clients--;
+}
+
+static int open_socket(const char* socket_path)
+{
+    struct sockaddr_un addr;
+    struct stat st;
+    int fd;
+
+    if (strlen(socket_path) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "Host: socket path %s is too long\n", socket_path);
+        return -1;
+    }
+    // A socket left behind by an earlier daemon is replaced, anything else
+    // at the path is left alone
+    if (stat(socket_path, &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(socket_path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        perror("Host: socket");
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+
+    // Requests carry passwords, so only this user may connect
+    mode_t mask = umask(0077);
+    int ret = bind(fd, (struct sockaddr*)&addr, sizeof(addr));
+    umask(mask);
+    if (ret != 0 || listen(fd, SOMAXCONN) != 0)
+    {
+        perror("Host: bind");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void print_latencies(daemon_state* state)
+{
+    static const char* names[] = {"", "score", "encrypt", "decrypt"};
+    fprintf(stdout, "%-8s %10s %10s %10s %10s %10s\n", "request", "count", "p50_us", "p90_us", "p99_us", "max_us");
+    for (uint32_t type = DAEMON_SCORE; type < DAEMON_STATS; type++)
+    {
+        daemon_latency_t stats;
+        state->latencies[type].get(type, &stats);
+        fprintf(
+            stdout,
+            "%-8s %10llu %10llu %10llu %10llu %10llu\n",
+            names[type],
+            (unsigned long long)stats.count,
+            (unsigned long long)stats.p50_us,
+            (unsigned long long)stats.p90_us,
+            (unsigned long long)stats.p99_us,
+            (unsigned long long)stats.max_us);
+    }
+}
+
+int run_daemon(const char* socket_path, const daemon_handlers& handlers, size_t slots)
+{
+    slot_pool pool(slots);
+    daemon_state state;
+    int listen_fd = open_socket(socket_path);
+
+    if (listen_fd < 0)
+        return 1;
+    state.handlers = &handlers;
+    state.slots = &pool;
+    state.clients = 0;
+
+    signal(SIGINT, on_stop_signal);
+    signal(SIGTERM, on_stop_signal);
+    fprintf(stdout, "Host: serving on %s with %zu enclave slots\n", socket_path, slots);
+    fflush(stdout);
+
+    while (!stopping)
+    {
+        struct pollfd pfd = {listen_fd, POLLIN, 0};
+        if (poll(&pfd, 1, DAEMON_POLL_INTERVAL) <= 0)
+            continue;
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0)
+            continue;
+        if (state.clients >= MAX_DAEMON_CLIENTS)
+        {
+            close(fd);
+            continue;
+        }
+        state.clients++;
+        thread(serve_client, &state, fd).detach();
+    }
+
+    fprintf(stdout, "Host: shutting down\n");
+    close(listen_fd);
+    unlink(socket_path);
+    // Client threads notice stopping within a poll interval, after finishing
+    // the requests they are serving
+    while (state.clients > 0)
+        this_thread::sleep_for(chrono::milliseconds(10));
+    print_latencies(&state);
+    return 0;
+}
@@ -0,0 +1,93 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// The serve operation keeps one enclave with a preloaded model set and answers
+// requests on a local Unix domain socket. Requests and responses are frames
+// of a daemon_frame_header followed by length bytes of payload, all integers
+// in host byte order:
+//
+//   DAEMON_SCORE    sequences separated by '\n'. The response holds a
+//                   uint32_t row count, a uint32_t model count and then one
+//                   float per model for each row.
+//   DAEMON_ENCRYPT, DAEMON_DECRYPT
+//                   password, input path and output path, each terminated
+//                   by a NUL. Decrypt writes the scores of the decrypted
+//                   records to the output file. The response is empty.
+//   DAEMON_STATS    empty. The response is one daemon_latency_t for each of
+//                   the three operations above.
+//
+// A client may send any number of requests without waiting for responses.
+// Each connection is served in order and every response carries the id of
+// its request. A failed request is answered with a non-zero status and a
+// text message as payload.
+
+#define DAEMON_MAGIC 0x44425844
+#define MAX_DAEMON_PAYLOAD (16 * 1024 * 1024)
+
+enum daemon_request_type
+{
+    DAEMON_SCORE = 1,
+    DAEMON_ENCRYPT = 2,
+    DAEMON_DECRYPT = 3,
+    DAEMON_STATS = 4
+};
+
+enum daemon_status
+{
+    DAEMON_OK = 0,
+    DAEMON_FAILED = 1,
+    DAEMON_BAD_REQUEST = 2
+};
+
+struct daemon_frame_header
+{
+    uint32_t magic;
+    uint16_t type;
+    uint16_t status; // 0 in requests
+    uint32_t id;     // chosen by the client, echoed in the response
+    uint32_t length; // payload bytes that follow
+};
+
+// Latencies are measured from a complete request being read to its response
+// being queued, over the most recent requests of one type
+struct daemon_latency_t
+{
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t count; // requests served since start
+    uint64_t p50_us;
+    uint64_t p90_us;
+    uint64_t p99_us;
+    uint64_t max_us;
+};
+
+// Operations the daemon serves. They make ecalls and are called with one of
+// the daemon's enclave slots held. Each returns 0, or 1 with a message.
+struct daemon_handlers
+{
+    size_t modelcount;
+    int (*score)(
+        const char* seqs,
+        size_t size,
+        std::vector<float>* scores,
+        size_t* rows,
+        std::string* message);
+    int (*process_file)(
+        bool encrypt,
+        const std::string& password,
+        const std::string& input,
+        const std::string& output,
+        std::string* message);
+};
+
+// Serves requests on socket_path until SIGINT or SIGTERM, with at most slots
+// requests inside the enclave at once. Returns 0, or 1 if the socket cannot
+// be set up.
+int run_daemon(const char* socket_path, const daemon_handlers& handlers, size_t slots);
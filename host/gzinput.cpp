@@ -0,0 +1,310 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include "gzinput.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+
+#define GZIP_HEADER_SIZE 10
+#define GZIP_TRAILER_SIZE 8
+#define GZIP_FLAG_EXTRA 0x4
+#define BGZF_MAX_BLOCK_SIZE 65536
+
+// zlib counts in 32 bits, so longer spans are passed in pieces
+#define INFLATE_MAX_SPAN (1u << 30)
+
+// A BGZF block of a batch: where its deflate data lies in the file and where
+// its output goes in the batch
+struct bgzf_block
+{
+    size_t in;
+    size_t in_size;
+    size_t out;
+    uint32_t out_size;
+    uint32_t crc;
+};
+
+static uint32_t get_le32(const unsigned char* p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+           (uint32_t)p[3] << 24;
+}
+
+// Returns the size of the BGZF block at p, or 0 if p does not hold a whole
+// one. On success *header receives the size of its gzip header.
+static size_t bgzf_block_size(const unsigned char* p, size_t avail, size_t* header)
+{
+    size_t xlen;
+    size_t pos;
+
+    if (avail < GZIP_HEADER_SIZE + 2 || !gzip_reader::is_gzip(p, avail) ||
+        p[3] != GZIP_FLAG_EXTRA)
+        return 0;
+    xlen = (size_t)p[10] | (size_t)p[11] << 8;
+    if (GZIP_HEADER_SIZE + 2 + xlen > avail)
+        return 0;
+
+    // The BSIZE subfield holds the block size less one
+    for (pos = GZIP_HEADER_SIZE + 2; pos + 4 <= GZIP_HEADER_SIZE + 2 + xlen;)
+    {
+        size_t slen = (size_t)p[pos + 2] | (size_t)p[pos + 3] << 8;
+        if (p[pos] == 'B' && p[pos + 1] == 'C' && slen == 2 &&
+            pos + 6 <= GZIP_HEADER_SIZE + 2 + xlen)
+        {
+            size_t size = ((size_t)p[pos + 4] | (size_t)p[pos + 5] << 8) + 1;
+            *header = GZIP_HEADER_SIZE + 2 + xlen;
+            if (size < *header + GZIP_TRAILER_SIZE || size > avail)
+                return 0;
+            return size;
+        }
+        pos += 4 + slen;
+    }
+    return 0;
+}
+
+static bool is_zero(const unsigned char* p, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        if (p[i] != 0)
+            return false;
+    }
+    return true;
+}
+
+// Inflates blocks[next...] into out until none are left, or one fails
+static void inflate_blocks(
+    const unsigned char* data,
+    const std::vector<bgzf_block>& blocks,
+    unsigned char* out,
+    std::atomic<size_t>& next,
+    std::atomic<bool>& failed)
+{
+    z_stream stream;
+    unsigned char empty;
+
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+    {
+        failed = true;
+        return;
+    }
+    for (size_t i = next++; i < blocks.size() && !failed; i = next++)
+    {
+        const bgzf_block& block = blocks[i];
+        inflateReset(&stream);
+        stream.next_in = (Bytef*)(data + block.in);
+        stream.avail_in = (uInt)block.in_size;
+        // An empty block, such as the end-of-file marker, still needs
+        // somewhere to point
+        stream.next_out = block.out_size > 0 ? out + block.out : &empty;
+        stream.avail_out = block.out_size > 0 ? block.out_size : 1;
+        if (inflate(&stream, Z_FINISH) != Z_STREAM_END ||
+            stream.total_out != block.out_size ||
+            crc32(0, block.out_size > 0 ? out + block.out : &empty, block.out_size) != block.crc)
+            failed = true;
+    }
+    inflateEnd(&stream);
+}
+
+gzip_reader::gzip_reader()
+    : m_data(NULL), m_size(0), m_pos(0), m_threads(1), m_bgzf(false),
+      m_done(false), m_stream_open(false), m_batch_pos(0)
+{
+    memset(&m_stream, 0, sizeof(m_stream));
+}
+
+gzip_reader::~gzip_reader()
+{
+    close();
+}
+
+bool gzip_reader::is_gzip(const unsigned char* data, size_t size)
+{
+    return size >= GZIP_HEADER_SIZE + GZIP_TRAILER_SIZE && data[0] == 0x1f &&
+           data[1] == 0x8b && data[2] == Z_DEFLATED;
+}
+
+// Starts reading data[0..size), which must stay in place until close().
+// threads is the most BGZF blocks inflated at once; 0 picks one per core,
+// up to BGZF_MAX_THREADS.
+int gzip_reader::open(const unsigned char* data, size_t size, size_t threads)
+{
+    size_t header = 0;
+
+    close();
+    if (!is_gzip(data, size))
+        return 1;
+    if (threads == 0)
+    {
+        threads = std::thread::hardware_concurrency();
+        if (threads == 0)
+            threads = 1;
+        if (threads > BGZF_MAX_THREADS)
+            threads = BGZF_MAX_THREADS;
+    }
+    m_data = data;
+    m_size = size;
+    m_threads = threads;
+    m_bgzf = bgzf_block_size(data, size, &header) != 0;
+    return m_bgzf ? 0 : start_inflate();
+}
+
+void gzip_reader::close()
+{
+    if (m_stream_open)
+        inflateEnd(&m_stream);
+    memset(&m_stream, 0, sizeof(m_stream));
+    m_stream_open = false;
+    m_data = NULL;
+    m_size = 0;
+    m_pos = 0;
+    m_bgzf = false;
+    m_done = false;
+    m_batch.clear();
+    m_batch_pos = 0;
+}
+
+// Reads up to size bytes of decompressed data, stopping short only at the
+// end of the file. Returns non-zero if the file is corrupt or truncated.
+int gzip_reader::read(unsigned char* out, size_t size, size_t* count)
+{
+    *count = 0;
+    while (*count < size && !m_done)
+    {
+        if (!m_bgzf)
+        {
+            size_t n = 0;
+            if (inflate_some(out + *count, size - *count, &n) != 0)
+                return 1;
+            *count += n;
+            continue;
+        }
+        if (m_batch_pos == m_batch.size())
+        {
+            if (fill_batch() != 0)
+                return 1;
+            continue;
+        }
+        size_t n = m_batch.size() - m_batch_pos;
+        if (n > size - *count)
+            n = size - *count;
+        memcpy(out + *count, &m_batch[m_batch_pos], n);
+        m_batch_pos += n;
+        *count += n;
+    }
+    return 0;
+}
+
+// Inflates the next BGZF_BATCH_SIZE or so bytes of BGZF blocks into
+// m_batch, spread over up to m_threads threads
+int gzip_reader::fill_batch()
+{
+    std::vector<bgzf_block> blocks;
+    std::vector<std::thread> threads;
+    std::atomic<size_t> next(0);
+    std::atomic<bool> failed(false);
+    size_t total = 0;
+
+    while (m_pos < m_size && total < BGZF_BATCH_SIZE)
+    {
+        const unsigned char* p = m_data + m_pos;
+        size_t header = 0;
+        size_t size = bgzf_block_size(p, m_size - m_pos, &header);
+        bgzf_block block;
+
+        if (size == 0)
+            break;
+        block.in = m_pos + header;
+        block.in_size = size - header - GZIP_TRAILER_SIZE;
+        block.out = total;
+        block.crc = get_le32(p + size - GZIP_TRAILER_SIZE);
+        block.out_size = get_le32(p + size - 4);
+        if (block.out_size > BGZF_MAX_BLOCK_SIZE)
+            return 1;
+        blocks.push_back(block);
+        total += block.out_size;
+        m_pos += size;
+    }
+
+    m_batch.resize(total);
+    m_batch_pos = 0;
+    if (blocks.empty())
+    {
+        if (!is_gzip(m_data + m_pos, m_size - m_pos))
+        {
+            // Only zero padding may follow the last block
+            m_done = true;
+            return is_zero(m_data + m_pos, m_size - m_pos) ? 0 : 1;
+        }
+        // Not BGZF from here on
+        m_bgzf = false;
+        return start_inflate();
+    }
+
+    unsigned char* out = m_batch.empty() ? NULL : &m_batch[0];
+    size_t count = blocks.size() < m_threads ? blocks.size() : m_threads;
+    for (size_t t = 1; t < count; t++)
+        threads.push_back(std::thread(
+            inflate_blocks, m_data, std::cref(blocks), out, std::ref(next), std::ref(failed)));
+    inflate_blocks(m_data, blocks, out, next, failed);
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+    return failed ? 1 : 0;
+}
+
+int gzip_reader::start_inflate()
+{
+    memset(&m_stream, 0, sizeof(m_stream));
+    // 16 selects the gzip wrapper
+    if (inflateInit2(&m_stream, MAX_WBITS + 16) != Z_OK)
+        return 1;
+    m_stream_open = true;
+    return 0;
+}
+
+// Inflates plain gzip data into out[0..size), crossing gzip members. Data
+// after the last member must be zero padding.
+int gzip_reader::inflate_some(unsigned char* out, size_t size, size_t* count)
+{
+    *count = 0;
+    while (*count < size && !m_done)
+    {
+        size_t in_size = m_size - m_pos;
+        size_t out_size = size - *count;
+        int status;
+
+        if (in_size > INFLATE_MAX_SPAN)
+            in_size = INFLATE_MAX_SPAN;
+        if (out_size > INFLATE_MAX_SPAN)
+            out_size = INFLATE_MAX_SPAN;
+        m_stream.next_in = (Bytef*)(m_data + m_pos);
+        m_stream.avail_in = (uInt)in_size;
+        m_stream.next_out = out + *count;
+        m_stream.avail_out = (uInt)out_size;
+        status = inflate(&m_stream, Z_NO_FLUSH);
+        m_pos += in_size - m_stream.avail_in;
+        *count += out_size - m_stream.avail_out;
+
+        if (status == Z_STREAM_END)
+        {
+            size_t rest = m_size - m_pos;
+            if (is_gzip(m_data + m_pos, rest))
+            {
+                inflateReset(&m_stream);
+                continue;
+            }
+            m_done = true;
+            if (!is_zero(m_data + m_pos, rest))
+                return 1;
+        }
+        else if (status != Z_OK && status != Z_BUF_ERROR)
+            return 1;
+        else if (m_stream.avail_out > 0 && m_pos == m_size)
+            return 1; // the last member is cut short
+    }
+    return 0;
+}
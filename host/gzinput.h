@@ -0,0 +1,58 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+#include <zlib.h>
+
+// Decompressed BGZF data is produced in batches of about this many bytes,
+// the blocks of a batch being inflated on several threads at once
+#define BGZF_BATCH_SIZE (4 * 1024 * 1024)
+#define BGZF_MAX_THREADS 8
+
+// gzip_reader decompresses a gzip file held in memory, usually a
+// mapped_file, so that sequence dumps can be read without first being
+// decompressed to disk. Files of several gzip members, as written by
+// concatenation or by bgzip, are read as one stream.
+//
+// BGZF files (bgzip, samtools) are gzip members of at most 64 KB, each with
+// its compressed size in a header field and its decompressed size in its
+// trailer. That is enough to place every block of a batch in the output
+// before any is inflated, so the blocks are inflated in parallel. Other
+// gzip data is inflated on the calling thread. A file that stops being BGZF
+// part way is read on from there as plain gzip.
+class gzip_reader
+{
+  private:
+    const unsigned char* m_data;
+    size_t m_size;
+    size_t m_pos;                       // compressed bytes consumed
+    size_t m_threads;
+    bool m_bgzf;
+    bool m_done;
+    z_stream m_stream;                  // plain gzip only
+    bool m_stream_open;
+    std::vector<unsigned char> m_batch; // BGZF output not read yet
+    size_t m_batch_pos;
+
+  public:
+    gzip_reader();
+    ~gzip_reader();
+    static bool is_gzip(const unsigned char* data, size_t size);
+    int open(const unsigned char* data, size_t size, size_t threads);
+    void close();
+    int read(unsigned char* out, size_t size, size_t* count);
+    bool bgzf() const
+    {
+        return m_bgzf;
+    }
+
+  private:
+    int fill_batch();
+    int start_inflate();
+    int inflate_some(unsigned char* out, size_t size, size_t* count);
+    gzip_reader(const gzip_reader&);
+    gzip_reader& operator=(const gzip_reader&);
+};
@@ -1,997 +1,4207 @@
-// Copyright (c) Open Enclave SDK contributors.
-// Licensed under the MIT License.
-
-#define _CRT_SECURE_NO_WARNINGS
-#include <assert.h>
-#include <limits.h>
-#include <openenclave/host.h>
-#include <stdio.h>
-#include <sys/stat.h>
-#include <sys/types.h>
-#include <fstream>
-#include <iostream>
-#include <iterator>
-#include <string>
-#include <vector>
-#include "../shared.h"
-
-#include "fileencryptor_u.h"
-
-using namespace std;
-
-#define CIPHER_BLOCK_SIZE 16
-#define DATA_BLOCK_SIZE 256
-#define ENCRYPT_OPERATION true
-#define DECRYPT_OPERATION false
-
-static string operation;
-static oe_enclave_t* enclave = NULL;
-static int modelcount = 0;
-
-const char* DIRECTORY_OF_PARAMETERS = "../data/params/";
-
-/* create new "deepbind" class in enclave directory,
-add deepbind to cmakelists
- */
-
-void hcall_printscores(float* scores, size_t modelcount) {
-    for (size_t i = 0; i < modelcount; i++) {
-        if (i > 0) {
-            fputc('\t', stdout);
-        }
-        fprintf(stdout, "%f", double(scores[i]));
-    }
-    cout << endl;
-}
-
-void printusage(const char* prog) {
-    cerr << "Usage: use one of the following commands with the specified arguments" << endl;
-    cerr << prog << " encrypt input-file dest-file enclave-image-path password" << endl;
-    cerr << prog << " decrypt ids-file encrypted-seq-file enclave-image-path password" << endl;
-    cerr << prog << " predict ids-file seq-file enclave-image-path" << endl;
-    exit(-1);
-}
-
-void trim_trailing_whitespace(char* str)
-{
-	int i = (int)strlen(str);
-	while (i > 0 && (str[i - 1] == '\n' || str[i - 1] == ' ' || str[i - 1] == '\t' || str[i - 1] == '\r'))
-		i--;
-	str[i] = '\0';
-}
-
-int get_num_hidden1(deepbind_model_t* model) { return model->has_avg_pooling ? model->num_detectors * 2 : model->num_detectors; }
-int get_num_hidden2(deepbind_model_t* model) { return model->num_hidden ? model->num_hidden : 1; }
-
-model_id_t str2id(char* str)
-{
-	model_id_t id = { 0, 0 };
-	char tmp[6];
-	if (!str) {
-		cout << "Invalid model id NULL";
-        exit(-1);
-    }
-	if (strlen(str) < 10 || str[0] != 'D' || str[6] != '.') {
-		cout << "Invalid model id \"\"; should be of form D#####.###" << str;
-        exit(-1);
-    }
-	memcpy(tmp, str + 1, 5); tmp[5] = '\0';
-	id.major = atoi(tmp);
-	id.minor = atoi(str + 7);
-	if (id.major <= 0 || id.minor <= 0) {
-        cout << "Invalid model id " << str << "; should be of form DXXXXX.YYY where XXXXX >= 1 and YYY >= 1";
-		exit(-1);
-    }
-    
-	return id;
-}
-
-void id2str(model_id_t id, char* dst)
-{
-	if (id.major <= 0 || id.minor <= 0) {
-		cout << "Invalid model id";
-        exit(-1);
-    }
-	sprintf(dst, "D%05d.%03d", id.major, id.minor);
-}
-
-void panic(const char* msg, ...)
-{
-	va_list va;
-	va_start(va, msg);
-	vprintf(msg, va);
-	va_end(va);
-	printf("\n");
-	exit(-1);
-}
-
-bool check_simulate_opt(int* argc, const char* argv[])
-{
-    for (int i = 0; i < *argc; i++)
-    {
-        if (strcmp(argv[i], "--simulate") == 0)
-        {
-            cout << "Running in simulation mode" << endl;
-            memmove(&argv[i], &argv[i + 1], (*argc - i) * sizeof(char*));
-            (*argc)--;
-            return true;
-        }
-    }
-    return false;
-}
-
-// Dump Encryption header
-void dump_header(encryption_header_t* _header)
-{
-    cout << "--------- Dumping header -------------\n";
-    cout << "Host: fileDataSize = " << _header->file_data_size << endl;
-
-    cout << "Host: password digest:\n";
-    for (int i = 0; i < HASH_VALUE_SIZE_IN_BYTES; i++)
-    {
-        cout << "Host: digest[" << i << "]" << std::hex
-             << (unsigned int)(_header->digest[i]) << endl;
-    }
-
-    cout << "Host: encryption key" << endl;
-    for (int i = 0; i < ENCRYPTION_KEY_SIZE_IN_BYTES; i++)
-    {
-        cout << "Host: key[" << i << "]=" << std::hex
-             << (unsigned int)(_header->encrypted_key[i]) << endl;
-    }
-
-    cout << "Host: salt and IV" << endl;
-    for (int i = 0; i < SALT_SIZE_IN_BYTES; i++)
-    {
-        cout << "Host: salt[" << i << "]=" << std::hex
-             << (unsigned int)(_header->salt[i]) << endl;
-    }
-}
-
-// get the file size
-int get_file_size(FILE* file, size_t* _file_size)
-{
-    int ret = 0;
-    long int oldpos = 0;
-
-    oldpos = ftell(file);
-    ret = fseek(file, 0L, SEEK_END);
-    if (ret != 0)
-        goto exit;
-
-    *_file_size = (size_t)ftell(file);
-    fseek(file, oldpos, SEEK_SET);
-
-exit:
-    return ret;
-}
-
-// Compare file1 and file2: return 0 if the first file1.size bytes of the file2
-// is equal to file1's contents  Otherwise it returns 1
-int compare_2_files(const char* first_file, const char* second_file)
-{
-    int ret = 0;
-    std::ifstream f1(first_file, std::ios::binary);
-    std::ifstream f2(second_file, std::ios::binary);
-    std::vector<uint8_t> f1_data_bytes = std::vector<uint8_t>(
-        std::istreambuf_iterator<char>(f1), std::istreambuf_iterator<char>());
-    std::vector<uint8_t> f2_data_bytes = std::vector<uint8_t>(
-        std::istreambuf_iterator<char>(f2), std::istreambuf_iterator<char>());
-    std::vector<uint8_t>::iterator f1iterator = f1_data_bytes.begin();
-    std::vector<uint8_t>::iterator f2iterator = f2_data_bytes.begin();
-
-    // compare files
-    for (; f1iterator != f1_data_bytes.end() - 1; ++f1iterator, ++f2iterator)
-    {
-        if (!(*f1iterator == *f2iterator))
-        {
-            ret = 1;
-            break;
-        }
-    }
-    cout << "Host: two files are " << ((ret == 0) ? "equal" : "not equal")
-         << endl;
-    return ret;
-}
-
-int encrypt_file(
-    bool encrypt,
-    const char* password,
-    const char* input_file,
-    const char* output_file)
-{
-    oe_result_t result;
-    int ret = 0;
-    FILE* src_file = NULL;
-    FILE* dest_file = NULL;
-    unsigned char* r_buffer = NULL;
-    unsigned char* w_buffer = NULL;
-    size_t bytes_read;
-    size_t bytes_to_write;
-    size_t bytes_written;
-    size_t src_file_size = 0;
-    size_t src_data_size = 0;
-    size_t leftover_bytes = 0;
-    size_t bytes_left = 0;
-    size_t requested_read_size = 0;
-    encryption_header_t header;
-
-    // allocate read/write buffers
-    r_buffer = new unsigned char[DATA_BLOCK_SIZE];
-    if (r_buffer == NULL)
-    {
-        ret = 1;
-        goto exit;
-    }
-
-    w_buffer = new unsigned char[DATA_BLOCK_SIZE];
-    if (w_buffer == NULL)
-    {
-        cerr << "Host: w_buffer allocation error" << endl;
-        ret = 1;
-        goto exit;
-    }
-
-    // open source and dest files
-    src_file = fopen(input_file, "rb");
-    if (!src_file)
-    {
-        cout << "Host: fopen " << input_file << " failed." << endl;
-        ret = 1;
-        goto exit;
-    }
-
-    ret = get_file_size(src_file, &src_file_size);
-    if (ret != 0)
-    {
-        ret = 1;
-        goto exit;
-    }
-    src_data_size = src_file_size;
-    dest_file = fopen(output_file, "wb");
-    if (!dest_file)
-    {
-        cerr << "Host: fopen " << output_file << " failed." << endl;
-        ret = 1;
-        goto exit;
-    }
-
-    // For decryption, we want to read encryption header data into the header
-    // structure before calling initialize_encryptor
-    if (!encrypt)
-    {
-        bytes_read = fread(&header, 1, sizeof(header), src_file);
-        if (bytes_read != sizeof(header))
-        {
-            cerr << "Host: read header failed." << endl;
-            ret = 1;
-            goto exit;
-        }
-        src_data_size = src_file_size - sizeof(header);
-    }
-
-    // Initialize the encryptor inside the enclave
-    // Parameters: encrypt: a bool value to set the encryptor mode, true for
-    // encryption and false for decryption
-    // password is provided for encryption key used inside the encryptor. Upon
-    // return, _header will be filled with encryption key information for
-    // encryption operation. In the case of decryption, the caller provides
-    // header information from a previously encrypted file
-    result = initialize_encryptor(
-        enclave, &ret, encrypt, password, strlen(password), &header);
-    if (result != OE_OK)
-    {
-        ret = 1;
-        goto exit;
-    }
-    if (ret != 0)
-    {
-        goto exit;
-    }
-
-    // For encryption, on return from initialize_encryptor call, the header will
-    // have encryption information. Write this header to the output file.
-    if (encrypt)
-    {
-        header.file_data_size = src_file_size;
-        bytes_written = fwrite(&header, 1, sizeof(header), dest_file);
-        if (bytes_written != sizeof(header))
-        {
-            cerr << "Host: writting header failed. bytes_written = "
-                 << bytes_written << " sizeof(header)=" << sizeof(header)
-                 << endl;
-            ret = 1;
-            goto exit;
-        }
-    }
-
-    leftover_bytes = src_data_size % CIPHER_BLOCK_SIZE;
-
-    // cout << "Host: leftover_bytes " << leftover_bytes << endl;
-
-    // Encrypt each block in the source file and write to the dest_file. Process
-    // all the blocks except the last one if its size is not a multiple of
-    // CIPHER_BLOCK_SIZE when padding is needed
-    bytes_left = src_data_size;
-
-    if (leftover_bytes)
-    {
-        bytes_left = src_data_size - leftover_bytes;
-    }
-    requested_read_size =
-        bytes_left > DATA_BLOCK_SIZE ? DATA_BLOCK_SIZE : bytes_left;
-    cout << "Host: start " << (encrypt ? "encrypting" : "decrypting") << endl;
-
-    // It loops through DATA_BLOCK_SIZE blocks one at a time then followed by
-    // processing the last remaining multiple of CIPHER_BLOCK_SIZE blocks. This
-    // loop makes sure all the data is processed except leftover_bytes bytes in
-    // the end.
-    while (
-        (bytes_read = fread(
-             r_buffer, sizeof(unsigned char), requested_read_size, src_file)) &&
-        bytes_read > 0)
-    {
-        // Request for the enclave to encrypt or decrypt _input_buffer. The
-        // block size (bytes_read), needs to be a multiple of CIPHER_BLOCK_SIZE.
-        // In this sample, DATA_BLOCK_SIZE is used except the last block, which
-        // will have to pad it to be a multiple of CIPHER_BLOCK_SIZE.
-        // Eg. If testfile data size is 260 bytes, then the last block will be
-        // 4 data + 12 padding bytes = 16 bytes (CIPHER_BLOCK_SIZE).
-        result = encrypt_block(
-            enclave, &ret, encrypt, r_buffer, w_buffer, bytes_read);
-        if (result != OE_OK)
-        {
-            cerr << "encrypt_block error 1" << endl;
-            ret = 1;
-            goto exit;
-        }
-        if (ret != 0)
-        {
-            cerr << "encrypt_block error 1" << endl;
-            goto exit;
-        }
-
-        bytes_to_write = bytes_read;
-        // The data size is always padded to align with CIPHER_BLOCK_SIZE
-        // during encryption. Therefore, remove the padding (if any) from the
-        // last block during decryption.
-        if (!encrypt && bytes_left <= DATA_BLOCK_SIZE)
-        {
-            bytes_to_write = header.file_data_size % DATA_BLOCK_SIZE;
-            bytes_to_write = bytes_to_write > 0 ? bytes_to_write : bytes_read;
-        }
-
-        if ((bytes_written = fwrite(
-                 w_buffer, sizeof(unsigned char), bytes_to_write, dest_file)) !=
-            bytes_to_write)
-        {
-            cerr << "Host: fwrite error  " << output_file << endl;
-            ret = 1;
-            goto exit;
-        }
-
-        bytes_left -= requested_read_size;
-        if (bytes_left == 0)
-            break;
-        if (bytes_left < DATA_BLOCK_SIZE)
-            requested_read_size = bytes_left;
-    }
-
-    if (encrypt)
-    {
-        // The CBC mode for AES assumes that we provide data in blocks of
-        // CIPHER_BLOCK_SIZE bytes. This sample uses PKCS#5 padding. Pad the
-        // whole CIPHER_BLOCK_SIZE block if leftover_bytes is zero. Pad the
-        // (CIPHER_BLOCK_SIZE - leftover_bytes) bytes if leftover_bytes is
-        // non-zero.
-        size_t padded_byte_count = 0;
-        unsigned char plaintext_padding_buf[CIPHER_BLOCK_SIZE];
-        unsigned char ciphertext_padding_buf[CIPHER_BLOCK_SIZE];
-
-        memset(ciphertext_padding_buf, 0, CIPHER_BLOCK_SIZE);
-        memset(plaintext_padding_buf, 0, CIPHER_BLOCK_SIZE);
-
-        if (leftover_bytes == 0)
-            padded_byte_count = CIPHER_BLOCK_SIZE;
-        else
-            padded_byte_count = CIPHER_BLOCK_SIZE - leftover_bytes;
-
-        // cout << "Host: Working the last block" << endl;
-        // cout << "Host: padded_byte_count " << padded_byte_count << endl;
-        // cout << "Host: leftover_bytes " << leftover_bytes << endl;
-
-        bytes_read = fread(
-            plaintext_padding_buf,
-            sizeof(unsigned char),
-            leftover_bytes,
-            src_file);
-        if (bytes_read != leftover_bytes)
-            goto exit;
-
-        // PKCS5 Padding
-        memset(
-            (void*)(plaintext_padding_buf + leftover_bytes),
-            padded_byte_count,
-            padded_byte_count);
-
-        result = encrypt_block(
-            enclave,
-            &ret,
-            encrypt,
-            plaintext_padding_buf,
-            ciphertext_padding_buf,
-            CIPHER_BLOCK_SIZE);
-        if (result != OE_OK)
-        {
-            ret = 1;
-            goto exit;
-        }
-        if (ret != 0)
-        {
-            goto exit;
-        }
-
-        bytes_written = fwrite(
-            ciphertext_padding_buf,
-            sizeof(unsigned char),
-            CIPHER_BLOCK_SIZE,
-            dest_file);
-        if (bytes_written != CIPHER_BLOCK_SIZE)
-            goto exit;
-    }
-
-    cout << "Host: done  " << (encrypt ? "encrypting" : "decrypting") << endl;
-
-    // close files
-    fclose(src_file);
-    fclose(dest_file);
-
-exit:
-    delete[] r_buffer;
-    delete[] w_buffer;
-    cout << "Host: called close_encryptor" << endl;
-
-    result = close_encryptor(enclave);
-    if (result != OE_OK)
-    {
-        ret = 1;
-    }
-    return ret;
-}
-
-// host calls from enclave
-
-int loadmodelids(const char* modelfile) {
-    // Parses model-ids-file and adds each id to enclave
-    char buffer[1024];
-    model_id_t id;
-    FILE* file = fopen(modelfile, "r");
-    oe_result_t result;
-    int count = 0;
-
-    if (!file) {
-        cout << "couldnt call " << modelfile;
-        exit(-1);
-    }
-
-    result = ecall_initmodel(enclave);
-    if (result != OE_OK) {
-        cout << "Trouble initialising model" << endl;
-    }
-
-    while (fgets(buffer, 1024, file)) {
-        if (buffer[0] != '#') {
-            trim_trailing_whitespace(buffer);
-            id = str2id(buffer);
-            result = ecall_addIDtomodel(enclave, id.major, id.minor);
-            if (result != OE_OK) {
-                cout << "Trouble adding id to model via ecall ";
-                exit(-1);
-            }
-            count++;
-        }
-    }
-    return count;
-}
-
-void load_model_paramlist(FILE* file, char* param_file, const char* param_name, float** _dst, int num_params)
-{
-	int i;
-	char buffer[64];
-	float* dst = 0;
-	*_dst = 0;
-	strcpy(buffer, param_name);
-	if (num_params > 0) {
-		float* dst = (float*)malloc(sizeof(float) * num_params);
-		strcat(buffer, " = %f");
-		if (fscanf(file, buffer, &dst[0]) != 1)
-			panic("Failed parsing %s in file %s", param_file, param_name);
-		for (i = 1; i < num_params; ++i)
-			if (fscanf(file, ",%f", &dst[i]) != 1)
-				panic("Failed parsing %s in file %s", param_file, param_name);
-		fscanf(file, "\n"); // eat up the carriage return
-		*_dst = dst;
-	}
-	else {
-		strcat(buffer, " = ");
-		fscanf(file, buffer); // eat up the line
-	}
-}
-
-int decrypt_file_to_enclave(
-    bool encrypt,
-    const char* password,
-    const char* input_file,
-    const char* output_file)
-{
-    oe_result_t result;
-    int ret = 0;
-    FILE* src_file = NULL;
-    FILE* dest_file = NULL;
-    unsigned char* r_buffer = NULL;
-    unsigned char* w_buffer = NULL;
-    size_t bytes_read;
-    size_t bytes_to_write;
-    size_t bytes_written;
-    size_t src_file_size = 0;
-    size_t src_data_size = 0;
-    size_t leftover_bytes = 0;
-    size_t bytes_left = 0;
-    size_t requested_read_size = 0;
-    encryption_header_t header;
-
-    // allocate read/write buffers
-    r_buffer = new unsigned char[MAX_SEQ_SIZE];
-    if (r_buffer == NULL)
-    {
-        ret = 1;
-        goto exit;
-    }
-
-    w_buffer = new unsigned char[MAX_SEQ_SIZE];
-    if (w_buffer == NULL)
-    {
-        cerr << "Host: w_buffer allocation error" << endl;
-        ret = 1;
-        goto exit;
-    }
-
-    // open source and dest files
-    src_file = fopen(input_file, "rb");
-    if (!src_file)
-    {
-        cout << "Host: fopen " << input_file << " failed." << endl;
-        ret = 1;
-        goto exit;
-    }
-
-    ret = get_file_size(src_file, &src_file_size);
-    if (ret != 0)
-    {
-        ret = 1;
-        goto exit;
-    }
-    src_data_size = src_file_size;
-    dest_file = fopen(output_file, "wb");
-    if (!dest_file)
-    {
-        cerr << "Host: fopen " << output_file << " failed." << endl;
-        ret = 1;
-        goto exit;
-    }
-    
-
-    // For decryption, we want to read encryption header data into the header
-    // structure before calling initialize_encryptor
-    bytes_read = fread(&header, 1, sizeof(header), src_file);
-    if (bytes_read != sizeof(header))
-    {
-        cerr << "Host: read header failed." << endl;
-        ret = 1;
-        goto exit;
-    }
-    src_data_size = src_file_size - sizeof(header);
-
-    // Initialize the encryptor inside the enclave
-    // Parameters: encrypt: a bool value to set the encryptor mode, true for
-    // encryption and false for decryption
-    // password is provided for encryption key used inside the encryptor. Upon
-    // return, _header will be filled with encryption key information for
-    // encryption operation. In the case of decryption, the caller provides
-    // header information from a previously encrypted file
-    result = initialize_encryptor(
-        enclave, &ret, DECRYPT_OPERATION, password, strlen(password), &header);
-    if (result != OE_OK)
-    {
-        ret = 1;
-        goto exit;
-    }
-    if (ret != 0)
-    {
-        goto exit;
-    }
-
-    leftover_bytes = src_data_size % CIPHER_BLOCK_SIZE;
-
-    // cout << "Host: leftover_bytes " << leftover_bytes << endl;
-
-    // Encrypt each block in the source file and write to the dest_file. Process
-    // all the blocks except the last one if its size is not a multiple of
-    // CIPHER_BLOCK_SIZE when padding is needed
-    bytes_left = src_data_size;
-
-    if (leftover_bytes)
-    {
-        bytes_left = src_data_size - leftover_bytes;
-    }
-    requested_read_size =
-        bytes_left > MAX_SEQ_SIZE ? MAX_SEQ_SIZE : bytes_left;
-
-    // It loops through DATA_BLOCK_SIZE blocks one at a time then followed by
-    // processing the last remaining multiple of CIPHER_BLOCK_SIZE blocks. This
-    // loop makes sure all the data is processed except leftover_bytes bytes in
-    // the end.
-    while (
-        (bytes_read = fread(
-             r_buffer, sizeof(unsigned char), requested_read_size, src_file)) &&
-        bytes_read > 0)
-    {
-        bytes_to_write = bytes_read;
-        // The data size is always padded to align with CIPHER_BLOCK_SIZE
-        // during encryption. Therefore, remove the padding (if any) from the
-        // last block during decryption.
-
-        //cout << "bytes to write = " << bytes_to_write << endl;
-        bytes_left -= requested_read_size;
-        size_t paddingsize = header.file_data_size % DATA_BLOCK_SIZE;
-        result = ecall_decryptpredict(enclave, &ret, r_buffer, bytes_to_write, bytes_left==0, paddingsize);
-        // cout << "result from ecall_decryptpredict = " << ret << endl;
-
-        // if (ret > 0) {
-        //     int offset = bytes_left;
-        //     fseek(src_file, offset, SEEK_SET);
-        //     bytes_left += ret;
-        // }
-
-        if (bytes_left == 0)
-            break;
-        if (bytes_left < MAX_SEQ_SIZE)
-            requested_read_size = bytes_left;
-    }
-
-    cout << "Host: done decrypting" << endl;
-
-    // close files
-    fclose(src_file);
-    fclose(dest_file);
-
-exit:
-    delete[] r_buffer;
-    delete[] w_buffer;
-    cout << "Host: called close_encryptor" << endl;
-
-    result = close_encryptor(enclave);
-    if (result != OE_OK)
-    {
-        ret = 1;
-    }
-    return ret;
-}
-
-deepbind_model_t* load_model(model_id_t id)
-{
-	char param_file[512];
-	int major_version = 0;
-	int minor_version = 0;
-	deepbind_model_t* model = 0;
-	FILE* file = 0;
-
-	/* Find path to file*/
-	strcpy(param_file, DIRECTORY_OF_PARAMETERS);
-	id2str(id, param_file + strlen(param_file));
-	strcat(param_file, ".txt");
-    // cout << "param_file to open = " << param_file << endl;
-
-	/* Open the file and parse each line */
-	file = fopen(param_file, "r");
-	if (!file)
-		panic("Could not open param file %s.", param_file);
-
-	if (fscanf(file, "# deepbind %d.%d\n", &major_version, &minor_version) != 2)
-		panic("Expected parameter file to start with \"# deepbind 0.1\"");
-	if (major_version != 0 || minor_version != 1)
-		panic("Param file is for deepbind %d.%d, not 0.1", major_version, minor_version);
-
-	model = (deepbind_model_t*)malloc(sizeof(deepbind_model_t));
-	model->id = id;
-
-	if (fscanf(file, "reverse_complement = %d\n", &model->reverse_complement) != 1) panic("Failed parsing reverse_complement in %s", param_file);
-	if (fscanf(file, "num_detectors = %d\n", &model->num_detectors) != 1)      panic("Failed parsing num_detectors in %s", param_file);
-	if (fscanf(file, "detector_len = %d\n", &model->detector_len) != 1)       panic("Failed parsing detector_len in %s", param_file);
-	if (fscanf(file, "has_avg_pooling = %d\n", &model->has_avg_pooling) != 1)    panic("Failed parsing has_avg_pooling in %s", param_file);
-	if (fscanf(file, "num_hidden = %d\n", &model->num_hidden) != 1)         panic("Failed parsing num_hidden in %s", param_file);
-
-	load_model_paramlist(file, param_file, "detectors", &model->detectors, model->num_detectors * model->detector_len * 4);
-	load_model_paramlist(file, param_file, "thresholds", &model->thresholds, model->num_detectors);
-	load_model_paramlist(file, param_file, "weights1", &model->weights1, get_num_hidden1(model) * get_num_hidden2(model));
-	load_model_paramlist(file, param_file, "biases1", &model->biases1, get_num_hidden2(model));
-	load_model_paramlist(file, param_file, "weights2", &model->weights2, model->num_hidden ? model->num_hidden : 0);
-	load_model_paramlist(file, param_file, "biases2", &model->biases2, model->num_hidden ? 1 : 0);
-
-	fclose(file);
-	return model;
-}
-
-/* Loads model parameters to deepbind model in enclave.
-    Also prints headers on stdout.  */
-void loadmodelparams() {
-    model_id_t modelid;
-    deepbind_model_t* model;
-    oe_result_t result;
-
-    cout << "Host: Loading parameters onto enclave model.\n";
-
-    for (int i = 0; i < modelcount; i++) {
-        result = ecall_getdbmodelid(enclave, &modelid, (size_t) i);
-        model = load_model(modelid);
-        result = ecall_loadparams(enclave, *model);
-        if (result != OE_OK) {
-            cout << "error on ecall_loadparams " << i << "\n";
-            exit(-1);
-        }
-        
-        
-    }
-}
-
-void printmodelids() {
-    oe_result_t result;
-    model_id_t id;
-    for (size_t i = 0; i < static_cast<size_t>(modelcount); i++) {
-        result = ecall_getdbmodelid(enclave, &id, i);
-        if (i > 0) {
-            fputc('\t', stdout);
-        }
-        fprintf(stdout, "D%05d.%03d", id.major, id.minor);
-    }
-    
-    fputc('\n', stdout);
-}
-
-void printscores(vector<float> scores) {
-    int i = 0;
-
-    for (vector<float>::iterator it = scores.begin(); it != scores.end(); it++) {
-        if (i > 0) {
-            fputc('\t', stdout);
-        }
-        fprintf(stdout, "%f", (double) *it);
-        i++;
-    }
-    fputc('\n', stdout);
-}
-
-void predictseqs(const char* seqfile, int num_models) {
-    // Parses sequences-file and calls enclave to obtain predictions
-
-    char buffer[1024]; // maximum length of sequences to predict
-    FILE* file = fopen(seqfile, "r");
-    oe_result_t result;
-    int lineindex = 0;
-
-    if (!file) {
-        cout << "error opening file " << seqfile;
-        exit(-1);
-    }
-    
-    while(fgets(buffer, 1024, file)) {
-        vector<float> scores;
-        trim_trailing_whitespace(buffer);
-        size_t bufferlen = strlen(buffer);
-        if(bufferlen > 0) {
-            size_t validseq = 0;
-            char* cptr = new char;
-            ecall_checkvalidseq(enclave, &validseq, (unsigned char*) buffer, bufferlen);
-            if (validseq != 0) {
-                cout << "Sequence on line " << lineindex << ", " << validseq << " is not valid.\n";
-                exit(-1);
-            }
-
-            for (int i = 0; i < num_models; i++) {
-                float score;
-                result = ecall_scanmodel(enclave, &score, (size_t) i, (unsigned char*) buffer, bufferlen, 0, 0);
-                model_id_t modelid;
-                result = ecall_getdbmodelid(enclave, &modelid, i);
-                scores.push_back(score);
-                if (result != OE_OK) {
-                    cout << "Result from ecall_scanmodel not ok";
-                    exit(-1);
-                }
-            }
-            printscores(scores);
-            lineindex++;
-        }
-    }
-
-}
-
-void run_encrypt(const char* input_file, const char* encrypted_file, const char* pw) {
-    
-    int ret = 0;
-    // encrypt a file
-    cout << "Host: encrypting file:" << input_file
-         << " -> file:" << encrypted_file << endl;
-    ret = encrypt_file(
-        ENCRYPT_OPERATION, pw, input_file, encrypted_file);
-    if (ret != 0)
-    {
-        cerr << "Host: processFile(ENCRYPT_OPERATION) failed with " << ret
-             << endl;
-        exit(-1);
-    }
-
-    // Make sure the encryption was doing something. Input and encrypted files
-    // are not equal
-    cout << "Host: compared file:" << encrypted_file
-         << " to file:" << input_file << endl;
-    ret = compare_2_files(input_file, encrypted_file);
-    if (ret == 0)
-    {
-        cerr << "Host: checking failed! " << input_file
-             << "'s contents are not supposed to be same as " << encrypted_file
-             << endl;
-        exit(-1);
-    }
-    cout << "Host: " << input_file << " is NOT equal to " << encrypted_file
-         << "as expected" << endl;
-    cout << "Host: encryption was done successfully" << endl;
-
-
-}
-
-void run_decrypt_from_encrypt(const char* input_file, const char* encrypted_file, const char* decrypted_file, const char* pw) {
-    
-    int ret = 0;
-    // Decrypt a file
-    cout << "Host: decrypting file:" << encrypted_file
-         << " to file:" << decrypted_file << endl;
-
-    ret = encrypt_file(
-        DECRYPT_OPERATION,
-        pw,
-        encrypted_file,
-        decrypted_file);
-    if (ret != 0)
-    {
-        cerr << "Host: processFile(DECRYPT_OPERATION) failed with " << ret
-             << endl;
-        exit(-1);
-    }
-    cout << "Host: compared file: " << input_file
-         << " to file:" << decrypted_file << endl;
-    ret = compare_2_files(input_file, decrypted_file);
-    if (ret != 0)
-    {
-        cerr << "Host: checking failed! " << input_file
-             << "'s is supposed to be same as " << decrypted_file << endl;
-        
-    }
-    cout << "Host: " << input_file << " is equal to " << decrypted_file << endl;
-
-}
-
-void run_decrypt(const char* encrypted_file, const char* decrypted_file, const char* pw) {
-
-    int ret = 0;
-    loadmodelparams();
-
-    // Decrypt a file
-    cout << "Host: decrypting file:" << encrypted_file
-         << " to file:" << decrypted_file << endl;
-
-    printmodelids();
-    ret = decrypt_file_to_enclave(
-        DECRYPT_OPERATION,
-        pw,
-        encrypted_file,
-        decrypted_file);
-    if (ret != 0)
-    {
-        cerr << "Host: processFile(DECRYPT_OPERATION) failed with " << ret
-             << endl;
-        exit(-1);
-    }
-    
-}
-
-void run_predict(const char* modelfile, const char* seqfile) {
-     // Parse arguments and store model-ids-file in enclave's deepbind model
-    
-    modelcount = loadmodelids(modelfile);
-    model_id_t modelid;
-    oe_result_t getidresult;
-
-    loadmodelparams();
-    printmodelids();
-    // Parse sequences from sequences-file and predict for each in enclave
-    predictseqs(seqfile, modelcount);
-
-    cout << "Host: Successfully scored sequences!" << endl;
-}
-
-int main(int argc, const char* argv[])
-{
-    oe_result_t result;
-    int ret = 0;
-     
-    uint32_t flags = OE_ENCLAVE_FLAG_DEBUG;
-
-    if (check_simulate_opt(&argc, argv))
-    {
-        flags |= OE_ENCLAVE_FLAG_SIMULATE;
-    }
-
-    // Check arguments from command line
-    cout << "Host: enter main" << endl;
-    if (argc < 2) {
-        printusage(argv[0]);
-    }
-    operation = string(argv[1]);
-    
-    if (operation.compare("decrypt") == 0 || operation.compare("encrypt") == 0) {
-        if (argc != 6) {
-            printusage(argv[0]);
-        }
-    } else if (operation.compare("predict") == 0) {
-        if (argc != 5) {
-            printusage(argv[0]);
-        }
-    } else {
-        printusage(argv[0]);
-    }
-
-    const char* decrypted_file = "./out.decrypted";
-    // used for encryption:
-    const char* input_file = argv[2]; // example.seq
-    const char* output_file = argv[3]; // example.seq.encrypted
-    // used for decryption:
-    const char* model_file = argv[2]; // example.ids
-    const char* encrypted_file = argv[3]; // example.seq.encrypted
-    //used for model prediction:
-    const char* modelfile = argv[2]; // example.ids
-    const char* seqfile = argv[3]; // example.seq
-
-    cout << "Host: create enclave for image:" << argv[4] << endl;
-    result = oe_create_fileencryptor_enclave(
-        argv[4], OE_ENCLAVE_TYPE_SGX, flags, NULL, 0, &enclave);
-    if (result != OE_OK)
-    {
-        cerr << "oe_create_fileencryptor_enclave() failed with " << argv[0]
-             << " " << result << endl;
-        ret = 1;
-        goto exit;
-    }
-    
-    if (operation.compare("encrypt") == 0) {
-        run_encrypt(input_file, output_file, argv[5]);
-        run_decrypt_from_encrypt(input_file, output_file, decrypted_file, argv[5]);
-        return 0;
-    }
-
-    if (operation.compare("decrypt") == 0) {
-        modelcount = loadmodelids(model_file);
-        run_decrypt(encrypted_file, decrypted_file, argv[5]);
-        return 0;
-    }
-
-    if (operation.compare("predict") == 0) {
-        run_predict(modelfile, seqfile);
-        return 0;
-    }
-
-exit:
-    cout << "Host: terminate the enclave" << endl;
-    cout << "Host: Sample completed successfully." << endl;
-    oe_terminate_enclave(enclave);
-    return ret;
-}
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#define _CRT_SECURE_NO_WARNINGS
+#include <assert.h>
+#include <limits.h>
+#include <openenclave/host.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "../shared.h"
+#include "bench.h"
+#include "checkpoint.h"
+#include "daemon.h"
+#include "gzinput.h"
+#include "manifest.h"
+#include "mapped_file.h"
+#include "pipeline.h"
+#include "placement.h"
+#include "recindex.h"
+#include "resident.h"
+#include "scheduler.h"
+#include "scorefile.h"
+#include "seqpack.h"
+#include "shards.h"
+#include "tempdir.h"
+#include "textwriter.h"
+
+#include "fileencryptor_u.h"
+
+using namespace std;
+
+#define ENCRYPT_OPERATION true
+#define DECRYPT_OPERATION false
+
+static string operation;
+static oe_enclave_t* enclave = NULL;
+
+// A model set loaded into the enclave: its id there and how many models it
+// holds
+struct model_set
+{
+    size_t id;
+    int count;
+};
+static size_t stream_chunk_size = DEFAULT_STREAM_CHUNK_SIZE;
+static bool pack_sequences = false;
+static bool verify_after_encrypt = false;
+static unsigned int kdf_iterations = DEFAULT_KDF_ITERATIONS;
+
+// Worker threads for run-manifest, or requests in the enclave at once for
+// serve. Each makes ecalls, so together with the main thread they must fit in
+// the enclave's NumTCS.
+#define MAX_MANIFEST_WORKERS 6
+static size_t manifest_workers = 0; // 0: one per core, up to the maximum
+
+// --enclaves=<k>: predict creates k enclaves from the image, each driven by
+// --workers worker threads (lanes) pinned to a NUMA node in turn; enclave
+// is the first. Models are parsed once and loaded into every enclave.
+// pool_enclaves holds the enclave of each lane.
+#define MAX_ENCLAVES 16
+static size_t enclave_count = 1;
+static vector<oe_enclave_t*> pool_enclaves;
+static worker_group pool_workers;
+// --estimate: predict prints its cost estimates instead of scoring
+static bool estimate_only = false;
+// --resident: the lanes stay in their enclaves for the whole predict run,
+// scoring the tasks the main thread submits to them (see scorering.h)
+static bool resident_workers = false;
+static resident_scorer pool_scorer;
+
+// bench: --bench-size=<bytes>[K|M|G] is the size of the synthetic sequence
+// file of the end-to-end runs; --json=<file> writes the report there
+// instead of stdout
+#define DEFAULT_BENCH_SIZE (64 * 1024 * 1024)
+static uint64_t bench_size = DEFAULT_BENCH_SIZE;
+static const char* bench_json_path = NULL;
+
+// Records to score, from --records; empty means all of them
+struct record_range
+{
+    size_t first; // 0-based
+    size_t count;
+};
+static vector<record_range> record_ranges;
+
+// --shards=<n>: decrypt and predict split their records among n worker
+// processes, each with an enclave of its own (see shards.h)
+static size_t shard_count = 1;
+// In a worker: the file it writes its scores to and, for predict, where in
+// the sequence file its first record lies and which record that is
+static string shard_output;
+static size_t shard_text_offset = 0;
+static size_t shard_first_record = 0;
+
+// decrypt: --scores=<file> writes the scores there, checkpointing to
+// <file>.checkpoint; --resume continues from that checkpoint
+static const char* scores_path = NULL;
+static bool resume_scoring = false;
+static bool seal_scores = false; // --sealed: the scores are sealed by the enclave
+// --binary[=fp16]: decrypt --scores and unseal write a binary score file
+static bool binary_scores = false;
+static unsigned int binary_encoding = SCORE_ENCODING_FLOAT32;
+// --precision=<digits>|shortest: digits after the point in text scores
+static int score_precision = DEFAULT_SCORE_PRECISION;
+
+const char* DIRECTORY_OF_PARAMETERS = "../data/params/";
+
+/* create new "deepbind" class in enclave directory,
+add deepbind to cmakelists
+ */
+
+// Score rows reported by the enclave while a pipeline slot is processed are
+// collected here and printed later by the pipeline's writer thread.
+static thread_local vector<float>* pending_scores = NULL;
+// Sealed score chunks are collected the same way
+static thread_local vector<unsigned char>* pending_sealed = NULL;
+// and the names of named records in this slot's names and name_ends
+static thread_local pipeline_slot* pending_names = NULL;
+
+void print_score_rows(text_writer& out, const float* scores, size_t rows, size_t modelcount) {
+    for (size_t r = 0; r < rows; r++) {
+        for (size_t i = 0; i < modelcount; i++) {
+            if (i > 0) {
+                out.put('\t');
+            }
+            out.put_score(scores[r * modelcount + i]);
+        }
+        out.put('\n');
+    }
+}
+
+// Prints the score rows of a slot, each after the name of its record if the
+// records are named
+static void print_slot_rows(text_writer& out, const pipeline_slot& slot, size_t modelcount) {
+    size_t rows = modelcount > 0 ? slot.scores.size() / modelcount : 0;
+    size_t name_start = 0;
+    for (size_t r = 0; r < rows; r++) {
+        if (r < slot.name_ends.size()) {
+            if (slot.name_ends[r] > name_start) {
+                out.write(&slot.names[name_start], slot.name_ends[r] - name_start);
+            }
+            out.put('\t');
+            name_start = slot.name_ends[r];
+        }
+        print_score_rows(out, &slot.scores[r * modelcount], 1, modelcount);
+    }
+}
+
+void hcall_printscores(float* scores, size_t modelcount, const char* name) {
+    char text[MAX_SCORE_TEXT];
+    if (pending_scores) {
+        pending_scores->insert(pending_scores->end(), scores, scores + modelcount);
+        if (name && pending_names) {
+            pending_names->names.insert(pending_names->names.end(), name, name + strlen(name));
+            pending_names->name_ends.push_back(pending_names->names.size());
+        }
+        return;
+    }
+    if (name) {
+        fputs(name, stdout);
+        fputc('\t', stdout);
+    }
+    for (size_t i = 0; i < modelcount; i++) {
+        if (i > 0) {
+            fputc('\t', stdout);
+        }
+        fwrite(text, 1, format_score(scores[i], score_precision, text), stdout);
+    }
+    fputc('\n', stdout);
+    fflush(stdout);
+}
+
+void hcall_sealedscores(const unsigned char* chunk, size_t size) {
+    if (pending_sealed) {
+        pending_sealed->insert(pending_sealed->end(), chunk, chunk + size);
+    }
+}
+
+void hcall_benchnop() {
+}
+
+// Counts the rows and chunks in a run of sealed chunks
+static void count_sealed_chunks(const vector<unsigned char>& sealed, size_t* rows, size_t* chunks) {
+    sealed_chunk_header_t header;
+    *rows = 0;
+    *chunks = 0;
+    for (size_t pos = 0; pos + sizeof(header) <= sealed.size(); pos += sizeof(header) + header.size) {
+        memcpy(&header, &sealed[pos], sizeof(header));
+        *rows += header.rows;
+        (*chunks)++;
+    }
+}
+
+void printusage(const char* prog) {
+    cerr << "Usage: use one of the following commands with the specified arguments" << endl;
+    cerr << prog << " encrypt input-file dest-file enclave-image-path password" << endl;
+    cerr << prog << " decrypt-file encrypted-file dest-file enclave-image-path password" << endl;
+    cerr << prog << " decrypt ids-file encrypted-seq-file enclave-image-path password" << endl;
+    cerr << prog << " predict ids-file seq-file enclave-image-path" << endl;
+    cerr << prog << " rekey encrypted-file enclave-image-path old-password new-password" << endl;
+    cerr << prog << " unseal sealed-scores-file dest-file enclave-image-path password" << endl;
+    cerr << prog << " run-manifest manifest-file enclave-image-path" << endl;
+    cerr << prog << " serve ids-file socket-path enclave-image-path" << endl;
+    cerr << prog << " bench ids-file seq-file enclave-image-path" << endl;
+    cerr << "  (encrypt, decrypt-file: a file named - is stdin or stdout; unseal: - is stdout)" << endl;
+    cerr << "Options: --simulate --chunk-size=<bytes>[K|M]" << endl;
+    cerr << "         --packed (encrypt: store sequences with 2 bits per base)" << endl;
+    cerr << "         --verify (encrypt: decrypt the new file again and check its MAC)" << endl;
+    cerr << "         --kdf-iterations=<n> (encrypt, rekey: PBKDF2 iterations, default "
+         << DEFAULT_KDF_ITERATIONS << ")" << endl;
+    cerr << "         --workers=<n> (run-manifest: worker threads, serve: requests" << endl;
+    cerr << "           in the enclave at once, predict: threads per enclave sharing" << endl;
+    cerr << "           the models by cost; up to " << MAX_MANIFEST_WORKERS << ")" << endl;
+    cerr << "         --estimate (predict: print the estimated cost of each model and" << endl;
+    cerr << "           of the file instead of scoring it)" << endl;
+    cerr << "         --resident (predict: keep the scoring threads in the enclave for" << endl;
+    cerr << "           the whole run, taking work from rings in host memory)" << endl;
+    cerr << "         --records=<first>[-<last>][,...] (decrypt, predict: score only" << endl;
+    cerr << "           these records, numbered from 1)" << endl;
+    cerr << "         --scores=<file> (decrypt: write scores there, checkpointing to" << endl;
+    cerr << "           <file>.checkpoint) --resume (continue from the checkpoint)" << endl;
+    cerr << "         --sealed (decrypt with --scores: seal the scores in the enclave)" << endl;
+    cerr << "         --enclaves=<k> (predict: score with k enclaves in this process," << endl;
+    cerr << "           each on its own thread, spread over NUMA nodes; up to " << MAX_ENCLAVES << ")" << endl;
+    cerr << "         --shards=<n> (decrypt, predict: score in n processes, each with an" << endl;
+    cerr << "           enclave, and merge their scores in order; up to " << MAX_SHARDS << ")" << endl;
+    cerr << "         --precision=<digits>|shortest (text scores: digits after the point," << endl;
+    cerr << "           default " << DEFAULT_SCORE_PRECISION << " as with %f; shortest: fewest that read back exactly)" << endl;
+    cerr << "         --binary[=fp16] (decrypt with --scores, unseal: write a binary" << endl;
+    cerr << "           score file, see host/scorefile.h; fp16 stores half floats)" << endl;
+    cerr << "         --bench-size=<bytes>[K|M|G] (bench: synthetic input for the" << endl;
+    cerr << "           end-to-end runs, default " << DEFAULT_BENCH_SIZE / (1024 * 1024) << "M)" << endl;
+    cerr << "         --json=<file> (bench: write the results there, not to stdout)" << endl;
+    exit(-1);
+}
+
+void trim_trailing_whitespace(char* str)
+{
+	int i = (int)strlen(str);
+	while (i > 0 && (str[i - 1] == '\n' || str[i - 1] == ' ' || str[i - 1] == '\t' || str[i - 1] == '\r'))
+		i--;
+	str[i] = '\0';
+}
+
+int get_num_hidden1(deepbind_model_t* model) { return model->has_avg_pooling ? model->num_detectors * 2 : model->num_detectors; }
+int get_num_hidden2(deepbind_model_t* model) { return model->num_hidden ? model->num_hidden : 1; }
+
+model_id_t str2id(char* str)
+{
+	model_id_t id = { 0, 0 };
+	char tmp[6];
+	if (!str) {
+		cout << "Invalid model id NULL";
+        exit(-1);
+    }
+	if (strlen(str) < 10 || str[0] != 'D' || str[6] != '.') {
+		cout << "Invalid model id \"\"; should be of form D#####.###" << str;
+        exit(-1);
+    }
+	memcpy(tmp, str + 1, 5); tmp[5] = '\0';
+	id.major = atoi(tmp);
+	id.minor = atoi(str + 7);
+	if (id.major <= 0 || id.minor <= 0) {
+        cout << "Invalid model id " << str << "; should be of form DXXXXX.YYY where XXXXX >= 1 and YYY >= 1";
+		exit(-1);
+    }
+    
+	return id;
+}
+
+void id2str(model_id_t id, char* dst)
+{
+	if (id.major <= 0 || id.minor <= 0) {
+		cout << "Invalid model id";
+        exit(-1);
+    }
+	sprintf(dst, "D%05d.%03d", id.major, id.minor);
+}
+
+void panic(const char* msg, ...)
+{
+	va_list va;
+	va_start(va, msg);
+	vprintf(msg, va);
+	va_end(va);
+	printf("\n");
+	exit(-1);
+}
+
+bool check_simulate_opt(int* argc, const char* argv[])
+{
+    for (int i = 0; i < *argc; i++)
+    {
+        if (strcmp(argv[i], "--simulate") == 0)
+        {
+            cout << "Running in simulation mode" << endl;
+            memmove(&argv[i], &argv[i + 1], (*argc - i) * sizeof(char*));
+            (*argc)--;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Removes flag from the arguments, returning whether it was present
+bool check_flag_opt(int* argc, const char* argv[], const char* flag)
+{
+    for (int i = 0; i < *argc; i++)
+    {
+        if (strcmp(argv[i], flag) == 0)
+        {
+            memmove(&argv[i], &argv[i + 1], (*argc - i) * sizeof(char*));
+            (*argc)--;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Parses --chunk-size=<bytes>[K|M], the amount of data handed to the enclave
+// per ecall when streaming. It is rounded down to a whole number of cipher
+// blocks and capped at MAX_STREAM_CHUNK_SIZE.
+void check_chunk_size_opt(int* argc, const char* argv[])
+{
+    const char* opt = "--chunk-size=";
+    for (int i = 0; i < *argc; i++)
+    {
+        if (strncmp(argv[i], opt, strlen(opt)) == 0)
+        {
+            char* end = NULL;
+            size_t size = (size_t)strtoull(argv[i] + strlen(opt), &end, 10);
+            if (*end == 'K' || *end == 'k')
+                size *= 1024;
+            else if (*end == 'M' || *end == 'm')
+                size *= 1024 * 1024;
+            size -= size % CIPHER_BLOCK_SIZE;
+            if (size == 0 || size > MAX_STREAM_CHUNK_SIZE)
+            {
+                cerr << "Host: --chunk-size must be between " << CIPHER_BLOCK_SIZE
+                     << " and " << MAX_STREAM_CHUNK_SIZE << " bytes" << endl;
+                exit(-1);
+            }
+            stream_chunk_size = size;
+            memmove(&argv[i], &argv[i + 1], (*argc - i) * sizeof(char*));
+            (*argc)--;
+            return;
+        }
+    }
+}
+
+// Parses --kdf-iterations=<n>, the PBKDF2 iteration count for the password
+// key of newly encrypted files. Decryption takes the count from each header.
+void check_kdf_iterations_opt(int* argc, const char* argv[])
+{
+    const char* opt = "--kdf-iterations=";
+    for (int i = 0; i < *argc; i++)
+    {
+        if (strncmp(argv[i], opt, strlen(opt)) == 0)
+        {
+            char* end = NULL;
+            unsigned long n = strtoul(argv[i] + strlen(opt), &end, 10);
+            if (*end != '\0' || n < MIN_KDF_ITERATIONS || n > MAX_KDF_ITERATIONS)
+            {
+                cerr << "Host: --kdf-iterations must be between "
+                     << MIN_KDF_ITERATIONS << " and " << MAX_KDF_ITERATIONS
+                     << endl;
+                exit(-1);
+            }
+            kdf_iterations = (unsigned int)n;
+            memmove(&argv[i], &argv[i + 1], (*argc - i) * sizeof(char*));
+            (*argc)--;
+            return;
+        }
+    }
+}
+
+// Parses --workers=<n>, the number of run-manifest worker threads or serve
+// enclave slots
+void check_workers_opt(int* argc, const char* argv[])
+{
+    const char* opt = "--workers=";
+    for (int i = 0; i < *argc; i++)
+    {
+        if (strncmp(argv[i], opt, strlen(opt)) == 0)
+        {
+            char* end = NULL;
+            unsigned long n = strtoul(argv[i] + strlen(opt), &end, 10);
+            if (*end != '\0' || n < 1 || n > MAX_MANIFEST_WORKERS)
+            {
+                cerr << "Host: --workers must be between 1 and "
+                     << MAX_MANIFEST_WORKERS << endl;
+                exit(-1);
+            }
+            manifest_workers = (size_t)n;
+            memmove(&argv[i], &argv[i + 1], (*argc - i) * sizeof(char*));
+            (*argc)--;
+            return;
+        }
+    }
+}
+
+// Parses --enclaves=<k>, the number of enclaves predict scores with
+void check_enclaves_opt(int* argc, const char* argv[])
+{
+    const char* opt = "--enclaves=";
+    for (int i = 0; i < *argc; i++)
+    {
+        if (strncmp(argv[i], opt, strlen(opt)) == 0)
+        {
+            char* end = NULL;
+            unsigned long n = strtoul(argv[i] + strlen(opt), &end, 10);
+            if (*end != '\0' || n < 1 || n > MAX_ENCLAVES)
+            {
+                cerr << "Host: --enclaves must be between 1 and " << MAX_ENCLAVES << endl;
+                exit(-1);
+            }
+            enclave_count = (size_t)n;
+            memmove(&argv[i], &argv[i + 1], (*argc - i) * sizeof(char*));
+            (*argc)--;
+            return;
+        }
+    }
+}
+
+// Parses --shards=<n>, the number of worker processes for decrypt or predict
+void check_shards_opt(int* argc, const char* argv[])
+{
+    const char* opt = "--shards=";
+    for (int i = 0; i < *argc; i++)
+    {
+        if (strncmp(argv[i], opt, strlen(opt)) == 0)
+        {
+            char* end = NULL;
+            unsigned long n = strtoul(argv[i] + strlen(opt), &end, 10);
+            if (*end != '\0' || n < 1 || n > MAX_SHARDS)
+            {
+                cerr << "Host: --shards must be between 1 and " << MAX_SHARDS << endl;
+                exit(-1);
+            }
+            shard_count = (size_t)n;
+            memmove(&argv[i], &argv[i + 1], (*argc - i) * sizeof(char*));
+            (*argc)--;
+            return;
+        }
+    }
+}
+
+// Parses --scores=<file>
+void check_scores_opt(int* argc, const char* argv[])
+{
+    const char* opt = "--scores=";
+    for (int i = 0; i < *argc; i++)
+    {
+        if (strncmp(argv[i], opt, strlen(opt)) == 0)
+        {
+            scores_path = argv[i] + strlen(opt);
+            if (*scores_path == '\0')
+            {
+                cerr << "Host: --scores needs a file name" << endl;
+                exit(-1);
+            }
+            memmove(&argv[i], &argv[i + 1], (*argc - i) * sizeof(char*));
+            (*argc)--;
+            return;
+        }
+    }
+}
+
+// Parses --precision=<digits> or --precision=shortest
+void check_precision_opt(int* argc, const char* argv[])
+{
+    const char* opt = "--precision=";
+    for (int i = 0; i < *argc; i++)
+    {
+        if (strncmp(argv[i], opt, strlen(opt)) == 0)
+        {
+            const char* value = argv[i] + strlen(opt);
+            char* end = NULL;
+            unsigned long n = strtoul(value, &end, 10);
+            if (strcmp(value, "shortest") == 0)
+                score_precision = SCORE_PRECISION_SHORTEST;
+            else if (end != value && *end == '\0' && n <= MAX_SCORE_PRECISION)
+                score_precision = (int)n;
+            else
+            {
+                cerr << "Host: --precision must be shortest or at most "
+                     << MAX_SCORE_PRECISION << " digits" << endl;
+                exit(-1);
+            }
+            memmove(&argv[i], &argv[i + 1], (*argc - i) * sizeof(char*));
+            (*argc)--;
+            return;
+        }
+    }
+}
+
+// Parses --binary or --binary=fp16
+void check_binary_opt(int* argc, const char* argv[])
+{
+    for (int i = 0; i < *argc; i++)
+    {
+        if (strcmp(argv[i], "--binary") == 0 || strcmp(argv[i], "--binary=fp32") == 0)
+            binary_encoding = SCORE_ENCODING_FLOAT32;
+        else if (strcmp(argv[i], "--binary=fp16") == 0)
+            binary_encoding = SCORE_ENCODING_FLOAT16;
+        else if (strncmp(argv[i], "--binary=", 9) == 0)
+        {
+            cerr << "Host: --binary takes fp32 or fp16" << endl;
+            exit(-1);
+        }
+        else
+            continue;
+        binary_scores = true;
+        memmove(&argv[i], &argv[i + 1], (*argc - i) * sizeof(char*));
+        (*argc)--;
+        return;
+    }
+}
+
+// Parses --bench-size=<bytes>[K|M|G]
+void check_bench_size_opt(int* argc, const char* argv[])
+{
+    const char* opt = "--bench-size=";
+    for (int i = 0; i < *argc; i++)
+    {
+        if (strncmp(argv[i], opt, strlen(opt)) == 0)
+        {
+            char* end = NULL;
+            uint64_t size = (uint64_t)strtoull(argv[i] + strlen(opt), &end, 10);
+            if (*end == 'K' || *end == 'k')
+                size *= 1024;
+            else if (*end == 'M' || *end == 'm')
+                size *= 1024 * 1024;
+            else if (*end == 'G' || *end == 'g')
+                size *= 1024 * 1024 * 1024;
+            if (size == 0)
+            {
+                cerr << "Host: --bench-size must be a size in bytes" << endl;
+                exit(-1);
+            }
+            bench_size = size;
+            memmove(&argv[i], &argv[i + 1], (*argc - i) * sizeof(char*));
+            (*argc)--;
+            return;
+        }
+    }
+}
+
+// Parses --json=<file>, where bench writes its report
+void check_json_opt(int* argc, const char* argv[])
+{
+    const char* opt = "--json=";
+    for (int i = 0; i < *argc; i++)
+    {
+        if (strncmp(argv[i], opt, strlen(opt)) == 0)
+        {
+            bench_json_path = argv[i] + strlen(opt);
+            if (*bench_json_path == '\0')
+            {
+                cerr << "Host: --json needs a file name" << endl;
+                exit(-1);
+            }
+            memmove(&argv[i], &argv[i + 1], (*argc - i) * sizeof(char*));
+            (*argc)--;
+            return;
+        }
+    }
+}
+
+static bool range_less(const record_range& a, const record_range& b)
+{
+    return a.first < b.first;
+}
+
+// Parses --records=<first>[-<last>][,...], the 1-based, inclusive numbers of
+// the records to score. Ranges are sorted and overlapping ones merged, so
+// records are scored once each, in file order.
+void check_records_opt(int* argc, const char* argv[])
+{
+    const char* opt = "--records=";
+    for (int i = 0; i < *argc; i++)
+    {
+        if (strncmp(argv[i], opt, strlen(opt)) == 0)
+        {
+            const char* p = argv[i] + strlen(opt);
+            for (;;)
+            {
+                char* end = NULL;
+                size_t first = (size_t)strtoull(p, &end, 10);
+                size_t last = first;
+                if (*end == '-')
+                    last = (size_t)strtoull(end + 1, &end, 10);
+                if (end == p || first == 0 || last < first ||
+                    (*end != ',' && *end != '\0'))
+                {
+                    cerr << "Host: invalid --records list " << argv[i] << endl;
+                    exit(-1);
+                }
+                record_range range = {first - 1, last - first + 1};
+                record_ranges.push_back(range);
+                if (*end == '\0')
+                    break;
+                p = end + 1;
+            }
+            memmove(&argv[i], &argv[i + 1], (*argc - i) * sizeof(char*));
+            (*argc)--;
+            break;
+        }
+    }
+
+    sort(record_ranges.begin(), record_ranges.end(), range_less);
+    size_t merged = 0;
+    for (size_t i = 0; i < record_ranges.size(); i++)
+    {
+        const record_range& range = record_ranges[i];
+        if (merged > 0)
+        {
+            record_range& prev = record_ranges[merged - 1];
+            if (range.first <= prev.first + prev.count)
+            {
+                if (range.first + range.count > prev.first + prev.count)
+                    prev.count = range.first + range.count - prev.first;
+                continue;
+            }
+        }
+        record_ranges[merged++] = range;
+    }
+    record_ranges.resize(merged);
+}
+
+// Dump Encryption header
+void dump_header(encryption_header_t* _header)
+{
+    cout << "--------- Dumping header -------------\n";
+    cout << "Host: fileDataSize = " << _header->file_data_size << endl;
+
+    cout << "Host: password digest:\n";
+    for (int i = 0; i < HASH_VALUE_SIZE_IN_BYTES; i++)
+    {
+        cout << "Host: digest[" << i << "]" << std::hex
+             << (unsigned int)(_header->digest[i]) << endl;
+    }
+
+    cout << "Host: encryption key" << endl;
+    for (int i = 0; i < ENCRYPTION_KEY_SIZE_IN_BYTES; i++)
+    {
+        cout << "Host: key[" << i << "]=" << std::hex
+             << (unsigned int)(_header->encrypted_key[i]) << endl;
+    }
+
+    cout << "Host: salt and IV" << endl;
+    for (int i = 0; i < SALT_SIZE_IN_BYTES; i++)
+    {
+        cout << "Host: salt[" << i << "]=" << std::hex
+             << (unsigned int)(_header->salt[i]) << endl;
+    }
+}
+
+// get the file size
+int get_file_size(FILE* file, size_t* _file_size)
+{
+    int ret = 0;
+    long int oldpos = 0;
+
+    oldpos = ftell(file);
+    ret = fseek(file, 0L, SEEK_END);
+    if (ret != 0)
+        goto exit;
+
+    *_file_size = (size_t)ftell(file);
+    fseek(file, oldpos, SEEK_SET);
+
+exit:
+    return ret;
+}
+
+// Touch one byte per page of a mapped span so that it is resident before the
+// enclave copies it in. Run on the reader thread, this overlaps disk reads
+// with enclave work.
+static void prefault(const unsigned char* data, size_t size)
+{
+    volatile unsigned char sink = 0;
+    for (size_t i = 0; i < size; i += 4096)
+        sink ^= data[i];
+    (void)sink;
+}
+
+// Opens the enclave session every file of this run is encrypted or decrypted
+// under. The session derives each password key it needs once, not once per
+// file.
+static int open_password_session(const char* password)
+{
+    int ret = 0;
+    oe_result_t result = open_session(
+        enclave, &ret, password, strlen(password), kdf_iterations);
+    if (result != OE_OK || ret != 0)
+    {
+        cerr << "Host: open_session failed" << endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Session left open between the encrypt and decrypt tasks of run-manifest and
+// serve. Any number of tasks with the session's password use it at once, each
+// streaming its file through its own encryptor session; it is switched to
+// another password only once they have all finished.
+#define SESSION_BUSY 2
+static mutex session_lock;
+static condition_variable session_idle;
+static size_t session_users = 0; // guarded by session_lock
+static bool session_open = false;
+static bool session_opening = false; // while a task derives the key
+static string session_password;
+
+// Called with session_lock held, or once no tasks are left
+static void end_password_session()
+{
+    if (session_open)
+        close_session(enclave);
+    session_open = false;
+    fill(session_password.begin(), session_password.end(), '\0');
+    session_password.clear();
+}
+
+static void release_password_session()
+{
+    {
+        lock_guard<mutex> lock(session_lock);
+        session_users--;
+    }
+    session_idle.notify_all();
+}
+
+// Claims a use of password's session. Unless wait is set, returns
+// SESSION_BUSY rather than wait for the users of another password to finish.
+// The claim is cheap: if the session must be switched to password, *opener is
+// set and the key is derived by ready_password_session, with no lock held.
+static int claim_password_session(const string& password, bool wait, bool* opener)
+{
+    unique_lock<mutex> lock(session_lock);
+    auto ready = [&]() {
+        return session_users == 0 || password == session_password;
+    };
+    if (!ready())
+    {
+        if (!wait)
+            return SESSION_BUSY;
+        session_idle.wait(lock, ready);
+    }
+    *opener = false;
+    if (session_users == 0 && (!session_open || password != session_password))
+    {
+        end_password_session();
+        session_password = password;
+        session_opening = true;
+        *opener = true;
+    }
+    session_users++;
+    return 0;
+}
+
+// Opens the session claimed by claim_password_session if opener is set, or
+// else waits for the claimant that opens it. On failure the claim is
+// released and 1 returned.
+static int ready_password_session(const string& password, bool opener)
+{
+    bool open = false;
+    if (opener)
+    {
+        open = open_password_session(password.c_str()) == 0;
+        {
+            lock_guard<mutex> lock(session_lock);
+            session_opening = false;
+            session_open = open;
+        }
+        session_idle.notify_all();
+    }
+    else
+    {
+        unique_lock<mutex> lock(session_lock);
+        session_idle.wait(lock, []() { return !session_opening; });
+        open = session_open;
+    }
+    if (!open)
+    {
+        release_password_session();
+        return 1;
+    }
+    return 0;
+}
+
+// Starts using password's session, opening it if it is not the open one.
+// Unless wait is set, returns SESSION_BUSY rather than wait for the users of
+// another password to finish. Every successful call is matched by a call to
+// release_password_session.
+static int acquire_password_session(const string& password, bool wait)
+{
+    bool opener = false;
+    int ret = claim_password_session(password, wait, &opener);
+    if (ret != 0)
+        return ret;
+    return ready_password_session(password, opener);
+}
+
+// Waits until no task is using the session
+static void wait_password_session_idle()
+{
+    unique_lock<mutex> lock(session_lock);
+    session_idle.wait(lock, []() { return session_users == 0; });
+}
+
+// Encrypts the record index with the file's encryptor session, continuing the
+// CBC chain of the data before it, and appends it to dest_file
+static int write_record_index(
+    size_t encryptor,
+    const record_indexer& indexer,
+    FILE* dest_file)
+{
+    vector<unsigned char> index = indexer.serialize();
+    vector<unsigned char> encrypted(index.size());
+
+    for (size_t pos = 0; pos < index.size(); pos += stream_chunk_size)
+    {
+        int status = 0;
+        size_t size = index.size() - pos;
+        if (size > stream_chunk_size)
+            size = stream_chunk_size;
+        oe_result_t result = encrypt_block(
+            enclave, &status, encryptor, true, &index[pos], &encrypted[pos], size);
+        if (result != OE_OK || status != 0)
+            return 1;
+    }
+    if (!encrypted.empty() &&
+        fwrite(&encrypted[0], 1, encrypted.size(), dest_file) !=
+            encrypted.size())
+        return 1;
+    return 0;
+}
+
+// The encrypted data ends where the record index starts
+static size_t encrypted_data_size(const encryption_header_t& header, size_t size)
+{
+    if (header.index_offset > 0 && header.index_offset < size)
+        size = header.index_offset;
+    // Encrypted data is always a whole number of cipher blocks
+    return size - size % CIPHER_BLOCK_SIZE;
+}
+
+// Fills in the sizes and MAC of a streamed file from its trailer, given the
+// size of the encrypted data that came before it
+static int apply_stream_trailer(
+    const encryption_trailer_t& trailer,
+    size_t size,
+    encryption_header_t* header)
+{
+    if (trailer.magic != ENCRYPTION_TRAILER_MAGIC ||
+        size % CIPHER_BLOCK_SIZE != 0 || trailer.file_data_size >= size ||
+        size - trailer.file_data_size > CIPHER_BLOCK_SIZE)
+        return 1;
+    header->file_data_size = trailer.file_data_size;
+    header->record_count = trailer.record_count;
+    header->index_offset = size;
+    header->index_entries = 0;
+    memcpy(header->data_mac, trailer.data_mac, sizeof(header->data_mac));
+    return 0;
+}
+
+// For a streamed file read from disk, the trailer is at the end of the size
+// bytes of data after the header. It is applied to header and dropped from
+// size; other files are left alone.
+static int read_stream_trailer(
+    const unsigned char* data,
+    size_t* size,
+    encryption_header_t* header)
+{
+    encryption_trailer_t trailer;
+    if (!(header->flags & ENCRYPTION_FLAG_STREAMED))
+        return 0;
+    if (*size < sizeof(trailer))
+        return 1;
+    *size -= sizeof(trailer);
+    memcpy(&trailer, data + *size, sizeof(trailer));
+    return apply_stream_trailer(trailer, *size, header);
+}
+
+// Reads up to size bytes from a stream, stopping short only at end of file
+static int read_stream(FILE* file, unsigned char* data, size_t size, size_t* count)
+{
+    *count = size > 0 ? fread(data, 1, size, file) : 0;
+    return ferror(file) ? 1 : 0;
+}
+
+// Only regular files can be seeked back to for the header rewrite
+static bool is_regular_file(FILE* file)
+{
+    struct stat st;
+    return fstat(fileno(file), &st) == 0 && (st.st_mode & S_IFMT) == S_IFREG;
+}
+
+static void set_binary_mode(FILE* file)
+{
+#ifdef _WIN32
+    _setmode(_fileno(file), _O_BINARY);
+#else
+    (void)file;
+#endif
+}
+
+// Encrypts input_file to output_file, or decrypts it. Decrypting checks the
+// data MAC in the header; with output_file NULL nothing is written, so the
+// file is only verified.
+//
+// Either file may be "-" for stdin or stdout; data then flows through in
+// stream_chunk_size pieces without the size being known up front. Encrypting
+// to anything but a regular file writes a streamed file (see shared.h).
+// A gzip or BGZF input file is decompressed on the way in, the same way.
+int encrypt_file(
+    bool encrypt,
+    const char* input_file,
+    const char* output_file)
+{
+    oe_result_t result;
+    int ret = 0;
+    mapped_file src_file;
+    FILE* src_stream = NULL;
+    gzip_reader src_gzip;
+    bool compressed = false;
+    FILE* dest_file = NULL;
+    const unsigned char* r_data = NULL;
+    size_t bytes_written;
+    size_t src_data_size = 0;
+    size_t bytes_read = 0;
+    size_t plaintext_left = 0;
+    size_t data_size = 0;
+    size_t encrypted_size = 0;
+    encryption_header_t header;
+    encryption_trailer_t trailer;
+    size_t encryptor = 0;
+    bool encryptor_open = false;
+    unsigned char data_mac[HASH_VALUE_SIZE_IN_BYTES];
+    bool packed = false;
+    bool streamed = false;
+    bool src_done = false;
+    record_indexer indexer(RECORD_INDEX_STRIDE);
+    sequence_packer packer;
+    sequence_unpacker unpacker;
+    vector<unsigned char> staged; // packed data not yet handed to the enclave
+    vector<unsigned char> pending; // streamed input held back for the trailer
+    vector<unsigned char> scratch;
+    string unpacked;
+    // Reads plaintext that arrives without a known size
+    auto read_source = [&](unsigned char* data, size_t size, size_t* count) {
+        if (!compressed)
+            return read_stream(src_stream, data, size, count);
+        if (src_gzip.read(data, size, count) != 0)
+        {
+            cerr << "Host: " << input_file << " is not valid gzip data" << endl;
+            return 1;
+        }
+        return 0;
+    };
+
+    // map the source file, or read it from stdin, and open the dest file
+    if (strcmp(input_file, "-") == 0)
+    {
+        src_stream = stdin;
+        set_binary_mode(stdin);
+    }
+    else if (src_file.open(input_file) != 0)
+    {
+        cout << "Host: open " << input_file << " failed." << endl;
+        ret = 1;
+        goto exit;
+    }
+    else
+    {
+        r_data = src_file.data();
+        src_data_size = src_file.size();
+    }
+
+    // Compressed plaintext is read like a stream
+    if (encrypt && r_data && gzip_reader::is_gzip(r_data, src_data_size))
+    {
+        if (src_gzip.open(r_data, src_data_size, 0) != 0)
+        {
+            cerr << "Host: " << input_file << " is not valid gzip data" << endl;
+            ret = 1;
+            goto exit;
+        }
+        compressed = true;
+        cout << "Host: decompressing " << input_file
+             << (src_gzip.bgzf() ? " (BGZF)" : " (gzip)") << endl;
+    }
+
+    if (output_file && strcmp(output_file, "-") == 0)
+    {
+        dest_file = stdout;
+        set_binary_mode(stdout);
+    }
+    else
+    {
+        dest_file = output_file ? fopen(output_file, "wb") : NULL;
+        if (output_file && !dest_file)
+        {
+            cerr << "Host: fopen " << output_file << " failed." << endl;
+            ret = 1;
+            goto exit;
+        }
+    }
+
+    // For decryption, we want to read encryption header data into the header
+    // structure before calling initialize_encryptor
+    if (!encrypt)
+    {
+        if (src_stream)
+        {
+            if (read_stream(src_stream, (unsigned char*)&header, sizeof(header), &bytes_read) != 0 ||
+                bytes_read != sizeof(header))
+            {
+                cerr << "Host: read header failed." << endl;
+                ret = 1;
+                goto exit;
+            }
+            bytes_read = 0;
+            // A streamed file's length is only known once its trailer
+            // arrives; otherwise the data ends at the record index
+            streamed = (header.flags & ENCRYPTION_FLAG_STREAMED) != 0;
+            if (!streamed && header.index_offset == 0)
+            {
+                cerr << "Host: " << input_file << " has no data size" << endl;
+                ret = 1;
+                goto exit;
+            }
+            if (!streamed)
+                src_data_size = header.index_offset - header.index_offset % CIPHER_BLOCK_SIZE;
+        }
+        else
+        {
+            if (src_data_size < sizeof(header))
+            {
+                cerr << "Host: read header failed." << endl;
+                ret = 1;
+                goto exit;
+            }
+            memcpy(&header, r_data, sizeof(header));
+            r_data += sizeof(header);
+            src_data_size -= sizeof(header);
+            if (read_stream_trailer(r_data, &src_data_size, &header) != 0)
+            {
+                cerr << "Host: invalid stream trailer in " << input_file << endl;
+                ret = 1;
+                goto exit;
+            }
+            src_data_size = encrypted_data_size(header, src_data_size);
+        }
+    }
+
+    // Initialize the encryptor inside the enclave
+    // Parameters: encrypt: a bool value to set the encryptor mode, true for
+    // encryption and false for decryption
+    // the key comes from the session opened by open_password_session. Upon
+    // return, _header will be filled with encryption key information for
+    // encryption operation. In the case of decryption, the caller provides
+    // header information from a previously encrypted file
+    result = initialize_encryptor(
+        enclave, &ret, encrypt, &header, &encryptor);
+    if (result != OE_OK)
+    {
+        ret = 1;
+        goto exit;
+    }
+    if (ret != 0)
+    {
+        goto exit;
+    }
+    encryptor_open = true;
+
+    // For encryption, on return from initialize_encryptor call, the header will
+    // have encryption information. Write this header to the output file. The
+    // data size and record index are only known at the end, so the header is
+    // written again once the data is done, or for a pipe the trailer carries
+    // them instead.
+    if (encrypt)
+    {
+        packed = pack_sequences;
+        streamed = !is_regular_file(dest_file);
+        packer.set_indexer(&indexer);
+        header.flags = packed ? ENCRYPTION_FLAG_PACKED : 0;
+        if (streamed)
+            header.flags |= ENCRYPTION_FLAG_STREAMED;
+        bytes_written = fwrite(&header, 1, sizeof(header), dest_file);
+        if (bytes_written != sizeof(header))
+        {
+            cerr << "Host: writting header failed. bytes_written = "
+                 << bytes_written << " sizeof(header)=" << sizeof(header)
+                 << endl;
+            ret = 1;
+            goto exit;
+        }
+    }
+    else
+    {
+        packed = (header.flags & ENCRYPTION_FLAG_PACKED) != 0;
+        plaintext_left = streamed ? SIZE_MAX : header.file_data_size;
+    }
+
+    cout << "Host: start " << (encrypt ? "encrypting" : "decrypting") << endl;
+
+    // The reader thread hands out stream_chunk_size spans of the mapped file,
+    // or reads them from stdin, the enclave processes them into each slot's
+    // output buffer and the writer thread appends them to dest_file, all
+    // three running at once.
+    ret = run_pipeline(
+        [&](pipeline_slot& slot) {
+            if (encrypt && packed)
+            {
+                // Pack sequence text until a whole chunk of packed data is
+                // staged, then hand exactly one chunk to the enclave. The
+                // final chunk carries the rest plus PKCS#5 padding.
+                while (staged.size() < stream_chunk_size && !src_done)
+                {
+                    const char* text = NULL;
+                    size_t n = 0;
+                    if (src_stream || compressed)
+                    {
+                        scratch.resize(stream_chunk_size);
+                        if (read_source(&scratch[0], stream_chunk_size, &n) != 0)
+                            return 1;
+                        text = (const char*)&scratch[0];
+                        src_done = n < stream_chunk_size;
+                    }
+                    else
+                    {
+                        text = (const char*)r_data + bytes_read;
+                        n = src_data_size - bytes_read;
+                        if (n > stream_chunk_size)
+                            n = stream_chunk_size;
+                        src_done = bytes_read + n == src_data_size;
+                    }
+                    if (packer.feed(text, n, src_done, staged) != 0)
+                        return 1;
+                    bytes_read += n;
+                }
+                size_t take = staged.size();
+                if (take >= stream_chunk_size)
+                    take = stream_chunk_size;
+                else
+                    slot.last = true;
+                data_size += take;
+                slot.in_buffer.assign(staged.begin(), staged.begin() + (long)take);
+                staged.erase(staged.begin(), staged.begin() + (long)take);
+                if (slot.last)
+                {
+                    size_t padded_byte_count =
+                        CIPHER_BLOCK_SIZE - take % CIPHER_BLOCK_SIZE;
+                    slot.in_buffer.insert(
+                        slot.in_buffer.end(),
+                        padded_byte_count,
+                        (unsigned char)padded_byte_count);
+                }
+                slot.in = slot.in_buffer.data();
+                slot.in_size = slot.in_buffer.size();
+                return 0;
+            }
+
+            if (encrypt && (src_stream || compressed))
+            {
+                // A short read means end of input, so that chunk is the last
+                // and carries the padding. Input ending on a chunk boundary
+                // leaves a final chunk of padding alone.
+                size_t n = 0;
+                slot.in_buffer.resize(stream_chunk_size + CIPHER_BLOCK_SIZE);
+                if (read_source(&slot.in_buffer[0], stream_chunk_size, &n) != 0)
+                    return 1;
+                indexer.add_text(&slot.in_buffer[0], n);
+                slot.in_size = n;
+                if (n < stream_chunk_size)
+                {
+                    size_t padded_byte_count =
+                        CIPHER_BLOCK_SIZE - n % CIPHER_BLOCK_SIZE;
+                    memset(
+                        &slot.in_buffer[n],
+                        (int)padded_byte_count,
+                        padded_byte_count);
+                    slot.in_size += padded_byte_count;
+                    slot.last = true;
+                    indexer.finish_text();
+                }
+                slot.in = &slot.in_buffer[0];
+                bytes_read += n;
+                data_size += n;
+                return 0;
+            }
+
+            if (!encrypt && src_stream && streamed)
+            {
+                // The trailer follows the data, so the last
+                // sizeof(trailer) bytes read are always held back; at end
+                // of input they are the trailer.
+                size_t want = stream_chunk_size + sizeof(trailer);
+                while (pending.size() < want && !src_done)
+                {
+                    size_t have = pending.size();
+                    size_t n = 0;
+                    pending.resize(want);
+                    if (read_stream(src_stream, &pending[have], want - have, &n) != 0)
+                        return 1;
+                    pending.resize(have + n);
+                    src_done = have + n < want;
+                }
+                size_t take = pending.size() - sizeof(trailer);
+                if (pending.size() < sizeof(trailer) ||
+                    (src_done && (take == 0 || take % CIPHER_BLOCK_SIZE != 0)))
+                {
+                    cerr << "Host: " << input_file << " is truncated" << endl;
+                    return 1;
+                }
+                if (take > stream_chunk_size)
+                    take = stream_chunk_size;
+                else if (src_done)
+                    slot.last = true;
+                slot.in_buffer.assign(pending.begin(), pending.begin() + (long)take);
+                pending.erase(pending.begin(), pending.begin() + (long)take);
+                if (slot.last)
+                    memcpy(&trailer, &pending[0], sizeof(trailer));
+                slot.in = &slot.in_buffer[0];
+                slot.in_size = take;
+                bytes_read += take;
+                return 0;
+            }
+
+            size_t bytes_left = src_data_size - bytes_read;
+            if (!encrypt && src_stream)
+            {
+                // The data size is in the header; the record index after
+                // the data is not needed
+                size_t n = 0;
+                slot.in_size = bytes_left > stream_chunk_size
+                                   ? stream_chunk_size
+                                   : bytes_left;
+                slot.in_buffer.resize(slot.in_size);
+                if (read_stream(src_stream, slot.in_buffer.data(), slot.in_size, &n) != 0 ||
+                    n != slot.in_size)
+                {
+                    cerr << "Host: " << input_file << " is truncated" << endl;
+                    return 1;
+                }
+                slot.in = slot.in_buffer.data();
+                slot.last = bytes_left == slot.in_size;
+            }
+            else if (encrypt && bytes_left < stream_chunk_size)
+            {
+                // The CBC mode for AES assumes that we provide data in blocks
+                // of CIPHER_BLOCK_SIZE bytes. This sample uses PKCS#5 padding:
+                // pad the whole CIPHER_BLOCK_SIZE block if the remaining data
+                // is block aligned, otherwise pad the last partial block.
+                size_t padded_byte_count =
+                    CIPHER_BLOCK_SIZE - bytes_left % CIPHER_BLOCK_SIZE;
+                slot.in_buffer.resize(bytes_left + padded_byte_count);
+                memcpy(&slot.in_buffer[0], r_data + bytes_read, bytes_left);
+                memset(
+                    &slot.in_buffer[bytes_left],
+                    (int)padded_byte_count,
+                    padded_byte_count);
+                slot.in = &slot.in_buffer[0];
+                slot.in_size = slot.in_buffer.size();
+                slot.last = true;
+                indexer.add_text(r_data + bytes_read, bytes_left);
+                indexer.finish_text();
+                data_size += bytes_left;
+            }
+            else
+            {
+                slot.in = r_data + bytes_read;
+                slot.in_size = bytes_left > stream_chunk_size
+                                   ? stream_chunk_size
+                                   : bytes_left;
+                // When encrypting, the padding block always follows
+                slot.last = !encrypt && bytes_left == slot.in_size;
+                if (encrypt)
+                {
+                    indexer.add_text(slot.in, slot.in_size);
+                    data_size += slot.in_size;
+                }
+                else
+                    prefault(slot.in, slot.in_size);
+            }
+            bytes_read += slot.in_size;
+            return 0;
+        },
+        [&](pipeline_slot& slot) {
+            int status = 0;
+            if (slot.in_size == 0)
+                return 0;
+            if (slot.out.size() < slot.in_size)
+                slot.out.resize(slot.in_size);
+            oe_result_t status_result = encrypt_block(
+                enclave,
+                &status,
+                encryptor,
+                encrypt,
+                slot.in,
+                &slot.out[0],
+                slot.in_size);
+            if (status_result != OE_OK || status != 0)
+            {
+                cerr << "encrypt_block error 1" << endl;
+                return 1;
+            }
+            slot.out_size = slot.in_size;
+            return 0;
+        },
+        [&](pipeline_slot& slot) {
+            size_t bytes_to_write = slot.out_size;
+            encrypted_size += slot.out_size;
+            // The data size is always padded to align with CIPHER_BLOCK_SIZE
+            // during encryption. Therefore, remove the padding (if any) from
+            // the last block during decryption. Without a size in the
+            // header, the padding byte itself says how much to drop.
+            if (!encrypt && streamed && slot.last)
+            {
+                unsigned char pad = bytes_to_write > 0 ? slot.out[bytes_to_write - 1] : 0;
+                if (pad == 0 || pad > CIPHER_BLOCK_SIZE)
+                {
+                    cerr << "Host: invalid padding in " << input_file << endl;
+                    return 1;
+                }
+                bytes_to_write -= pad;
+            }
+            if (!encrypt)
+            {
+                if (bytes_to_write > plaintext_left)
+                    bytes_to_write = plaintext_left;
+                plaintext_left -= bytes_to_write;
+                data_size += bytes_to_write;
+            }
+            if (!dest_file)
+                return 0;
+            if (!encrypt && packed)
+            {
+                // Write packed sequences back out as text
+                unpacked.clear();
+                if (unpacker.feed(
+                        slot.out.data(),
+                        bytes_to_write,
+                        slot.last,
+                        unpacked) != 0)
+                {
+                    cerr << "Host: invalid packed sequence data" << endl;
+                    return 1;
+                }
+                if (fwrite(unpacked.data(), 1, unpacked.size(), dest_file) !=
+                    unpacked.size())
+                {
+                    cerr << "Host: fwrite error  " << output_file << endl;
+                    return 1;
+                }
+                return 0;
+            }
+            if (bytes_to_write > 0 &&
+                fwrite(&slot.out[0], 1, bytes_to_write, dest_file) !=
+                    bytes_to_write)
+            {
+                cerr << "Host: fwrite error  " << output_file << endl;
+                return 1;
+            }
+            return 0;
+        });
+    if (ret != 0)
+        goto exit;
+
+    // The trailer of a streamed input has only just arrived
+    if (!encrypt && src_stream && streamed &&
+        (apply_stream_trailer(trailer, encrypted_size, &header) != 0 ||
+         header.file_data_size != data_size))
+    {
+        cerr << "Host: invalid stream trailer in " << input_file << endl;
+        ret = 1;
+        goto exit;
+    }
+
+    // The MAC covers the data only, so it is finished before the record
+    // index goes through the encryptor
+    result = ecall_finishmac(enclave, &ret, encryptor, data_mac, sizeof(data_mac));
+    if (result != OE_OK || ret != 0)
+    {
+        cerr << "Host: ecall_finishmac failed" << endl;
+        ret = 1;
+        goto exit;
+    }
+    if (!encrypt && memcmp(data_mac, header.data_mac, sizeof(data_mac)) != 0)
+    {
+        cerr << "Host: integrity check failed: " << input_file
+             << " is corrupt or was modified" << endl;
+        ret = 1;
+        goto exit;
+    }
+
+    if (encrypt && streamed)
+    {
+        // A pipe cannot be rewound for the header, so the sizes and MAC
+        // follow the data. Streamed files carry no record index.
+        memset(&trailer, 0, sizeof(trailer));
+        trailer.magic = ENCRYPTION_TRAILER_MAGIC;
+        trailer.file_data_size = data_size;
+        trailer.record_count = (size_t)indexer.records();
+        memcpy(trailer.data_mac, data_mac, sizeof(data_mac));
+        if (fwrite(&trailer, 1, sizeof(trailer), dest_file) != sizeof(trailer) ||
+            fflush(dest_file) != 0)
+        {
+            cerr << "Host: writing stream trailer failed" << endl;
+            ret = 1;
+            goto exit;
+        }
+        if (packed)
+            cout << "Host: packed " << packer.records() << " sequences into "
+                 << data_size << " bytes" << endl;
+    }
+    else if (encrypt)
+    {
+        memcpy(header.data_mac, data_mac, sizeof(data_mac));
+        if (write_record_index(encryptor, indexer, dest_file) != 0)
+        {
+            cerr << "Host: writing record index failed" << endl;
+            ret = 1;
+            goto exit;
+        }
+        if (packed)
+        {
+            cout << "Host: packed " << packer.records() << " sequences into "
+                 << data_size << " bytes" << endl;
+        }
+        header.file_data_size = data_size;
+        header.index_stride = (unsigned int)indexer.stride();
+        header.record_count = (size_t)indexer.records();
+        header.index_offset = encrypted_size;
+        header.index_entries = indexer.entries();
+        if (fseek(dest_file, 0, SEEK_SET) != 0 ||
+            fwrite(&header, 1, sizeof(header), dest_file) != sizeof(header))
+        {
+            cerr << "Host: rewriting header failed" << endl;
+            ret = 1;
+            goto exit;
+        }
+        cout << "Host: indexed " << header.record_count << " records" << endl;
+    }
+    else if (dest_file && fflush(dest_file) != 0)
+    {
+        cerr << "Host: fwrite error  " << output_file << endl;
+        ret = 1;
+        goto exit;
+    }
+
+    cout << "Host: done  " << (encrypt ? "encrypting" : "decrypting") << endl;
+
+exit:
+    if (dest_file && dest_file != stdout)
+        fclose(dest_file);
+    if (encryptor_open)
+    {
+        cout << "Host: called close_encryptor" << endl;
+        result = close_encryptor(enclave, encryptor);
+        if (result != OE_OK)
+        {
+            ret = 1;
+        }
+    }
+    return ret;
+}
+
+// Opens the sealed score file input_file (see shared.h) in the enclave and
+// writes its scores to output_file, or stdout for "-": as text, like
+// decrypt, or with --binary as a binary score file
+int unseal_scores(const char* input_file, const char* output_file)
+{
+    oe_result_t result;
+    int ret = 0;
+    mapped_file src_file;
+    FILE* dest_file = NULL;
+    const unsigned char* data = NULL;
+    size_t size = 0;
+    size_t pos = 0;
+    sealed_scores_header_t header;
+    size_t encryptor = 0;
+    bool encryptor_open = false;
+    bool last = false;
+    size_t row_count = 0;
+    vector<unsigned char> rows;
+    score_file_writer binary;
+    text_writer text(NULL, score_precision);
+
+    if (src_file.open(input_file) != 0)
+    {
+        cerr << "Host: open " << input_file << " failed." << endl;
+        ret = 1;
+        goto exit;
+    }
+    data = src_file.data();
+    size = src_file.size();
+    if (size >= sizeof(header))
+        memcpy(&header, data, sizeof(header));
+    if (size < sizeof(header) || header.magic != SEALED_SCORES_MAGIC ||
+        header.version != SEALED_SCORES_VERSION ||
+        (size - sizeof(header)) / sizeof(model_id_t) < header.columns)
+    {
+        cerr << "Host: " << input_file << " is not a sealed score file" << endl;
+        ret = 1;
+        goto exit;
+    }
+    pos = sizeof(header) + header.columns * sizeof(model_id_t);
+
+    if (strcmp(output_file, "-") == 0)
+    {
+        dest_file = stdout;
+        set_binary_mode(stdout);
+    }
+    else if (!(dest_file = fopen(output_file, "wb")))
+    {
+        cerr << "Host: fopen " << output_file << " failed." << endl;
+        ret = 1;
+        goto exit;
+    }
+
+    // The key comes from the header of the file that was scored
+    result = initialize_encryptor(enclave, &ret, DECRYPT_OPERATION, &header.key, &encryptor);
+    if (result != OE_OK || ret != 0)
+    {
+        ret = 1;
+        goto exit;
+    }
+    encryptor_open = true;
+
+    if (binary_scores)
+    {
+        if (binary.open(
+                dest_file,
+                (const model_id_t*)(data + sizeof(header)),
+                header.columns,
+                binary_encoding) != 0)
+        {
+            cerr << "Host: fwrite error  " << output_file << endl;
+            ret = 1;
+            goto exit;
+        }
+    }
+    else
+    {
+        text.set_file(dest_file);
+        for (size_t i = 0; i < header.columns; i++)
+        {
+            model_id_t id;
+            memcpy(&id, data + sizeof(header) + i * sizeof(id), sizeof(id));
+            if (i > 0)
+                text.put('\t');
+            text.put_model_id(id);
+        }
+        text.put('\n');
+    }
+
+    while (pos < size && !last)
+    {
+        sealed_chunk_header_t chunk;
+        int status = 0;
+        if (size - pos < sizeof(chunk))
+            break;
+        memcpy(&chunk, data + pos, sizeof(chunk));
+        if (chunk.size > size - pos - sizeof(chunk) || chunk.columns != header.columns)
+            break;
+
+        size_t chunk_size = sizeof(chunk) + chunk.size;
+        rows.resize(chunk_size);
+        result = ecall_opensealed(enclave, &status, encryptor, data + pos, chunk_size, &rows[0]);
+        if (result != OE_OK || status != 0)
+        {
+            cerr << "Host: sealed chunk " << chunk.sequence << " of " << input_file
+                 << " failed authentication" << endl;
+            ret = 1;
+            goto exit;
+        }
+        if (binary_scores)
+        {
+            if (binary.add_rows((const float*)&rows[0], chunk.rows) != 0)
+            {
+                cerr << "Host: fwrite error  " << output_file << endl;
+                ret = 1;
+                goto exit;
+            }
+        }
+        else
+        {
+            print_score_rows(text, (const float*)&rows[0], chunk.rows, chunk.columns);
+        }
+        row_count += chunk.rows;
+        last = (chunk.flags & SEALED_CHUNK_LAST) != 0;
+        pos += chunk_size;
+    }
+    if (!last || pos != size)
+    {
+        cerr << "Host: " << input_file << " is truncated or damaged" << endl;
+        ret = 1;
+        goto exit;
+    }
+    if ((binary_scores ? binary.finish() : text.flush()) != 0)
+    {
+        cerr << "Host: fwrite error  " << output_file << endl;
+        ret = 1;
+        goto exit;
+    }
+    cout << "Host: unsealed " << row_count << " score rows" << endl;
+
+exit:
+    if (dest_file && dest_file != stdout)
+        fclose(dest_file);
+    if (encryptor_open)
+        close_encryptor(enclave, encryptor);
+    return ret;
+}
+
+// host calls from enclave
+
+model_set loadmodelids(const char* modelfile) {
+    // Parses model-ids-file and adds each id to a new model set in the enclave
+    char buffer[1024];
+    model_id_t id;
+    FILE* file = fopen(modelfile, "r");
+    oe_result_t result;
+    model_set set = {0, 0};
+
+    if (!file) {
+        cout << "couldnt call " << modelfile;
+        exit(-1);
+    }
+
+    result = ecall_addmodelset(enclave, &set.id);
+    if (result != OE_OK) {
+        cout << "Trouble initialising model" << endl;
+        exit(-1);
+    }
+
+    while (fgets(buffer, 1024, file)) {
+        if (buffer[0] != '#') {
+            trim_trailing_whitespace(buffer);
+            id = str2id(buffer);
+            result = ecall_addIDtomodel(enclave, set.id, id.major, id.minor);
+            if (result != OE_OK) {
+                cout << "Trouble adding id to model via ecall ";
+                exit(-1);
+            }
+            set.count++;
+        }
+    }
+    fclose(file);
+    return set;
+}
+
+void load_model_paramlist(FILE* file, char* param_file, const char* param_name, float** _dst, int num_params)
+{
+	int i;
+	char buffer[64];
+	float* dst = 0;
+	*_dst = 0;
+	strcpy(buffer, param_name);
+	if (num_params > 0) {
+		float* dst = (float*)malloc(sizeof(float) * num_params);
+		strcat(buffer, " = %f");
+		if (fscanf(file, buffer, &dst[0]) != 1)
+			panic("Failed parsing %s in file %s", param_file, param_name);
+		for (i = 1; i < num_params; ++i)
+			if (fscanf(file, ",%f", &dst[i]) != 1)
+				panic("Failed parsing %s in file %s", param_file, param_name);
+		fscanf(file, "\n"); // eat up the carriage return
+		*_dst = dst;
+	}
+	else {
+		strcat(buffer, " = ");
+		fscanf(file, buffer); // eat up the line
+	}
+}
+
+// Where decrypt_file_to_enclave sends score rows: as text through out,
+// through binary into a binary score file, or as sealed chunks through out if
+// seal is set. With a checkpoint, the rows written are counted in it.
+struct score_output
+{
+    text_writer* out;
+    score_file_writer* binary;
+    checkpoint_writer* checkpoint;
+    bool seal;
+};
+
+// Decrypts and scores the encrypted data from the block aligned offset begin
+// to end, or until the enclave reports that the records selected by
+// ecall_seekrecord are done. The CBC chain of the encryptor session must
+// already be positioned at begin.
+static int score_encrypted_data(
+    size_t encryptor,
+    const unsigned char* data,
+    size_t begin,
+    size_t end,
+    size_t plaintext_size,
+    const model_set& models,
+    const score_output& output,
+    framer_stats_t* stats)
+{
+    size_t bytes_read = begin;
+    size_t plaintext_left = plaintext_size > begin ? plaintext_size - begin : 0;
+
+    // The reader thread hands out stream_chunk_size spans of the mapped file.
+    // The enclave decrypts each one in its own memory and scores the
+    // sequences it contains, carrying a sequence cut by the chunk boundary
+    // over to the next chunk. The score rows it reports are printed by the
+    // writer thread while the enclave moves on to the next chunk.
+    return run_pipeline(
+        [&](pipeline_slot& slot) {
+            size_t bytes_left = end - bytes_read;
+            slot.in = data + bytes_read;
+            slot.in_size =
+                bytes_left > stream_chunk_size ? stream_chunk_size : bytes_left;
+            slot.last = bytes_left == slot.in_size;
+            prefault(slot.in, slot.in_size);
+            bytes_read += slot.in_size;
+            return 0;
+        },
+        [&](pipeline_slot& slot) {
+            int status = 0;
+            if (slot.in_size == 0)
+                return 0;
+
+            // The last chunk carries the PKCS#5 padding, which is not scored
+            size_t data_size =
+                slot.in_size > plaintext_left ? plaintext_left : slot.in_size;
+            plaintext_left -= data_size;
+
+            pending_scores = &slot.scores;
+            pending_sealed = &slot.sealed;
+            pending_names = &slot;
+            oe_result_t status_result = ecall_decryptpredict(
+                enclave,
+                &status,
+                encryptor,
+                models.id,
+                slot.in,
+                slot.in_size,
+                slot.last,
+                data_size,
+                stats);
+            pending_scores = NULL;
+            pending_sealed = NULL;
+            pending_names = NULL;
+            if (status_result != OE_OK || status < 0)
+            {
+                cerr << "Host: ecall_decryptpredict failed" << endl;
+                return 1;
+            }
+            // The selected records are done; stop reading
+            if (status == 1)
+                slot.last = true;
+            return 0;
+        },
+        [&](pipeline_slot& slot) {
+            size_t rows = 0;
+            size_t chunks = 0;
+            if (!slot.sealed.empty())
+            {
+                count_sealed_chunks(slot.sealed, &rows, &chunks);
+                output.out->write(slot.sealed.data(), slot.sealed.size());
+            }
+            else if (models.count > 0)
+            {
+                rows = slot.scores.size() / (size_t)models.count;
+                if (!output.binary)
+                    print_slot_rows(*output.out, slot, (size_t)models.count);
+                else if (output.binary->add_rows(slot.scores.data(), rows) != 0)
+                {
+                    cerr << "Host: writing binary scores failed" << endl;
+                    return 1;
+                }
+            }
+            if (output.checkpoint && output.checkpoint->add_records(rows, chunks) != 0)
+            {
+                cerr << "Host: writing checkpoint failed" << endl;
+                return 1;
+            }
+            return 0;
+        });
+}
+
+// Hands the encrypted record index after the data to the enclave, which keeps
+// it for ecall_seekrecord
+static int load_record_index(
+    size_t encryptor,
+    const unsigned char* data,
+    size_t size,
+    const encryption_header_t& header)
+{
+    size_t index_size = header.index_entries * RECORD_INDEX_ENTRY_SIZE;
+    index_size += (CIPHER_BLOCK_SIZE - index_size % CIPHER_BLOCK_SIZE) %
+                  CIPHER_BLOCK_SIZE;
+    if (header.index_entries == 0 || header.index_offset < CIPHER_BLOCK_SIZE ||
+        header.index_offset % CIPHER_BLOCK_SIZE != 0 ||
+        header.index_offset > size || size - header.index_offset < index_size)
+    {
+        cerr << "Host: the file has no usable record index" << endl;
+        return 1;
+    }
+
+    data += header.index_offset;
+    int status = 0;
+    if (ecall_setiv(enclave, &status, encryptor, data - CIPHER_BLOCK_SIZE, IV_SIZE) != OE_OK ||
+        status != 0)
+        return 1;
+    for (size_t pos = 0; pos < index_size; pos += stream_chunk_size)
+    {
+        size_t chunk = index_size - pos;
+        if (chunk > stream_chunk_size)
+            chunk = stream_chunk_size;
+        if (ecall_loadindex(enclave, &status, encryptor, data + pos, chunk) != OE_OK ||
+            status != 0)
+        {
+            cerr << "Host: ecall_loadindex failed" << endl;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Drops the first skip records from a selection of ranges sorted by first
+// record, clipped to the record_count records of the file
+static void skip_selected_records(
+    vector<record_range>& ranges,
+    size_t record_count,
+    size_t skip)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < ranges.size(); i++)
+    {
+        record_range range = ranges[i];
+        if (skip > 0 && range.first < record_count)
+        {
+            size_t count = range.count;
+            if (count > record_count - range.first)
+                count = record_count - range.first;
+            if (skip >= count)
+            {
+                skip -= count;
+                continue;
+            }
+            range.first += skip;
+            range.count = count - skip;
+            skip = 0;
+        }
+        ranges[kept++] = range;
+    }
+    ranges.resize(kept);
+}
+
+// Decrypts input_file inside the enclave and writes the scores of its
+// sequences against models to output. With a checkpoint, the records it has
+// already counted are skipped.
+int decrypt_file_to_enclave(
+    bool encrypt,
+    const char* input_file,
+    const model_set& models,
+    const score_output& output)
+{
+    checkpoint_writer* checkpoint = output.checkpoint;
+    oe_result_t result;
+    int ret = 0;
+    mapped_file src_file;
+    const unsigned char* r_data = NULL;
+    size_t src_data_size = 0;
+    encryption_header_t header;
+    size_t encryptor = 0;
+    bool encryptor_open = false;
+    framer_stats_t stats = {0, 0, 0};
+    vector<record_range> ranges;
+    vector<unsigned char> last_chunk;
+    bool scored_all = false;
+
+    // map the source file and open the dest file
+    if (src_file.open(input_file) != 0)
+    {
+        cout << "Host: open " << input_file << " failed." << endl;
+        ret = 1;
+        goto exit;
+    }
+    r_data = src_file.data();
+    src_data_size = src_file.size();
+
+    // For decryption, we want to read encryption header data into the header
+    // structure before calling initialize_encryptor
+    if (src_data_size < sizeof(header))
+    {
+        cerr << "Host: read header failed." << endl;
+        ret = 1;
+        goto exit;
+    }
+    memcpy(&header, r_data, sizeof(header));
+    r_data += sizeof(header);
+    src_data_size -= sizeof(header);
+    if (read_stream_trailer(r_data, &src_data_size, &header) != 0)
+    {
+        cerr << "Host: invalid stream trailer in " << input_file << endl;
+        ret = 1;
+        goto exit;
+    }
+
+    // Initialize the encryptor inside the enclave
+    // Parameters: encrypt: a bool value to set the encryptor mode, true for
+    // encryption and false for decryption
+    // the key comes from the session opened by open_password_session. Upon
+    // return, _header will be filled with encryption key information for
+    // encryption operation. In the case of decryption, the caller provides
+    // header information from a previously encrypted file
+    result = initialize_encryptor(
+        enclave, &ret, DECRYPT_OPERATION, &header, &encryptor);
+    if (result != OE_OK)
+    {
+        ret = 1;
+        goto exit;
+    }
+    if (ret != 0)
+    {
+        goto exit;
+    }
+    encryptor_open = true;
+
+    if (output.seal)
+    {
+        int status = 0;
+        result = ecall_sealscores(
+            enclave, &status, encryptor, checkpoint ? checkpoint->state().chunks : 0);
+        if (result != OE_OK || status != 0)
+        {
+            cerr << "Host: ecall_sealscores failed" << endl;
+            ret = 1;
+            goto exit;
+        }
+    }
+
+    // A resumed run continues with the records after those already scored,
+    // reached through the record index like a --records selection
+    ranges = record_ranges;
+    if (checkpoint && checkpoint->state().records > 0)
+    {
+        if (ranges.empty())
+        {
+            record_range all = {0, header.record_count};
+            ranges.push_back(all);
+        }
+        skip_selected_records(ranges, header.record_count, checkpoint->state().records);
+        if (ranges.empty())
+        {
+            cout << "Host: all selected records were already scored" << endl;
+            scored_all = true;
+        }
+    }
+
+    if (ranges.empty() && !scored_all)
+    {
+        ret = score_encrypted_data(
+            encryptor,
+            r_data,
+            0,
+            encrypted_data_size(header, src_data_size),
+            header.file_data_size,
+            models,
+            output,
+            &stats);
+        if (ret != 0)
+            goto exit;
+    }
+    else if (!scored_all)
+    {
+        // Only the chunks holding the selected records are decrypted: each
+        // range starts at the block of the nearest indexed record before it
+        ret = load_record_index(encryptor, r_data, src_data_size, header);
+        if (ret != 0)
+            goto exit;
+
+        for (size_t i = 0; i < ranges.size(); i++)
+        {
+            int status = 0;
+            size_t offset = 0;
+            size_t first = ranges[i].first;
+            size_t count = ranges[i].count;
+            if (first >= header.record_count)
+            {
+                cerr << "Host: the file holds only " << header.record_count
+                     << " records" << endl;
+                break;
+            }
+            if (count > header.record_count - first)
+                count = header.record_count - first;
+
+            result = ecall_seekrecord(enclave, &status, encryptor, first, count, &offset);
+            if (result != OE_OK || status != 0 ||
+                offset >= header.index_offset)
+            {
+                cerr << "Host: ecall_seekrecord failed" << endl;
+                ret = 1;
+                goto exit;
+            }
+            result = ecall_setiv(
+                enclave,
+                &status,
+                encryptor,
+                offset > 0 ? r_data + offset - CIPHER_BLOCK_SIZE : NULL,
+                offset > 0 ? IV_SIZE : 0);
+            if (result != OE_OK || status != 0)
+            {
+                ret = 1;
+                goto exit;
+            }
+            ret = score_encrypted_data(
+                encryptor,
+                r_data,
+                offset,
+                encrypted_data_size(header, src_data_size),
+                header.file_data_size,
+                models,
+                output,
+                &stats);
+            if (ret != 0)
+                goto exit;
+        }
+    }
+
+    // The final chunk tells a reader that no chunks were cut off the end
+    if (output.seal)
+    {
+        int status = 0;
+        pending_sealed = &last_chunk;
+        result = ecall_finishscores(enclave, &status, encryptor, (unsigned int)models.count);
+        pending_sealed = NULL;
+        if (result != OE_OK || status != 0)
+        {
+            cerr << "Host: ecall_finishscores failed" << endl;
+            ret = 1;
+            goto exit;
+        }
+        output.out->write(last_chunk.data(), last_chunk.size());
+        if (checkpoint && checkpoint->add_records(0, 1) != 0)
+        {
+            cerr << "Host: writing checkpoint failed" << endl;
+            ret = 1;
+            goto exit;
+        }
+    }
+    if (output.out && output.out->flush() != 0)
+    {
+        cerr << "Host: writing scores failed" << endl;
+        ret = 1;
+        goto exit;
+    }
+
+    cout << "Host: done decrypting, scored " << stats.records
+         << " sequences from " << stats.bytes << " bytes" << endl;
+
+exit:
+    // A failed run still hands over the rows it scored
+    if (output.out && output.out->flush() != 0)
+        ret = 1;
+    if (encryptor_open)
+    {
+        cout << "Host: called close_encryptor" << endl;
+        result = close_encryptor(enclave, encryptor);
+        if (result != OE_OK)
+        {
+            ret = 1;
+        }
+    }
+    return ret;
+}
+
+deepbind_model_t* load_model(model_id_t id)
+{
+	char param_file[512];
+	int major_version = 0;
+	int minor_version = 0;
+	deepbind_model_t* model = 0;
+	FILE* file = 0;
+
+	/* Find path to file*/
+	strcpy(param_file, DIRECTORY_OF_PARAMETERS);
+	id2str(id, param_file + strlen(param_file));
+	strcat(param_file, ".txt");
+    // cout << "param_file to open = " << param_file << endl;
+
+	/* Open the file and parse each line */
+	file = fopen(param_file, "r");
+	if (!file)
+		panic("Could not open param file %s.", param_file);
+
+	if (fscanf(file, "# deepbind %d.%d\n", &major_version, &minor_version) != 2)
+		panic("Expected parameter file to start with \"# deepbind 0.1\"");
+	if (major_version != 0 || minor_version != 1)
+		panic("Param file is for deepbind %d.%d, not 0.1", major_version, minor_version);
+
+	model = (deepbind_model_t*)malloc(sizeof(deepbind_model_t));
+	model->id = id;
+
+	if (fscanf(file, "reverse_complement = %d\n", &model->reverse_complement) != 1) panic("Failed parsing reverse_complement in %s", param_file);
+	if (fscanf(file, "num_detectors = %d\n", &model->num_detectors) != 1)      panic("Failed parsing num_detectors in %s", param_file);
+	if (fscanf(file, "detector_len = %d\n", &model->detector_len) != 1)       panic("Failed parsing detector_len in %s", param_file);
+	if (fscanf(file, "has_avg_pooling = %d\n", &model->has_avg_pooling) != 1)    panic("Failed parsing has_avg_pooling in %s", param_file);
+	if (fscanf(file, "num_hidden = %d\n", &model->num_hidden) != 1)         panic("Failed parsing num_hidden in %s", param_file);
+
+	load_model_paramlist(file, param_file, "detectors", &model->detectors, model->num_detectors * model->detector_len * 4);
+	load_model_paramlist(file, param_file, "thresholds", &model->thresholds, model->num_detectors);
+	load_model_paramlist(file, param_file, "weights1", &model->weights1, get_num_hidden1(model) * get_num_hidden2(model));
+	load_model_paramlist(file, param_file, "biases1", &model->biases1, get_num_hidden2(model));
+	load_model_paramlist(file, param_file, "weights2", &model->weights2, model->num_hidden ? model->num_hidden : 0);
+	load_model_paramlist(file, param_file, "biases2", &model->biases2, model->num_hidden ? 1 : 0);
+
+	fclose(file);
+	return model;
+}
+
+/* Loads model parameters to deepbind model in enclave.
+    Also prints headers on stdout.  */
+void loadmodelparams(const model_set& models, vector<deepbind_model_t*>* parsed = NULL) {
+    model_id_t modelid;
+    deepbind_model_t* model;
+    oe_result_t result;
+
+    cout << "Host: Loading parameters onto enclave model.\n";
+
+    for (int i = 0; i < models.count; i++) {
+        result = ecall_getdbmodelid(enclave, &modelid, models.id, (size_t) i);
+        model = load_model(modelid);
+        result = ecall_loadparams(enclave, models.id, *model);
+        if (result != OE_OK) {
+            cout << "error on ecall_loadparams " << i << "\n";
+            exit(-1);
+        }
+        if (parsed) {
+            parsed->push_back(model);
+        }
+        
+        
+    }
+}
+
+void printmodelids(const model_set& models, text_writer& out) {
+    oe_result_t result;
+    model_id_t id;
+    for (size_t i = 0; i < static_cast<size_t>(models.count); i++) {
+        result = ecall_getdbmodelid(enclave, &id, models.id, i);
+        if (i > 0) {
+            out.put('\t');
+        }
+        out.put_model_id(id);
+    }
+    
+    out.put('\n');
+}
+
+// Creates a model set in another enclave holding models already parsed for
+// the first, so the parameter files are read once. Returns non-zero on
+// failure.
+static int pushmodels(oe_enclave_t* target, const vector<deepbind_model_t*>& params, model_set* set)
+{
+    set->id = 0;
+    set->count = 0;
+    if (ecall_addmodelset(target, &set->id) != OE_OK) {
+        return 1;
+    }
+    for (size_t i = 0; i < params.size(); i++) {
+        const model_id_t& id = params[i]->id;
+        if (ecall_addIDtomodel(target, set->id, id.major, id.minor) != OE_OK ||
+            ecall_loadparams(target, set->id, *params[i]) != OE_OK) {
+            return 1;
+        }
+        set->count++;
+    }
+    return 0;
+}
+
+// Creates enclave_count enclaves from image with lanes worker threads each.
+// The workers of an enclave are pinned to a NUMA node, nodes being used in
+// turn, and the first of them creates it, so its host memory is on that
+// node. enclave is set to the first; the main thread uses it as before.
+static int start_enclave_pool(const char* image, uint32_t flags, size_t lanes)
+{
+    vector<vector<int> > nodes = numa_nodes();
+    vector<vector<int> > cpus;
+    vector<oe_result_t> results(enclave_count * lanes, OE_OK);
+
+    for (size_t i = 0; i < enclave_count * lanes; i++) {
+        cpus.push_back(nodes[(i / lanes) % nodes.size()]);
+    }
+    pool_enclaves.assign(enclave_count * lanes, NULL);
+    pool_workers.start(cpus);
+    pool_workers.run([&](size_t i) {
+        if (i % lanes == 0) {
+            results[i] = oe_create_fileencryptor_enclave(
+                image, OE_ENCLAVE_TYPE_SGX, flags, NULL, 0, &pool_enclaves[i]);
+        }
+    });
+    for (size_t i = 0; i < results.size(); i++) {
+        if (results[i] != OE_OK) {
+            cerr << "oe_create_fileencryptor_enclave() failed for enclave " << i / lanes
+                 << " with " << results[i] << endl;
+            return 1;
+        }
+        pool_enclaves[i] = pool_enclaves[i - i % lanes];
+    }
+    enclave = pool_enclaves[0];
+    cout << "Host: created " << enclave_count << " enclave(s) with " << lanes
+         << " thread(s) each on " << min(nodes.size(), enclave_count) << " NUMA node(s)" << endl;
+    return 0;
+}
+
+static void stop_enclave_pool()
+{
+    if (pool_enclaves.empty()) {
+        return;
+    }
+    pool_workers.stop();
+    // the lanes of an enclave are next to each other
+    for (size_t i = 0; i < pool_enclaves.size(); i++) {
+        if (pool_enclaves[i] && (i == 0 || pool_enclaves[i] != pool_enclaves[i - 1])) {
+            oe_terminate_enclave(pool_enclaves[i]);
+        }
+    }
+    pool_enclaves.clear();
+    enclave = NULL;
+}
+
+// How predictseqs spreads its batches over the lanes of the enclave pool:
+// the model set each lane scores with, and the models split into a group of
+// about equal estimated cost per lane (see scheduler.h)
+struct lane_plan
+{
+    vector<model_set> sets;
+    vector<size_t> groups;      // first model of each group, then the count
+    vector<double> group_costs; // cost of a window with every model of a group
+};
+
+// Loads the models into the other enclaves of the pool, each by its first
+// lane's worker, and splits them into groups for the lanes
+static int plan_lanes(const model_set& models, const vector<deepbind_model_t*>& params,
+                      lane_plan* plan)
+{
+    size_t lanes = pool_enclaves.size();
+    vector<int> failed(lanes, 0);
+    vector<double> costs;
+
+    plan->sets.assign(lanes, models);
+    pool_workers.run([&](size_t l) {
+        if (pool_enclaves[l] != enclave && (l == 0 || pool_enclaves[l] != pool_enclaves[l - 1])) {
+            failed[l] = pushmodels(pool_enclaves[l], params, &plan->sets[l]);
+        }
+    });
+    for (size_t l = 0; l < lanes; l++) {
+        if (failed[l]) {
+            cerr << "Host: loading models into the enclave of thread " << l << " failed" << endl;
+            return 1;
+        }
+        if (l > 0 && pool_enclaves[l] == pool_enclaves[l - 1]) {
+            plan->sets[l] = plan->sets[l - 1];
+        }
+    }
+
+    for (size_t i = 0; i < params.size(); i++) {
+        costs.push_back(model_window_cost(*params[i]));
+    }
+    plan->groups = split_models(costs, lanes);
+    plan->group_costs.assign(plan->groups.size() - 1, 0);
+    for (size_t g = 0; g + 1 < plan->groups.size(); g++) {
+        for (size_t i = plan->groups[g]; i < plan->groups[g + 1]; i++) {
+            plan->group_costs[g] += costs[i];
+        }
+    }
+    return 0;
+}
+
+// Sequences are read in batches of this many records per pipeline slot, and
+// each batch is scored in a single ecall. With a pool of lanes a slot holds
+// a batch per lane, cut into tasks of PREDICT_TASK_RECORDS records for one
+// model group each, which the lanes share out by estimated cost.
+#define PREDICT_BATCH_RECORDS 256
+#define PREDICT_TASK_RECORDS 64
+
+// predict_sink return values that stop the parser
+#define PREDICT_SLOT_FULL 1
+#define PREDICT_DONE 2 // past the last --records range
+
+// Collects the records parsed from a sequence file into a pipeline slot,
+// skipping those outside --records. A record whose sequence is one run of
+// text without blanks is left where it is in the mapped file; others, and
+// all records of a compressed file, are copied into the slot's in_buffer
+// without their blanks.
+struct predict_sink {
+    const unsigned char* text;     // the mapped sequence file, or NULL
+    pipeline_slot* slot;
+    slot_record current;
+    bool started;                  // current holds part of a sequence
+    size_t number;                 // records parsed so far
+    size_t range_index;            // first --records range not yet passed
+    size_t batch;                  // records per slot
+
+    int bases(const unsigned char* data, size_t size) {
+        if (!started && text && seq_find_blank(data, size) == size) {
+            current.offset = (size_t)(data - text);
+            current.size = size;
+            current.copied = false;
+            started = true;
+            return 0;
+        }
+        if (!started) {
+            current.offset = slot->in_buffer.size();
+            current.size = 0;
+            current.copied = true;
+            started = true;
+        } else if (!current.copied) {
+            const unsigned char* seq = text + current.offset;
+            current.offset = slot->in_buffer.size();
+            current.copied = true;
+            slot->in_buffer.insert(slot->in_buffer.end(), seq, seq + current.size);
+        }
+        while (size > 0) {
+            size_t run = seq_find_blank(data, size);
+            slot->in_buffer.insert(slot->in_buffer.end(), data, data + run);
+            current.size += run;
+            if (run < size) {
+                run++;
+            }
+            data += run;
+            size -= run;
+        }
+        return 0;
+    }
+
+    int record(uint64_t start, const char* name) {
+        size_t index = number++;
+        bool selected = true;
+        int ret = 0;
+        if (!record_ranges.empty()) {
+            // skip records outside the --records ranges and stop after the
+            // last one
+            while (range_index < record_ranges.size() &&
+                   index >= record_ranges[range_index].first + record_ranges[range_index].count) {
+                range_index++;
+            }
+            if (range_index == record_ranges.size()) {
+                selected = false;
+                ret = PREDICT_DONE;
+            } else if (index < record_ranges[range_index].first) {
+                selected = false;
+            }
+        }
+        if (selected) {
+            slot->records.push_back(current);
+            if (name) {
+                slot->names.insert(slot->names.end(), name, name + strlen(name));
+                slot->name_ends.push_back(slot->names.size());
+            }
+            if (slot->records.size() == batch) {
+                ret = PREDICT_SLOT_FULL;
+            }
+        } else if (current.copied) {
+            slot->in_buffer.resize(current.offset);
+        }
+        started = false;
+        return ret;
+    }
+};
+
+int predictseqs(const char* seqfile, const model_set& models, text_writer& out,
+                const lane_plan* lanes = NULL) {
+    // Parses sequences-file and calls enclave to obtain predictions. The file
+    // is mapped and a reader thread parses batches of records out of it
+    // while the enclave scores the previous batch and a writer thread prints
+    // the batch before that. A gzip or BGZF file is decompressed by the
+    // reader thread in stream_chunk_size pieces as it goes. With lanes, the
+    // batches are scored by all the lanes of the enclave pool at once.
+
+    mapped_file file;
+    gzip_reader gzip;
+    bool compressed = false;
+    bool gzip_done = false;
+    vector<unsigned char> text;    // decompressed text not parsed yet
+    const unsigned char* data = NULL;
+    size_t size = 0;
+    size_t pos = 0;
+    int num_models = models.count;
+    int lineindex = 0;
+    vector<seq_span_t> spans;
+    seq_text_parser parser;
+    predict_sink sink;
+    task_queues queues;
+    vector<vector<float> > tiles(lanes ? lanes->sets.size() : 0);
+
+    if (file.open(seqfile) != 0) {
+        cout << "error opening file " << seqfile;
+        return 1;
+    }
+    data = file.data();
+    size = file.size();
+    memset(&sink, 0, sizeof(sink));
+    sink.text = data;
+    sink.batch = PREDICT_BATCH_RECORDS * (lanes ? lanes->sets.size() : 1);
+    if (gzip_reader::is_gzip(data, size)) {
+        if (gzip.open(data, size, 0) != 0) {
+            cerr << "Host: " << seqfile << " is not valid gzip data" << endl;
+            return 1;
+        }
+        compressed = true;
+        sink.text = NULL;
+        size = 0;
+    } else {
+        // a --shards worker starts at the first record of its shard
+        pos = shard_text_offset;
+        sink.number = shard_first_record;
+    }
+
+    int ret = run_pipeline(
+        [&](pipeline_slot& slot) {
+            slot.in_buffer.clear();
+            sink.slot = &slot;
+            while (!slot.last && slot.records.size() < sink.batch) {
+                int status = 0;
+                if (pos == size && compressed && !gzip_done) {
+                    size_t n = 0;
+                    text.resize(stream_chunk_size);
+                    if (gzip.read(&text[0], text.size(), &n) != 0) {
+                        cerr << "Host: " << seqfile << " is not valid gzip data" << endl;
+                        return 1;
+                    }
+                    data = &text[0];
+                    size = n;
+                    pos = 0;
+                    gzip_done = n < text.size();
+                    continue;
+                }
+                if (pos < size) {
+                    size_t used = 0;
+                    status = parser.parse(data + pos, size - pos, sink, &used);
+                    pos += used;
+                } else {
+                    status = parser.finish(sink);
+                    slot.last = true;
+                }
+                if (status < 0) {
+                    cerr << "Host: " << seqfile << " is not valid sequence text" << endl;
+                    return 1;
+                }
+                if (status == PREDICT_DONE) {
+                    slot.last = true;
+                }
+            }
+            return 0;
+        },
+        [&](pipeline_slot& slot) {
+            // The whole batch is scored in one ecall, straight from the
+            // mapped file where the records lie there
+            size_t count = slot.records.size();
+            if (count == 0) {
+                return 0;
+            }
+            spans.resize(count);
+            for (size_t r = 0; r < count; r++) {
+                const slot_record& record = slot.records[r];
+                spans[r].data = record.copied ? &slot.in_buffer[record.offset]
+                                              : file.data() + record.offset;
+                spans[r].size = record.size;
+            }
+            slot.scores.resize(count * (size_t) num_models);
+
+            int scored = -1;
+            size_t badpos = 0;
+            oe_result_t result = OE_OK;
+            if (!lanes) {
+                result = ecall_scorebatch(
+                    enclave, &scored, models.id, spans.data(), count,
+                    slot.scores.data(), slot.scores.size(), &badpos);
+            } else {
+                vector<score_task> tasks;
+                for (size_t first = 0; first < count; first += PREDICT_TASK_RECORDS) {
+                    size_t n = min((size_t) PREDICT_TASK_RECORDS, count - first);
+                    size_t bases = 0;
+                    for (size_t r = first; r < first + n; r++) {
+                        bases += spans[r].size;
+                    }
+                    for (size_t g = 0; g < lanes->group_costs.size(); g++) {
+                        score_task task = {g, first, n, lanes->group_costs[g] * (double) bases};
+                        tasks.push_back(task);
+                    }
+                }
+                // the first invalid record of the slot is reported, as a
+                // single ecall would
+                size_t bad_record = count;
+                if (pool_scorer.started()) {
+                    // resident workers write their rows straight into the
+                    // slot; the costliest tasks go first
+                    vector<score_ticket> tickets;
+                    sort(tasks.begin(), tasks.end(),
+                         [](const score_task& a, const score_task& b) { return a.cost > b.cost; });
+                    for (size_t t = 0; t < tasks.size(); t++) {
+                        score_request_t request;
+                        memset(&request, 0, sizeof(request));
+                        request.firstmodel = lanes->groups[tasks[t].group];
+                        request.modelcount = lanes->groups[tasks[t].group + 1] - request.firstmodel;
+                        request.spans = &spans[tasks[t].first];
+                        request.count = tasks[t].count;
+                        request.scores = &slot.scores[tasks[t].first * (size_t) num_models + request.firstmodel];
+                        request.stride = (size_t) num_models;
+                        tickets.push_back(pool_scorer.submit(request));
+                    }
+                    for (size_t t = 0; t < tasks.size(); t++) {
+                        score_completion_t done = pool_scorer.wait(tickets[t]);
+                        if (done.result < 0) {
+                            result = OE_FAILURE;
+                        } else if ((size_t) done.result < tasks[t].count &&
+                                   tasks[t].first + (size_t) done.result < bad_record) {
+                            bad_record = tasks[t].first + (size_t) done.result;
+                            badpos = done.badpos;
+                        }
+                    }
+                } else {
+                    mutex bad_lock;
+                    queues.deal(tasks, tiles.size());
+                    pool_workers.run([&](size_t l) {
+                        vector<float>& tile = tiles[l];
+                        score_task task;
+                        while (queues.next(l, &task)) {
+                            size_t firstmodel = lanes->groups[task.group];
+                            size_t n_models = lanes->groups[task.group + 1] - firstmodel;
+                            int part = -1;
+                            size_t part_badpos = 0;
+                            tile.resize(task.count * n_models);
+                            oe_result_t part_result = ecall_scoremodels(
+                                pool_enclaves[l], &part, lanes->sets[l].id, firstmodel, n_models,
+                                &spans[task.first], task.count, tile.data(), tile.size(), &part_badpos);
+                            if (part_result == OE_OK && part >= 0) {
+                                for (size_t r = 0; r < (size_t) part; r++) {
+                                    memcpy(&slot.scores[(task.first + r) * (size_t) num_models + firstmodel],
+                                           &tile[r * n_models], n_models * sizeof(float));
+                                }
+                            }
+                            if (part_result == OE_OK && part >= 0 && (size_t) part == task.count) {
+                                continue;
+                            }
+                            lock_guard<mutex> lock(bad_lock);
+                            if (part_result != OE_OK || part < 0) {
+                                result = part_result != OE_OK ? part_result : OE_FAILURE;
+                            } else if (task.first + (size_t) part < bad_record) {
+                                bad_record = task.first + (size_t) part;
+                                badpos = part_badpos;
+                            }
+                        }
+                    });
+                }
+                scored = (int) bad_record;
+            }
+            if (result != OE_OK || scored < 0) {
+                cout << "Result from ecall_scorebatch not ok";
+                return 1;
+            }
+            if ((size_t) scored < count) {
+                cout << "Sequence " << lineindex + scored << ", " << badpos << " is not valid.\n";
+                return 1;
+            }
+            lineindex += scored;
+            return 0;
+        },
+        [&](pipeline_slot& slot) {
+            print_slot_rows(out, slot, (size_t) num_models);
+            return 0;
+        });
+
+    if (out.flush() != 0) {
+        cerr << "Host: writing scores failed" << endl;
+        ret = 1;
+    }
+    return ret;
+}
+
+// Rewraps the data key of encrypted_file, encrypted under old_password, for
+// the open session's password. Only the header is rewritten, in place.
+int rekey_file(const char* encrypted_file, const char* old_password)
+{
+    encryption_header_t header;
+    oe_result_t result;
+    int ret = 0;
+    FILE* file = fopen(encrypted_file, "r+b");
+
+    if (!file)
+    {
+        cerr << "Host: fopen " << encrypted_file << " failed." << endl;
+        return 1;
+    }
+    if (fread(&header, 1, sizeof(header), file) != sizeof(header))
+    {
+        cerr << "Host: read header failed." << endl;
+        ret = 1;
+        goto exit;
+    }
+
+    result = ecall_rekey(
+        enclave, &ret, old_password, strlen(old_password), &header);
+    if (result != OE_OK || ret != 0)
+    {
+        cerr << "Host: ecall_rekey failed, is the old password right?" << endl;
+        ret = 1;
+        goto exit;
+    }
+
+    if (fseek(file, 0, SEEK_SET) != 0 ||
+        fwrite(&header, 1, sizeof(header), file) != sizeof(header) ||
+        fflush(file) != 0)
+    {
+        cerr << "Host: rewriting header failed" << endl;
+        ret = 1;
+        goto exit;
+    }
+
+exit:
+    if (fclose(file) != 0)
+        ret = 1;
+    return ret;
+}
+
+void run_encrypt(const char* input_file, const char* encrypted_file) {
+    
+    int ret = 0;
+    // encrypt a file
+    cout << "Host: encrypting file:" << input_file
+         << " -> file:" << encrypted_file << endl;
+    ret = encrypt_file(
+        ENCRYPT_OPERATION, input_file, encrypted_file);
+    if (ret != 0)
+    {
+        cerr << "Host: processFile(ENCRYPT_OPERATION) failed with " << ret
+             << endl;
+        exit(-1);
+    }
+    cout << "Host: encryption was done successfully" << endl;
+}
+
+// Decrypts encrypted_file to output_file, checking the data MAC
+void run_decrypt_file(const char* encrypted_file, const char* output_file) {
+
+    int ret = 0;
+    cout << "Host: decrypting file:" << encrypted_file
+         << " -> file:" << output_file << endl;
+    ret = encrypt_file(DECRYPT_OPERATION, encrypted_file, output_file);
+    if (ret != 0)
+    {
+        cerr << "Host: decrypting " << encrypted_file << " failed" << endl;
+        exit(-1);
+    }
+    cout << "Host: decryption was done successfully" << endl;
+}
+
+// Decrypts encrypted_file in the enclave without writing it anywhere and
+// checks it against the data MAC recorded while it was encrypted
+void run_verify(const char* encrypted_file) {
+
+    int ret = 0;
+    cout << "Host: verifying file:" << encrypted_file << endl;
+    ret = encrypt_file(DECRYPT_OPERATION, encrypted_file, NULL);
+    if (ret != 0)
+    {
+        cerr << "Host: verifying " << encrypted_file << " failed" << endl;
+        exit(-1);
+    }
+    cout << "Host: " << encrypted_file << " verified" << endl;
+}
+
+// Identifies the records and models a checkpoint was taken for: the model
+// ids in order and the --records ranges. Returns non-zero if the model ids
+// cannot be read.
+static int scoring_selection(const model_set& models, size_t* selection)
+{
+    uint64_t hash = 14695981039346656037ull; // FNV-1a
+    vector<size_t> values;
+    values.push_back((size_t)models.count);
+    for (size_t i = 0; i < (size_t)models.count; i++)
+    {
+        model_id_t id = {0, 0};
+        if (ecall_getdbmodelid(enclave, &id, models.id, i) != OE_OK)
+            return 1;
+        values.push_back((size_t)(unsigned int)id.major);
+        values.push_back((size_t)(unsigned int)id.minor);
+    }
+    for (size_t i = 0; i < record_ranges.size(); i++)
+    {
+        values.push_back(record_ranges[i].first);
+        values.push_back(record_ranges[i].count);
+    }
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        for (size_t b = 0; b < sizeof(size_t); b++)
+        {
+            hash ^= (values[i] >> (8 * b)) & 0xff;
+            hash *= 1099511628211ull;
+        }
+    }
+    *selection = (size_t)hash;
+    return 0;
+}
+
+// Starts a sealed score file (see shared.h). The header of the scored file
+// lets the enclave recover the sealing key later; the model ids are public.
+static int write_sealed_scores_header(
+    const encryption_header_t& key,
+    const model_set& models,
+    FILE* file)
+{
+    sealed_scores_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SEALED_SCORES_MAGIC;
+    header.version = SEALED_SCORES_VERSION;
+    header.columns = (unsigned int)models.count;
+    header.key = key;
+    if (fwrite(&header, 1, sizeof(header), file) != sizeof(header))
+        return 1;
+    for (size_t i = 0; i < (size_t)models.count; i++)
+    {
+        model_id_t id = {0, 0};
+        if (ecall_getdbmodelid(enclave, &id, models.id, i) != OE_OK ||
+            fwrite(&id, 1, sizeof(id), file) != sizeof(id))
+            return 1;
+    }
+    return 0;
+}
+
+// Starts a binary score file, reserving room for the rows of the whole file
+// unless --records selects only some of them
+static int start_binary_scores(
+    const encryption_header_t& header,
+    const model_set& models,
+    FILE* file,
+    score_file_writer* binary)
+{
+    vector<model_id_t> ids((size_t)models.count);
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        if (ecall_getdbmodelid(enclave, &ids[i], models.id, i) != OE_OK)
+            return 1;
+    }
+    if (binary->open(file, ids.data(), ids.size(), binary_encoding) != 0)
+        return 1;
+    if (record_ranges.empty())
+        binary->reserve(header.record_count);
+    return 0;
+}
+
+// Opens scores_path for decrypt: either afresh, or on --resume cut back to
+// the rows counted by its checkpoint. Text is written to it through out, or
+// with --binary through binary.
+static FILE* open_score_file(
+    const char* encrypted_file,
+    const model_set& models,
+    const string& checkpoint_path,
+    scoring_checkpoint_t* state,
+    text_writer* out,
+    score_file_writer* binary)
+{
+    encryption_header_t header;
+    FILE* file = fopen(encrypted_file, "rb");
+    size_t selection = 0;
+    bool found = false;
+
+    if (!file || fread(&header, 1, sizeof(header), file) != sizeof(header))
+    {
+        cerr << "Host: read header failed." << endl;
+        if (file)
+            fclose(file);
+        return NULL;
+    }
+    fclose(file);
+
+    if (scoring_selection(models, &selection) != 0)
+    {
+        cerr << "Host: cannot read the model ids for the checkpoint" << endl;
+        return NULL;
+    }
+    if (resume_scoring &&
+        read_checkpoint(checkpoint_path.c_str(), state, &found) != 0)
+    {
+        cerr << "Host: cannot read " << checkpoint_path << endl;
+        return NULL;
+    }
+    if (found)
+    {
+        if (memcmp(state->salt, header.salt, sizeof(header.salt)) != 0 ||
+            state->selection != selection)
+        {
+            cerr << "Host: " << checkpoint_path
+                 << " is for another file, model set or --records" << endl;
+            return NULL;
+        }
+        file = open_truncated(scores_path, state->output_size);
+        if (file && binary_scores && binary->resume(file, state->records) != 0)
+        {
+            fclose(file);
+            file = NULL;
+        }
+        if (!file)
+        {
+            cerr << "Host: cannot resume " << scores_path << endl;
+            return NULL;
+        }
+        cout << "Host: resuming after " << state->records << " records" << endl;
+        out->set_file(file);
+        return file;
+    }
+
+    memset(state, 0, sizeof(*state));
+    memcpy(state->salt, header.salt, sizeof(header.salt));
+    state->selection = selection;
+    file = fopen(scores_path, "wb");
+    if (!file)
+    {
+        cerr << "Host: fopen " << scores_path << " failed." << endl;
+        return NULL;
+    }
+    out->set_file(file);
+    if (binary_scores)
+    {
+        if (start_binary_scores(header, models, file, binary) != 0)
+        {
+            cerr << "Host: fwrite error  " << scores_path << endl;
+            fclose(file);
+            return NULL;
+        }
+    }
+    else if (!seal_scores)
+        printmodelids(models, *out);
+    else if (write_sealed_scores_header(header, models, file) != 0)
+    {
+        cerr << "Host: fwrite error  " << scores_path << endl;
+        fclose(file);
+        return NULL;
+    }
+    return file;
+}
+
+// Score rows are buffered, as text or a binary row group at a time; they are
+// written out before a checkpoint counts them
+static int flush_text_scores(void* out)
+{
+    return ((text_writer*)out)->flush();
+}
+
+static int flush_binary_scores(void* binary)
+{
+    return ((score_file_writer*)binary)->flush();
+}
+
+void run_decrypt(const char* modelfile, const char* encrypted_file) {
+
+    int ret = 0;
+    model_set models = loadmodelids(modelfile);
+    loadmodelparams(models);
+
+    // Decrypt a file
+    cout << "Host: decrypting file:" << encrypted_file << endl;
+
+    if (scores_path) {
+        string checkpoint_path = string(scores_path) + ".checkpoint";
+        scoring_checkpoint_t state;
+        text_writer out(NULL, score_precision);
+        score_file_writer binary;
+        FILE* score_file = open_score_file(encrypted_file, models, checkpoint_path, &state, &out, &binary);
+        if (!score_file) {
+            exit(-1);
+        }
+        checkpoint_writer checkpoint(checkpoint_path, score_file, state);
+        if (binary_scores) {
+            checkpoint.set_flush(flush_binary_scores, &binary);
+        } else {
+            checkpoint.set_flush(flush_text_scores, &out);
+        }
+        score_output output = {
+            binary_scores ? NULL : &out, binary_scores ? &binary : NULL, &checkpoint, seal_scores};
+        ret = decrypt_file_to_enclave(DECRYPT_OPERATION, encrypted_file, models, output);
+        // A failed run keeps what it scored for --resume
+        if (ret != 0 ? checkpoint.save() != 0
+                     : (binary_scores ? binary.finish() : out.flush()) != 0 ||
+                           remove_checkpoint(checkpoint_path.c_str()) != 0) {
+            cerr << "Host: writing " << scores_path << " failed" << endl;
+            ret = 1;
+        }
+        if (fclose(score_file) != 0) {
+            ret = 1;
+        }
+    } else {
+        text_writer out(stdout, score_precision);
+        score_output output = {&out, NULL, NULL, false};
+        printmodelids(models, out);
+        ret = decrypt_file_to_enclave(DECRYPT_OPERATION, encrypted_file, models, output);
+    }
+    if (ret != 0)
+    {
+        cerr << "Host: processFile(DECRYPT_OPERATION) failed with " << ret
+             << endl;
+        exit(-1);
+    }
+    
+}
+
+// Passes the text of a sequence file, decompressed if it is gzip, to consume
+// in pieces and then once more with no text at the end. *compressed tells
+// whether it was. Returns non-zero, having said why, if the file cannot be
+// read or consume fails.
+static int scan_sequence_file(const char* path, bool* compressed,
+                              const function<int(const unsigned char*, size_t)>& consume)
+{
+    mapped_file file;
+    gzip_reader gzip;
+    bool bad_gzip = false;
+    int ret = 0;
+
+    if (file.open(path) != 0) {
+        cerr << "Host: cannot open " << path << endl;
+        return 1;
+    }
+    *compressed = gzip_reader::is_gzip(file.data(), file.size());
+    if (*compressed) {
+        vector<unsigned char> text(stream_chunk_size);
+        size_t n = text.size();
+        bad_gzip = gzip.open(file.data(), file.size(), 0) != 0;
+        while (!bad_gzip && ret == 0 && n == text.size()) {
+            bad_gzip = gzip.read(&text[0], text.size(), &n) != 0;
+            if (!bad_gzip) {
+                ret = consume(&text[0], n);
+            }
+        }
+        if (bad_gzip) {
+            cerr << "Host: " << path << " is not valid gzip data" << endl;
+            return 1;
+        }
+    } else {
+        ret = consume(file.data(), file.size());
+    }
+    if (ret != 0 || consume(NULL, 0) != 0) {
+        cerr << "Host: " << path << " is not valid sequence text" << endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Counts the bases of each record for length_profile
+struct profile_sink
+{
+    length_profile* profile;
+    uint64_t length; // of the current record
+
+    int bases(const unsigned char* data, size_t size) {
+        while (size > 0) {
+            size_t run = seq_find_blank(data, size);
+            length += run;
+            if (run < size) {
+                run++;
+            }
+            data += run;
+            size -= run;
+        }
+        return 0;
+    }
+    int record(uint64_t, const char*) {
+        profile->add(length);
+        length = 0;
+        return 0;
+    }
+};
+
+// The cost model is calibrated by timing up to CALIBRATION_MODELS models,
+// spread over the set, on CALIBRATION_SEQUENCES synthetic sequences of
+// CALIBRATION_LENGTH bases
+#define CALIBRATION_MODELS 8
+#define CALIBRATION_SEQUENCES 4
+#define CALIBRATION_LENGTH 100
+
+// Returns the seconds per unit of model_window_cost(), or 0 if the
+// microbenchmark fails
+static double calibrate_cost(const model_set& models, const vector<deepbind_model_t*>& params)
+{
+    // fixed pseudo-random bases, so that runs can be compared
+    vector<unsigned char> text(CALIBRATION_SEQUENCES * CALIBRATION_LENGTH);
+    vector<seq_span_t> spans(CALIBRATION_SEQUENCES);
+    vector<float> scores(CALIBRATION_SEQUENCES);
+    uint32_t state = 1;
+    size_t picks = min(params.size(), (size_t) CALIBRATION_MODELS);
+    double units = 0;
+
+    synthetic_bases(&text[0], text.size(), &state);
+    for (size_t r = 0; r < spans.size(); r++) {
+        spans[r].data = &text[r * CALIBRATION_LENGTH];
+        spans[r].size = CALIBRATION_LENGTH;
+    }
+    auto start = chrono::steady_clock::now();
+    for (size_t k = 0; k < picks; k++) {
+        size_t i = k * params.size() / picks;
+        int scored = -1;
+        size_t badpos = 0;
+        if (ecall_scoremodels(enclave, &scored, models.id, i, 1, spans.data(), spans.size(),
+                              scores.data(), scores.size(), &badpos) != OE_OK ||
+            scored != (int) spans.size()) {
+            return 0;
+        }
+        units += model_window_cost(*params[i]) * (double) spans.size() *
+                 (double) model_windows(*params[i], CALIBRATION_LENGTH);
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return units > 0 ? seconds / units : 0;
+}
+
+// --estimate: prints the estimated cost of each model per thousand bases
+// and of scoring seqfile with them on lanes threads, without scoring it
+static int print_estimate(const char* seqfile, const model_set& models,
+                          const vector<deepbind_model_t*>& params, size_t lanes)
+{
+    length_profile profile;
+    profile_sink sink = {&profile, 0};
+    seq_text_parser parser;
+    bool compressed = false;
+    double unit = calibrate_cost(models, params);
+    double total = 0;
+    char id[64];
+
+    if (scan_sequence_file(seqfile, &compressed, [&](const unsigned char* text, size_t size) {
+            return text ? parser.parse(text, size, sink) : parser.finish(sink);
+        }) != 0) {
+        return 1;
+    }
+    cout << "model\twindow\tcost_per_window\tseconds_per_kb\tseconds" << endl;
+    for (size_t i = 0; i < params.size(); i++) {
+        double window = model_window_cost(*params[i]);
+        double cost = window * profile.windows(*params[i]);
+        id2str(params[i]->id, id);
+        cout << id << "\t" << model_window_size(*params[i]) << "\t" << window << "\t"
+             << window * 1000 * unit << "\t" << cost * unit << endl;
+        total += cost;
+    }
+    cout << "Host: " << profile.records() << " records, " << profile.bases() << " bases" << endl;
+    cout << "Host: calibrated at " << unit * 1e9 << " ns per cost unit" << endl;
+    cout << "Host: estimated scoring time " << total * unit << " s on one thread, "
+         << total * unit / (double) lanes << " s on " << lanes << endl;
+    return 0;
+}
+
+void run_predict(const char* modelfile, const char* seqfile) {
+     // Parse arguments and store model-ids-file in enclave's deepbind model
+    
+    model_set models = loadmodelids(modelfile);
+    model_id_t modelid;
+    oe_result_t getidresult;
+    vector<deepbind_model_t*> params;
+    lane_plan lanes;
+
+    loadmodelparams(models, &params);
+    if (!pool_enclaves.empty() && plan_lanes(models, params, &lanes) != 0) {
+        exit(-1);
+    }
+    if (estimate_only) {
+        if (print_estimate(seqfile, models, params, max(pool_enclaves.size(), (size_t) 1)) != 0) {
+            exit(-1);
+        }
+        return;
+    }
+    // a --shards worker writes its scores to a file for the coordinator
+    FILE* file = stdout;
+    if (!shard_output.empty()) {
+        file = fopen(shard_output.c_str(), "wb");
+        if (!file) {
+            cerr << "Host: fopen " << shard_output << " failed." << endl;
+            exit(-1);
+        }
+    }
+    text_writer out(file, score_precision);
+    printmodelids(models, out);
+    if (resident_workers) {
+        vector<size_t> modelsets;
+        for (size_t l = 0; l < lanes.sets.size(); l++) {
+            modelsets.push_back(lanes.sets[l].id);
+        }
+        if (pool_scorer.start(pool_workers, pool_enclaves, modelsets) != 0) {
+            cerr << "Host: starting the resident workers failed" << endl;
+            exit(-1);
+        }
+    }
+    // Parse sequences from sequences-file and predict for each in enclave
+    int ret = predictseqs(seqfile, models, out, pool_enclaves.empty() ? NULL : &lanes);
+    if (pool_scorer.stop() != 0) {
+        cerr << "Host: a resident worker failed" << endl;
+        ret = 1;
+    }
+    if (ret != 0) {
+        exit(-1);
+    }
+    if (file != stdout && fclose(file) != 0) {
+        cerr << "Host: writing " << shard_output << " failed" << endl;
+        exit(-1);
+    }
+
+    cout << "Host: Successfully scored sequences!" << endl;
+}
+
+// A shard of a --shards run: the records it scores, the first record of its
+// part of the input and where that lies in an uncompressed sequence file,
+// and the file it writes its scores to
+struct shard_plan
+{
+    vector<record_range> ranges;
+    size_t first;
+    size_t text_offset;
+    string path;
+};
+
+// Counts the records of the decrypt or predict input for --shards. For an
+// uncompressed sequence file, offsets receives the text offset of every
+// SHARD_INDEX_STRIDE-th record.
+static int count_shard_records(const char* input, size_t* records, vector<uint64_t>* offsets)
+{
+    offsets->clear();
+    if (operation.compare("decrypt") == 0) {
+        encryption_header_t header;
+        FILE* file = fopen(input, "rb");
+        size_t n = file ? fread(&header, 1, sizeof(header), file) : 0;
+        if (file) {
+            fclose(file);
+        }
+        if (n != sizeof(header) || header.magic != ENCRYPTION_HEADER_MAGIC) {
+            cerr << "Host: read header failed." << endl;
+            return 1;
+        }
+        // shards reach their records through the record index
+        if (header.flags & ENCRYPTION_FLAG_STREAMED) {
+            cerr << "Host: --shards needs an encrypted file with a record index;"
+                 << " decrypt-file and encrypt it again" << endl;
+            return 1;
+        }
+        *records = header.record_count;
+        return 0;
+    }
+
+    record_indexer indexer(SHARD_INDEX_STRIDE);
+    bool compressed = false;
+    if (scan_sequence_file(input, &compressed, [&](const unsigned char* text, size_t size) {
+            return text ? indexer.add_text(text, size) : indexer.finish_text();
+        }) != 0) {
+        return 1;
+    }
+    // a compressed file is read from its start by every shard
+    if (!compressed) {
+        for (size_t i = 0; i < indexer.entries(); i++) {
+            offsets->push_back(indexer.offset(i));
+        }
+    }
+    *records = (size_t)indexer.records();
+    return 0;
+}
+
+// Splits the records selected by --records, or all total of them, into
+// shard_count consecutive shards of nearly the same number of records. Where
+// offsets are known, shards start at indexed records only.
+static void plan_shards(size_t total, const vector<uint64_t>& offsets, vector<shard_plan>* plans)
+{
+    vector<record_range> selected;
+    vector<size_t> starts;
+    size_t count = 0;
+
+    plans->clear();
+    if (record_ranges.empty()) {
+        record_range all = {0, total};
+        selected.push_back(all);
+    }
+    for (size_t i = 0; i < record_ranges.size() && record_ranges[i].first < total; i++) {
+        record_range range = record_ranges[i];
+        range.count = min(range.count, total - range.first);
+        selected.push_back(range);
+    }
+    for (size_t i = 0; i < selected.size(); i++) {
+        count += selected[i].count;
+    }
+    if (count == 0) {
+        // nothing to split; one worker writes the empty output
+        shard_plan plan = {record_ranges, 0, 0, string()};
+        plans->push_back(plan);
+        return;
+    }
+
+    // shard k starts at selected record count * k / shards
+    size_t shards = min(shard_count, count);
+    size_t range = 0;
+    size_t before = 0; // selected records in the ranges before range
+    for (size_t k = 0; k < shards; k++) {
+        size_t target = count * k / shards;
+        while (before + selected[range].count <= target) {
+            before += selected[range++].count;
+        }
+        size_t start = k == 0 ? 0 : selected[range].first + (target - before);
+        if (!offsets.empty()) {
+            start -= start % SHARD_INDEX_STRIDE;
+        }
+        starts.push_back(start);
+    }
+    starts.push_back(total);
+
+    for (size_t k = 0; k < shards; k++) {
+        shard_plan plan = {vector<record_range>(), starts[k], 0, string()};
+        for (size_t i = 0; i < selected.size(); i++) {
+            size_t first = max(selected[i].first, starts[k]);
+            size_t end = min(selected[i].first + selected[i].count, starts[k + 1]);
+            if (first < end) {
+                record_range part = {first, end - first};
+                plan.ranges.push_back(part);
+            }
+        }
+        if (plan.ranges.empty()) {
+            continue; // starts[k] was moved back to the start of shard k - 1
+        }
+        if (!offsets.empty()) {
+            plan.text_offset = (size_t)offsets[starts[k] / SHARD_INDEX_STRIDE];
+        }
+        plans->push_back(plan);
+    }
+}
+
+// Waits for the shard workers in order, appending the score file of each to
+// dest as it finishes. If one fails, the workers after it are stopped.
+static int merge_shards(const vector<shard_plan>& plans, const vector<long>& pids, FILE* dest)
+{
+    shard_merger binary(dest);
+    for (size_t k = 0; k < plans.size(); k++) {
+        const char* path = plans[k].path.c_str();
+        int ret = wait_shard(pids[k]);
+        if (ret != 0) {
+            cerr << "Host: shard " << k << " failed" << endl;
+        } else if ((binary_scores ? binary.add(path) : merge_text_shard(dest, path, k == 0)) != 0) {
+            cerr << "Host: merging " << path << " failed" << endl;
+            ret = 1;
+        }
+        if (ret != 0) {
+            for (size_t j = k + 1; j < plans.size(); j++) {
+                stop_shard(pids[j]);
+            }
+            return 1;
+        }
+        remove(path);
+    }
+    if ((binary_scores ? binary.finish() : fflush(dest)) != 0) {
+        cerr << "Host: writing scores failed" << endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Runs decrypt or predict with --shards. The records of input are split into
+// consecutive shards and a worker process is forked for each; a worker
+// returns with *worker set to score its shard as an ordinary run would, into
+// a shard file. The coordinator merges the shard files into the output, in
+// input order, as the workers finish.
+static int run_shards(const char* input, bool* worker)
+{
+    vector<uint64_t> offsets;
+    vector<shard_plan> plans;
+    vector<long> pids;
+    string base = scores_path ? scores_path : "";
+    string temp_dir;
+    size_t total = 0;
+    FILE* dest = NULL;
+    int index = 0;
+    int ret = 0;
+
+    *worker = false;
+    if (count_shard_records(input, &total, &offsets) != 0) {
+        return 1;
+    }
+    // scores bound for stdout are staged where no other user can reach them
+    if (!scores_path) {
+        temp_dir = make_temp_dir();
+        if (temp_dir.empty()) {
+            cerr << "Host: cannot create a temporary directory for the shards" << endl;
+            return 1;
+        }
+        base = temp_dir + "/scores";
+    }
+    plan_shards(total, offsets, &plans);
+    for (size_t k = 0; k < plans.size(); k++) {
+        plans[k].path = shard_file(base, k);
+    }
+
+    index = fork_shards(plans.size(), &pids);
+    if (index < 0) {
+        cerr << "Host: cannot start shard workers" << endl;
+        remove_temp_dir(temp_dir);
+        return 1;
+    }
+    if ((size_t)index < plans.size()) {
+        const shard_plan& plan = plans[(size_t)index];
+        record_ranges = plan.ranges;
+        shard_output = plan.path;
+        shard_text_offset = plan.text_offset;
+        shard_first_record = plan.first;
+        if (operation.compare("decrypt") == 0) {
+            scores_path = shard_output.c_str();
+        }
+        // the coordinator may be writing scores to stdout
+        cout.rdbuf(cerr.rdbuf());
+        *worker = true;
+        return 0;
+    }
+
+    cout << "Host: scoring " << total << " records in " << plans.size() << " shards" << endl;
+    dest = scores_path ? fopen(scores_path, "wb") : stdout;
+    if (!dest) {
+        cerr << "Host: fopen " << scores_path << " failed." << endl;
+        for (size_t k = 0; k < pids.size(); k++) {
+            stop_shard(pids[k]);
+        }
+        ret = 1;
+    } else {
+        ret = merge_shards(plans, pids, dest);
+        if (dest != stdout && fclose(dest) != 0) {
+            ret = 1;
+        }
+    }
+    // a failed run leaves nothing to resume from
+    for (size_t k = 0; k < plans.size(); k++) {
+        remove(plans[k].path.c_str());
+        remove((plans[k].path + ".checkpoint").c_str());
+    }
+    remove_temp_dir(temp_dir);
+    if (ret == 0) {
+        cout << "Host: merged " << plans.size() << " shards" << endl;
+    }
+    return ret;
+}
+
+// Outcome of one manifest task, for the summary
+struct task_result
+{
+    size_t bytes;   // size of the input file
+    double seconds;
+    int status;
+};
+
+// Runs one manifest task. Encrypt and decrypt tasks must hold the encryptor
+// lock, as the enclave has a single encryptor.
+static int run_manifest_task(
+    const manifest_task& task,
+    const vector<model_set>& models)
+{
+    int ret = 0;
+    FILE* out = NULL;
+
+    if (task.operation == "encrypt")
+        return encrypt_file(ENCRYPT_OPERATION, task.input.c_str(), task.output.c_str());
+
+    out = fopen(task.output.c_str(), "w");
+    if (!out)
+    {
+        cerr << "Host: fopen " << task.output << " failed." << endl;
+        return 1;
+    }
+    const model_set& set = models[(size_t)task.modelset];
+    text_writer text(out, score_precision);
+    printmodelids(set, text);
+    if (task.operation == "decrypt")
+    {
+        score_output scores = {&text, NULL, NULL, false};
+        ret = decrypt_file_to_enclave(DECRYPT_OPERATION, task.input.c_str(), set, scores);
+    }
+    else
+        ret = predictseqs(task.input.c_str(), set, text);
+    if (fclose(out) != 0)
+        ret = 1;
+    return ret;
+}
+
+// Runs every task of a manifest in this enclave. Model sets are loaded once
+// up front and shared by all tasks. Worker threads pick tasks from two lists:
+// encrypt/decrypt tasks are ordered by password so each password's session is
+// opened once, and run in parallel while they share the open session; predict
+// tasks fill in the other workers, including while the session is switched.
+// A timing summary is printed at the end.
+int run_manifest(const char* manifest_file)
+{
+    manifest job;
+    vector<model_set> models;
+    vector<string> passwords;
+    vector<size_t> encryptor_tasks;
+    vector<size_t> predict_tasks;
+    vector<task_result> results;
+    mutex task_lock;
+    size_t next_encryptor = 0; // guarded by task_lock
+    atomic<size_t> next_predict(0);
+    size_t workers = manifest_workers;
+    vector<thread> threads;
+    int failed = 0;
+
+    if (parse_manifest(manifest_file, &job) != 0)
+        return 1;
+    for (size_t i = 0; i < job.passwords.size(); i++)
+    {
+        string password;
+        if (resolve_password(job.passwords[i], &password) != 0)
+            return 1;
+        passwords.push_back(password);
+    }
+    for (size_t i = 0; i < job.modelsets.size(); i++)
+    {
+        models.push_back(loadmodelids(job.modelsets[i].ids_file.c_str()));
+        loadmodelparams(models.back());
+    }
+
+    for (size_t i = 0; i < job.tasks.size(); i++)
+    {
+        if (job.tasks[i].operation == "predict")
+            predict_tasks.push_back(i);
+        else
+            encryptor_tasks.push_back(i);
+    }
+    stable_sort(
+        encryptor_tasks.begin(),
+        encryptor_tasks.end(),
+        [&](size_t a, size_t b) {
+            return job.tasks[a].password < job.tasks[b].password;
+        });
+    results.resize(job.tasks.size());
+
+    if (workers == 0)
+        workers = thread::hardware_concurrency();
+    if (workers == 0 || workers > MAX_MANIFEST_WORKERS)
+        workers = MAX_MANIFEST_WORKERS;
+    if (workers > job.tasks.size())
+        workers = job.tasks.size();
+    cout << "Host: running " << job.tasks.size() << " tasks on " << workers
+         << " workers" << endl;
+
+    auto run_task = [&](size_t index) {
+        const manifest_task& task = job.tasks[index];
+        task_result& result = results[index];
+        struct stat st;
+        auto start = chrono::steady_clock::now();
+
+        result.bytes = stat(task.input.c_str(), &st) == 0 ? (size_t)st.st_size : 0;
+        result.status = run_manifest_task(task, models);
+        result.seconds =
+            chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    };
+
+    for (size_t w = 0; w < workers; w++)
+    {
+        threads.push_back(thread([&]() {
+            for (;;)
+            {
+                unique_lock<mutex> lock(task_lock);
+                if (next_encryptor < encryptor_tasks.size())
+                {
+                    // Only the claim is made under task_lock; the key is
+                    // derived after it is dropped, so that the other workers
+                    // can go on picking tasks meanwhile
+                    size_t index = encryptor_tasks[next_encryptor];
+                    const string& password = passwords[(size_t)job.tasks[index].password];
+                    bool opener = false;
+                    if (claim_password_session(password, false, &opener) == 0)
+                    {
+                        next_encryptor++;
+                        lock.unlock();
+                        if (ready_password_session(password, opener) != 0)
+                        {
+                            results[index].status = 1;
+                            continue;
+                        }
+                        run_task(index);
+                        release_password_session();
+                        continue;
+                    }
+                }
+                bool encryptor_left = next_encryptor < encryptor_tasks.size();
+                lock.unlock();
+
+                size_t next = next_predict++;
+                if (next < predict_tasks.size())
+                {
+                    run_task(predict_tasks[next]);
+                    continue;
+                }
+                if (!encryptor_left)
+                    return;
+
+                // Only tasks for the next password are left: wait for the
+                // tasks using the current one to finish
+                wait_password_session_idle();
+            }
+        }));
+    }
+    for (size_t w = 0; w < threads.size(); w++)
+        threads[w].join();
+    end_password_session();
+
+    fprintf(stdout, "%-5s %-8s %-40s %12s %9s %9s %s\n", "task", "op", "input", "bytes", "seconds", "MB/s", "status");
+    for (size_t i = 0; i < job.tasks.size(); i++)
+    {
+        const task_result& result = results[i];
+        double rate = result.seconds > 0 ? result.bytes / result.seconds / 1e6 : 0;
+        fprintf(
+            stdout,
+            "%-5zu %-8s %-40s %12zu %9.3f %9.1f %s\n",
+            i + 1,
+            job.tasks[i].operation.c_str(),
+            job.tasks[i].input.c_str(),
+            result.bytes,
+            result.seconds,
+            rate,
+            result.status == 0 ? "ok" : "FAILED");
+        if (result.status != 0)
+            failed++;
+    }
+    cout << "Host: " << job.tasks.size() - failed << " of " << job.tasks.size()
+         << " tasks succeeded" << endl;
+    return failed ? 1 : 0;
+}
+
+// Model set preloaded by serve for all of its requests
+static model_set served_models;
+
+// Scores each non-empty line of seqs with one ecall, appending a row of
+// scores per line
+static int serve_score(
+    const char* seqs,
+    size_t size,
+    vector<float>* scores,
+    size_t* rows,
+    string* message)
+{
+    size_t modelcount = (size_t)served_models.count;
+    size_t pos = 0;
+
+    *rows = 0;
+    while (pos < size)
+    {
+        const char* line = seqs + pos;
+        const char* end = (const char*)memchr(line, '\n', size - pos);
+        size_t seqlen = end ? (size_t)(end - line) : size - pos;
+        pos += seqlen + 1;
+        if (seqlen > 0 && line[seqlen - 1] == '\r')
+            seqlen--;
+        if (seqlen == 0)
+            continue;
+
+        int count = 0;
+        scores->resize(scores->size() + modelcount);
+        oe_result_t result = ecall_scoreseq(
+            enclave,
+            &count,
+            served_models.id,
+            (const unsigned char*)line,
+            seqlen,
+            scores->data() + scores->size() - modelcount,
+            modelcount);
+        if (result != OE_OK || count != (int)modelcount)
+        {
+            *message = "sequence " + to_string(*rows + 1) + " is not valid";
+            return 1;
+        }
+        (*rows)++;
+    }
+    return 0;
+}
+
+// Encrypts input, or decrypts it and writes the scores of its records to
+// output, under the session for password
+static int serve_file(
+    bool encrypt,
+    const string& password,
+    const string& input,
+    const string& output,
+    string* message)
+{
+    int ret = 0;
+    FILE* out = NULL;
+
+    // "-" would be the daemon's own stdin or stdout
+    if (input == "-" || output == "-")
+    {
+        *message = "files must be named";
+        return 1;
+    }
+    if (password.empty() || acquire_password_session(password, true) != 0)
+    {
+        *message = "cannot open a session for the password";
+        return 1;
+    }
+    if (encrypt)
+    {
+        ret = encrypt_file(ENCRYPT_OPERATION, input.c_str(), output.c_str());
+    }
+    else
+    {
+        out = fopen(output.c_str(), "w");
+        if (out)
+        {
+            text_writer text(out, score_precision);
+            score_output scores = {&text, NULL, NULL, false};
+            printmodelids(served_models, text);
+            ret = decrypt_file_to_enclave(DECRYPT_OPERATION, input.c_str(), served_models, scores);
+            if (fclose(out) != 0)
+                ret = 1;
+        }
+        else
+        {
+            ret = 1;
+        }
+    }
+    release_password_session();
+    if (ret != 0)
+        *message = (encrypt ? "encrypting " : "decrypting ") + input + " failed";
+    return ret;
+}
+
+// Loads the model set once and serves requests on socket_path until stopped
+int run_serve(const char* modelfile, const char* socket_path)
+{
+    daemon_handlers handlers;
+    size_t slots = manifest_workers;
+    int ret = 0;
+
+    served_models = loadmodelids(modelfile);
+    loadmodelparams(served_models);
+    handlers.modelcount = (size_t)served_models.count;
+    handlers.score = serve_score;
+    handlers.process_file = serve_file;
+
+    if (slots == 0)
+        slots = thread::hardware_concurrency();
+    if (slots == 0 || slots > MAX_MANIFEST_WORKERS)
+        slots = MAX_MANIFEST_WORKERS;
+
+    ret = run_daemon(socket_path, handlers, slots);
+    end_password_session();
+    return ret;
+}
+
+// bench: model shapes of the microbenchmarks, the commonest among the
+// models in data/params and the largest, the sequence lengths they are
+// timed on, and the chunk sizes encrypt_block is timed with
+static const bench_shape bench_shapes[] = {
+    {1, 16, 20, 0, 0},
+    {1, 16, 20, 0, 32},
+    {0, 16, 16, 1, 32},
+    {1, 16, 24, 1, 0},
+    {1, 16, 36, 0, 32},
+};
+static const size_t bench_lengths[] = {24, 40, 100, 400, 1000};
+static const size_t bench_chunk_sizes[] = {
+    4 * 1024, 64 * 1024, 1024 * 1024, DEFAULT_STREAM_CHUNK_SIZE, MAX_STREAM_CHUNK_SIZE};
+#define BENCH_COUNT(array) (sizeof(array) / sizeof(array[0]))
+#define BENCH_SEED 1
+#define BENCH_E2E_REPEATS 3 // end-to-end runs are long enough on their own
+
+// Makes one ecall_benchmark call of iterations; returns non-zero on failure
+static int bench_ecall(int kind, size_t modelset, size_t modelindex,
+                       const unsigned char* seq, size_t seqlen, uint64_t iterations)
+{
+    int status = -1;
+    oe_result_t result = ecall_benchmark(
+        enclave, &status, kind, modelset, modelindex, seq, seqlen, (size_t) iterations);
+    return result == OE_OK && status == 0 ? 0 : 1;
+}
+
+// The cost of a transition each way: an empty ecall from the host, and an
+// empty ocall from inside one ecall
+static int bench_transitions(bench_report& report)
+{
+    const unsigned char base = 'A';
+    bench_result result;
+
+    cout << "Host: timing ecalls and ocalls" << endl;
+    if (bench_measure([&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                if (bench_ecall(BENCH_ECALL, 0, 0, &base, 1, 0) != 0) {
+                    return 1;
+                }
+            }
+            return 0;
+        }, BENCH_MIN_SECONDS, BENCH_REPEATS, &result) != 0) {
+        return 1;
+    }
+    report.add("ecall", result, 0);
+    if (bench_measure([&](uint64_t n) { return bench_ecall(BENCH_OCALL, 0, 0, &base, 1, n); },
+                      BENCH_MIN_SECONDS, BENCH_REPEATS, &result) != 0) {
+        return 1;
+    }
+    report.add("ocall", result, 0);
+    return 0;
+}
+
+// deepbind::apply_model on one window of each length and scan_model over
+// sequences of each length, for synthetic models of each shape, looping
+// inside the enclave
+static int bench_models(bench_report& report)
+{
+    vector<deepbind_model_t*> params;
+    vector<unsigned char> seq(bench_lengths[BENCH_COUNT(bench_lengths) - 1]);
+    uint32_t state = BENCH_SEED;
+    model_set set;
+    bench_result result;
+    int ret = 0;
+
+    for (size_t s = 0; s < BENCH_COUNT(bench_shapes); s++) {
+        params.push_back(synthetic_model(bench_shapes[s], (uint32_t) (BENCH_SEED + s)));
+    }
+    synthetic_bases(&seq[0], seq.size(), &state);
+    cout << "Host: timing apply_model and scan_model" << endl;
+    if (pushmodels(enclave, params, &set) != 0) {
+        ret = 1;
+    }
+    for (size_t s = 0; s < params.size() && ret == 0; s++) {
+        for (size_t l = 0; l < BENCH_COUNT(bench_lengths) && ret == 0; l++) {
+            size_t length = bench_lengths[l];
+            for (int kind = BENCH_APPLY_MODEL; kind <= BENCH_SCAN_MODEL && ret == 0; kind++) {
+                ret = bench_measure([&](uint64_t n) { return bench_ecall(kind, set.id, s, &seq[0], length, n); },
+                                    BENCH_MIN_SECONDS, BENCH_REPEATS, &result);
+                if (ret != 0) {
+                    break;
+                }
+                report.param("shape", shape_name(bench_shapes[s]));
+                report.param("length", (double) length);
+                if (kind == BENCH_SCAN_MODEL) {
+                    report.param("windows", (double) model_windows(*params[s], length));
+                }
+                report.add(kind == BENCH_APPLY_MODEL ? "apply_model" : "scan_model", result, 0);
+            }
+        }
+    }
+    for (size_t s = 0; s < params.size(); s++) {
+        free_model(params[s]);
+    }
+    return ret;
+}
+
+// encrypt_block each way over chunks of each size, under the open session
+static int bench_crypto(bench_report& report)
+{
+    vector<unsigned char> in(MAX_STREAM_CHUNK_SIZE);
+    vector<unsigned char> out(MAX_STREAM_CHUNK_SIZE);
+    encryption_header_t header;
+    uint32_t state = BENCH_SEED;
+    bench_result result;
+
+    synthetic_bases(&in[0], in.size(), &state);
+    memset(&header, 0, sizeof(header));
+    cout << "Host: timing encrypt_block" << endl;
+    // decrypting takes the header the encryptor filled in
+    for (int encrypt = 1; encrypt >= 0; encrypt--) {
+        size_t session = 0;
+        int status = -1;
+        int ret = 0;
+        if (initialize_encryptor(enclave, &status, encrypt != 0, &header, &session) != OE_OK ||
+            status != 0) {
+            return 1;
+        }
+        for (size_t c = 0; c < BENCH_COUNT(bench_chunk_sizes) && ret == 0; c++) {
+            size_t size = bench_chunk_sizes[c];
+            ret = bench_measure([&](uint64_t n) {
+                for (uint64_t i = 0; i < n; i++) {
+                    int block = -1;
+                    if (encrypt_block(enclave, &block, session, encrypt != 0, &in[0], &out[0], size) != OE_OK ||
+                        block != 0) {
+                        return 1;
+                    }
+                }
+                return 0;
+            }, BENCH_MIN_SECONDS, BENCH_REPEATS, &result);
+            if (ret == 0) {
+                report.param("direction", encrypt ? "encrypt" : "decrypt");
+                report.param("chunk_size", (double) size);
+                report.add("encrypt_block", result, (double) size);
+            }
+        }
+        close_encryptor(enclave, session);
+        if (ret != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// load_model parsing the parameter files of the models in params, one model
+// per iteration
+static int bench_loading(bench_report& report, const char* modelfile,
+                         const vector<deepbind_model_t*>& params)
+{
+    bench_result result;
+
+    if (params.empty()) {
+        return 0;
+    }
+    cout << "Host: timing load_model" << endl;
+    if (bench_measure([&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                free_model(load_model(params[(size_t) (i % params.size())]->id));
+            }
+            return 0;
+        }, BENCH_MIN_SECONDS, BENCH_REPEATS, &result) != 0) {
+        return 1;
+    }
+    report.param("models_file", modelfile);
+    report.param("models", (double) params.size());
+    report.add("load_model", result, 0);
+    return 0;
+}
+
+// Whole operations: predict and decrypt with scoring of seqfile with the
+// models, then encrypt and decrypt-file of a synthetic file of bench_size
+// bytes. Scores and the decrypted file go to the null device, and the files
+// in between to a temporary directory.
+static int bench_end_to_end(bench_report& report, const char* modelfile, const char* seqfile,
+                            const model_set& models)
+{
+    string temp_dir;
+    string encrypted_input;
+    string synthetic;
+    string encrypted;
+    FILE* null_file = fopen(BENCH_NULL_DEVICE, "wb");
+    length_profile profile;
+    profile_sink sink = {&profile, 0};
+    seq_text_parser parser;
+    bool compressed = false;
+    struct stat st;
+    bench_result result;
+    int ret = 0;
+
+    if (!null_file) {
+        cerr << "Host: fopen " << BENCH_NULL_DEVICE << " failed." << endl;
+        return 1;
+    }
+    text_writer out(null_file, score_precision);
+    score_output output = {&out, NULL, NULL, false};
+    if (scan_sequence_file(seqfile, &compressed, [&](const unsigned char* text, size_t size) {
+            return text ? parser.parse(text, size, sink) : parser.finish(sink);
+        }) != 0 || stat(seqfile, &st) != 0) {
+        fclose(null_file);
+        return 1;
+    }
+    // one of them is seqfile encrypted, which no other user may read
+    temp_dir = make_temp_dir();
+    if (temp_dir.empty()) {
+        cerr << "Host: cannot create a temporary directory for the bench" << endl;
+        fclose(null_file);
+        return 1;
+    }
+    encrypted_input = temp_dir + "/input.encrypted";
+    synthetic = temp_dir + "/synthetic.seq";
+    encrypted = temp_dir + "/synthetic.encrypted";
+
+    cout << "Host: timing predict and decrypt of " << seqfile << endl;
+    ret = bench_measure([&](uint64_t) { return predictseqs(seqfile, models, out); },
+                        0, BENCH_E2E_REPEATS, &result);
+    if (ret == 0) {
+        report.param("models_file", modelfile);
+        report.param("sequence_file", seqfile);
+        report.param("models", (double) models.count);
+        report.param("records", (double) profile.records());
+        report.param("bases", (double) profile.bases());
+        report.add("predict", result, (double) st.st_size);
+        ret = encrypt_file(ENCRYPT_OPERATION, seqfile, encrypted_input.c_str());
+    }
+    if (ret == 0) {
+        ret = bench_measure([&](uint64_t) {
+            return decrypt_file_to_enclave(DECRYPT_OPERATION, encrypted_input.c_str(), models, output);
+        }, 0, BENCH_E2E_REPEATS, &result);
+    }
+    if (ret == 0) {
+        report.param("models_file", modelfile);
+        report.param("sequence_file", seqfile);
+        report.param("models", (double) models.count);
+        report.param("records", (double) profile.records());
+        report.add("decrypt", result, (double) st.st_size);
+
+        cout << "Host: writing " << bench_size << " bytes of synthetic sequences to " << synthetic << endl;
+        ret = write_synthetic_sequences(synthetic.c_str(), bench_size, BENCH_SEED) != 0 ||
+              stat(synthetic.c_str(), &st) != 0;
+    }
+    if (ret == 0) {
+        cout << "Host: timing encrypt and decrypt-file of " << synthetic << endl;
+        ret = bench_measure([&](uint64_t) {
+            return encrypt_file(ENCRYPT_OPERATION, synthetic.c_str(), encrypted.c_str());
+        }, 0, BENCH_E2E_REPEATS, &result);
+    }
+    if (ret == 0) {
+        report.param("size", (double) st.st_size);
+        report.param("chunk_size", (double) stream_chunk_size);
+        report.param("packed", pack_sequences ? "yes" : "no");
+        report.add("encrypt", result, (double) st.st_size);
+        ret = bench_measure([&](uint64_t) {
+            return encrypt_file(DECRYPT_OPERATION, encrypted.c_str(), BENCH_NULL_DEVICE);
+        }, 0, BENCH_E2E_REPEATS, &result);
+    }
+    if (ret == 0) {
+        report.param("size", (double) st.st_size);
+        report.param("chunk_size", (double) stream_chunk_size);
+        report.add("decrypt-file", result, (double) st.st_size);
+    }
+    if (out.flush() != 0) {
+        ret = 1;
+    }
+    fclose(null_file);
+    remove_temp_dir(temp_dir);
+    return ret;
+}
+
+// bench: times the scoring, crypto and loading hot paths in isolation, then
+// whole runs on seqfile and on synthetic data, and writes the results as
+// JSON (see bench.h) to stdout or --json
+int run_bench(const char* modelfile, const char* seqfile, bool simulated)
+{
+    bench_report report;
+    vector<deepbind_model_t*> params;
+    model_set models;
+    FILE* file = stdout;
+    int ret = 0;
+
+    report.context("mode", simulated ? "simulation" : "hardware");
+    report.context("threads", (double) thread::hardware_concurrency());
+    report.context("chunk_size", (double) stream_chunk_size);
+    report.context("kdf_iterations", (double) kdf_iterations);
+    report.context("bench_size", (double) bench_size);
+
+    if (bench_transitions(report) != 0 || bench_models(report) != 0) {
+        cerr << "Host: bench of the enclave calls failed" << endl;
+        return 1;
+    }
+    if (open_password_session("bench") != 0) {
+        return 1;
+    }
+    models = loadmodelids(modelfile);
+    loadmodelparams(models, &params);
+    if (bench_crypto(report) != 0 || bench_loading(report, modelfile, params) != 0 ||
+        bench_end_to_end(report, modelfile, seqfile, models) != 0) {
+        cerr << "Host: bench failed" << endl;
+        ret = 1;
+    }
+    close_session(enclave);
+    for (size_t i = 0; i < params.size(); i++) {
+        free_model(params[i]);
+    }
+    if (ret != 0) {
+        return ret;
+    }
+
+    if (bench_json_path && !(file = fopen(bench_json_path, "wb"))) {
+        cerr << "Host: fopen " << bench_json_path << " failed." << endl;
+        return 1;
+    }
+    if (report.write(file) != 0 || (file != stdout && fclose(file) != 0)) {
+        cerr << "Host: writing the bench report failed" << endl;
+        return 1;
+    }
+    cout << "Host: bench done" << endl;
+    return 0;
+}
+
+int main(int argc, const char* argv[])
+{
+    oe_result_t result;
+    int ret = 0;
+     
+    uint32_t flags = OE_ENCLAVE_FLAG_DEBUG;
+
+    if (check_simulate_opt(&argc, argv))
+    {
+        flags |= OE_ENCLAVE_FLAG_SIMULATE;
+    }
+    check_chunk_size_opt(&argc, argv);
+    pack_sequences = check_flag_opt(&argc, argv, "--packed");
+    verify_after_encrypt = check_flag_opt(&argc, argv, "--verify");
+    check_records_opt(&argc, argv);
+    check_kdf_iterations_opt(&argc, argv);
+    check_workers_opt(&argc, argv);
+    check_scores_opt(&argc, argv);
+    check_shards_opt(&argc, argv);
+    check_enclaves_opt(&argc, argv);
+    estimate_only = check_flag_opt(&argc, argv, "--estimate");
+    resident_workers = check_flag_opt(&argc, argv, "--resident");
+    resume_scoring = check_flag_opt(&argc, argv, "--resume");
+    seal_scores = check_flag_opt(&argc, argv, "--sealed");
+    check_binary_opt(&argc, argv);
+    check_precision_opt(&argc, argv);
+    check_bench_size_opt(&argc, argv);
+    check_json_opt(&argc, argv);
+    if (seal_scores && !scores_path) {
+        cerr << "Host: --sealed needs --scores=<file>" << endl;
+        exit(-1);
+    }
+    if (binary_scores && seal_scores) {
+        cerr << "Host: sealed scores can be made binary with unseal --binary" << endl;
+        exit(-1);
+    }
+    if (shard_count > 1 && (seal_scores || resume_scoring)) {
+        cerr << "Host: --shards cannot be combined with --sealed or --resume" << endl;
+        exit(-1);
+    }
+
+    // Data written to stdout must not be mixed with host messages
+    if (argc > 3 && strcmp(argv[3], "-") == 0 &&
+        (strcmp(argv[1], "encrypt") == 0 || strcmp(argv[1], "decrypt-file") == 0 ||
+         strcmp(argv[1], "unseal") == 0))
+    {
+        cout.rdbuf(cerr.rdbuf());
+    }
+    if (argc > 1 && strcmp(argv[1], "bench") == 0 && !bench_json_path)
+    {
+        cout.rdbuf(cerr.rdbuf());
+    }
+
+    // Check arguments from command line
+    cout << "Host: enter main" << endl;
+    if (argc < 2) {
+        printusage(argv[0]);
+    }
+    operation = string(argv[1]);
+    
+    if (operation.compare("decrypt") == 0 || operation.compare("encrypt") == 0 ||
+        operation.compare("decrypt-file") == 0 || operation.compare("rekey") == 0 ||
+        operation.compare("unseal") == 0) {
+        if (argc != 6) {
+            printusage(argv[0]);
+        }
+    } else if (operation.compare("predict") == 0 || operation.compare("bench") == 0) {
+        if (argc != 5) {
+            printusage(argv[0]);
+        }
+    } else if (operation.compare("serve") == 0) {
+        if (argc != 5) {
+            printusage(argv[0]);
+        }
+    } else if (operation.compare("run-manifest") == 0) {
+        if (argc != 4) {
+            printusage(argv[0]);
+        }
+    } else {
+        printusage(argv[0]);
+    }
+
+    // used for encryption:
+    const char* input_file = argv[2]; // example.seq
+    const char* output_file = argv[3]; // example.seq.encrypted
+    // used for decryption:
+    const char* model_file = argv[2]; // example.ids
+    const char* encrypted_file = argv[3]; // example.seq.encrypted
+    //used for model prediction:
+    const char* modelfile = argv[2]; // example.ids
+    const char* seqfile = argv[3]; // example.seq
+    // used for run-manifest:
+    const char* manifest_file = argv[2];
+    // used for serve:
+    const char* socket_path = argv[3];
+    // used for rekey:
+    const char* rekey_file_name = argv[2];
+    const char* enclave_image = argc == 4 || operation.compare("rekey") == 0 ? argv[3] : argv[4];
+
+    // With --shards, worker processes go on from here with a shard each
+    // while this one merges their scores
+    if (shard_count > 1) {
+        bool worker = false;
+        if (operation.compare("decrypt") != 0 && operation.compare("predict") != 0) {
+            cerr << "Host: --shards applies to decrypt and predict" << endl;
+            exit(-1);
+        }
+        ret = run_shards(argv[3], &worker);
+        if (!worker) {
+            return ret;
+        }
+    }
+
+    cout << "Host: create enclave for image:" << enclave_image << endl;
+    if ((enclave_count > 1 || estimate_only || resident_workers) && operation.compare("predict") != 0)
+    {
+        cerr << "Host: --enclaves, --estimate and --resident apply to predict" << endl;
+        exit(-1);
+    }
+    // predict --workers: threads scoring model groups in each enclave
+    if (enclave_count > 1 || resident_workers ||
+        (operation.compare("predict") == 0 && manifest_workers > 1))
+    {
+        if (start_enclave_pool(enclave_image, flags, max(manifest_workers, (size_t)1)) != 0)
+        {
+            stop_enclave_pool();
+            exit(-1);
+        }
+    }
+    else
+    {
+        result = oe_create_fileencryptor_enclave(
+            enclave_image, OE_ENCLAVE_TYPE_SGX, flags, NULL, 0, &enclave);
+        if (result != OE_OK)
+        {
+            cerr << "oe_create_fileencryptor_enclave() failed with " << argv[0]
+                 << " " << result << endl;
+            ret = 1;
+            goto exit;
+        }
+    }
+    
+    if (operation.compare("encrypt") == 0) {
+        if (verify_after_encrypt && strcmp(output_file, "-") == 0) {
+            cerr << "Host: --verify needs a dest-file to read back" << endl;
+            exit(-1);
+        }
+        // one session serves both files, so the password key is derived once
+        if (open_password_session(argv[5]) != 0) {
+            exit(-1);
+        }
+        run_encrypt(input_file, output_file);
+        if (verify_after_encrypt) {
+            run_verify(output_file);
+        }
+        close_session(enclave);
+        return 0;
+    }
+
+    if (operation.compare("decrypt") == 0) {
+        if (open_password_session(argv[5]) != 0) {
+            exit(-1);
+        }
+        run_decrypt(model_file, encrypted_file);
+        close_session(enclave);
+        return 0;
+    }
+
+    if (operation.compare("decrypt-file") == 0) {
+        if (open_password_session(argv[5]) != 0) {
+            exit(-1);
+        }
+        run_decrypt_file(input_file, output_file);
+        close_session(enclave);
+        return 0;
+    }
+
+    if (operation.compare("unseal") == 0) {
+        if (open_password_session(argv[5]) != 0) {
+            exit(-1);
+        }
+        cout << "Host: unsealing scores:" << input_file << endl;
+        ret = unseal_scores(input_file, output_file);
+        close_session(enclave);
+        goto exit;
+    }
+
+    if (operation.compare("rekey") == 0) {
+        // the session is opened for the new password, so the new password
+        // key is derived once
+        if (open_password_session(argv[5]) != 0) {
+            exit(-1);
+        }
+        cout << "Host: rekeying file:" << rekey_file_name << endl;
+        ret = rekey_file(rekey_file_name, argv[4]);
+        close_session(enclave);
+        if (ret == 0) {
+            cout << "Host: rekeyed " << rekey_file_name << endl;
+        }
+        goto exit;
+    }
+
+    if (operation.compare("predict") == 0) {
+        run_predict(modelfile, seqfile);
+        stop_enclave_pool();
+        return 0;
+    }
+
+    if (operation.compare("run-manifest") == 0) {
+        ret = run_manifest(manifest_file);
+        goto exit;
+    }
+
+    if (operation.compare("bench") == 0) {
+        ret = run_bench(modelfile, seqfile, (flags & OE_ENCLAVE_FLAG_SIMULATE) != 0);
+        goto exit;
+    }
+
+    if (operation.compare("serve") == 0) {
+        ret = run_serve(modelfile, socket_path);
+        goto exit;
+    }
+
+exit:
+    cout << "Host: terminate the enclave" << endl;
+    cout << "Host: Sample completed successfully." << endl;
+    oe_terminate_enclave(enclave);
+    return ret;
+}
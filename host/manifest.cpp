@@ -0,0 +1,157 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#define _CRT_SECURE_NO_WARNINGS
+#include "manifest.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sstream>
+
+using namespace std;
+
+template <typename T>
+static int find_name(const vector<T>& items, const string& name)
+{
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        if (items[i].name == name)
+            return (int)i;
+    }
+    return -1;
+}
+
+static int manifest_error(const char* path, int line, const char* msg)
+{
+    fprintf(stderr, "Host: %s:%d: %s\n", path, line, msg);
+    return 1;
+}
+
+int parse_manifest(const char* path, manifest* out)
+{
+    char buffer[4096];
+    int line = 0;
+    int ret = 0;
+    FILE* file = fopen(path, "r");
+
+    if (!file)
+    {
+        fprintf(stderr, "Host: cannot open manifest %s\n", path);
+        return 1;
+    }
+
+    while (ret == 0 && fgets(buffer, sizeof(buffer), file))
+    {
+        vector<string> fields;
+        string field;
+
+        line++;
+        buffer[strcspn(buffer, "#")] = '\0';
+        istringstream words(buffer);
+        while (words >> field)
+            fields.push_back(field);
+        if (fields.empty())
+            continue;
+
+        if (fields[0] == "modelset" || fields[0] == "password")
+        {
+            if (fields.size() != 3)
+            {
+                ret = manifest_error(path, line, "expected <kind> <name> <value>");
+            }
+            else if (fields[0] == "modelset")
+            {
+                manifest_modelset set = {fields[1], fields[2]};
+                if (find_name(out->modelsets, set.name) >= 0)
+                    ret = manifest_error(path, line, "model set declared twice");
+                out->modelsets.push_back(set);
+            }
+            else
+            {
+                manifest_password password = {fields[1], fields[2]};
+                if (find_name(out->passwords, password.name) >= 0)
+                    ret = manifest_error(path, line, "password declared twice");
+                else if (
+                    password.source.compare(0, 4, "env:") != 0 &&
+                    password.source.compare(0, 5, "file:") != 0)
+                    ret = manifest_error(
+                        path, line, "password must be env:<var> or file:<path>");
+                out->passwords.push_back(password);
+            }
+            continue;
+        }
+
+        if (fields[0] != "encrypt" && fields[0] != "decrypt" &&
+            fields[0] != "predict")
+        {
+            ret = manifest_error(path, line, "unknown operation");
+            continue;
+        }
+        if (fields.size() != 5)
+        {
+            ret = manifest_error(
+                path,
+                line,
+                "expected <operation> <input> <output> <model-set> "
+                "<password-ref>");
+            continue;
+        }
+
+        manifest_task task;
+        task.operation = fields[0];
+        task.input = fields[1];
+        task.output = fields[2];
+        task.modelset = find_name(out->modelsets, fields[3]);
+        task.password = find_name(out->passwords, fields[4]);
+
+        bool needs_models = task.operation != "encrypt";
+        bool needs_password = task.operation != "predict";
+        if (needs_models && task.modelset < 0)
+            ret = manifest_error(path, line, "unknown model set");
+        else if (needs_password && task.password < 0)
+            ret = manifest_error(path, line, "unknown password");
+        out->tasks.push_back(task);
+    }
+
+    fclose(file);
+    return ret;
+}
+
+int resolve_password(const manifest_password& password, string* out)
+{
+    if (password.source.compare(0, 4, "env:") == 0)
+    {
+        const char* value = getenv(password.source.c_str() + 4);
+        if (!value)
+        {
+            fprintf(
+                stderr,
+                "Host: password %s: %s is not set\n",
+                password.name.c_str(),
+                password.source.c_str() + 4);
+            return 1;
+        }
+        *out = value;
+        return 0;
+    }
+
+    // file:<path>, the password being the first line
+    char buffer[1024];
+    FILE* file = fopen(password.source.c_str() + 5, "r");
+    if (!file || !fgets(buffer, sizeof(buffer), file))
+    {
+        if (file)
+            fclose(file);
+        fprintf(
+            stderr,
+            "Host: password %s: cannot read %s\n",
+            password.name.c_str(),
+            password.source.c_str() + 5);
+        return 1;
+    }
+    fclose(file);
+    buffer[strcspn(buffer, "\r\n")] = '\0';
+    *out = buffer;
+    return 0;
+}
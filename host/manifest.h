@@ -0,0 +1,56 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+// A job manifest lists many tasks to run in one enclave. Text from '#' to the
+// end of a line is a comment and blank lines are ignored; every other line is
+// one of
+//
+//   modelset <name> <ids-file>
+//   password <name> env:<variable> | file:<path>
+//   <operation> <input> <output> <model-set> <password-ref>
+//
+// where operation is encrypt, decrypt or predict. Tasks name the model sets
+// and passwords declared in the manifest, or '-' where the operation needs
+// none: encrypt takes a password, predict a model set, decrypt both.
+
+struct manifest_modelset
+{
+    std::string name;
+    std::string ids_file;
+};
+
+struct manifest_password
+{
+    std::string name;
+    std::string source; // env:<variable> or file:<path>
+};
+
+struct manifest_task
+{
+    std::string operation;
+    std::string input;
+    std::string output;
+    int modelset; // index into manifest::modelsets, or -1
+    int password; // index into manifest::passwords, or -1
+};
+
+struct manifest
+{
+    std::vector<manifest_modelset> modelsets;
+    std::vector<manifest_password> passwords;
+    std::vector<manifest_task> tasks;
+};
+
+// Reads and checks the manifest at path. Returns 0, or 1 after reporting the
+// first error on stderr.
+int parse_manifest(const char* path, manifest* out);
+
+// Resolves a password source to the password. Returns 0, or 1 if the
+// variable is unset or the file cannot be read.
+int resolve_password(const manifest_password& password, std::string* out);
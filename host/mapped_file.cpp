@@ -0,0 +1,99 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#define _CRT_SECURE_NO_WARNINGS
+#include "mapped_file.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+mapped_file::mapped_file() : m_data(NULL), m_size(0), m_mapped(false)
+{
+}
+
+mapped_file::~mapped_file()
+{
+    close();
+}
+
+int mapped_file::open(const char* path)
+{
+    close();
+#ifndef _WIN32
+    int fd = ::open(path, O_RDONLY);
+    struct stat st;
+    void* addr = NULL;
+
+    if (fd < 0)
+        return 1;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return 1;
+    }
+    m_size = (size_t)st.st_size;
+    if (m_size > 0)
+    {
+        addr = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED)
+        {
+            ::close(fd);
+            m_size = 0;
+            return 1;
+        }
+        // Chunks are consumed front to back, so ask for aggressive readahead
+        madvise(addr, m_size, MADV_SEQUENTIAL);
+        m_data = (unsigned char*)addr;
+        m_mapped = true;
+    }
+    // The mapping stays valid after the descriptor is closed
+    ::close(fd);
+    return 0;
+#else
+    FILE* file = fopen(path, "rb");
+    struct stat st;
+
+    if (!file)
+        return 1;
+    if (stat(path, &st) != 0)
+    {
+        fclose(file);
+        return 1;
+    }
+    m_size = (size_t)st.st_size;
+    if (m_size > 0)
+    {
+        m_data = (unsigned char*)malloc(m_size);
+        if (m_data == NULL || fread(m_data, 1, m_size, file) != m_size)
+        {
+            fclose(file);
+            close();
+            return 1;
+        }
+    }
+    fclose(file);
+    return 0;
+#endif
+}
+
+void mapped_file::close()
+{
+#ifndef _WIN32
+    if (m_mapped)
+        munmap(m_data, m_size);
+    else
+        free(m_data);
+#else
+    free(m_data);
+#endif
+    m_data = NULL;
+    m_size = 0;
+    m_mapped = false;
+}
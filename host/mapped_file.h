@@ -0,0 +1,35 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <stddef.h>
+
+// mapped_file gives read-only access to the whole of an input file so that
+// chunks of it can be handed to the enclave without an intermediate copy.
+// On POSIX hosts the file is mmap'd; elsewhere it is read into a heap buffer.
+class mapped_file
+{
+  private:
+    unsigned char* m_data;
+    size_t m_size;
+    bool m_mapped;
+
+  public:
+    mapped_file();
+    ~mapped_file();
+    int open(const char* path);
+    void close();
+    const unsigned char* data() const
+    {
+        return m_data;
+    }
+    size_t size() const
+    {
+        return m_size;
+    }
+
+  private:
+    mapped_file(const mapped_file&);
+    mapped_file& operator=(const mapped_file&);
+};
@@ -0,0 +1,202 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <stddef.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+// Number of chunks that can be in flight between the reader, enclave and
+// writer stages. Once every slot is taken the reader blocks (backpressure).
+#define PIPELINE_DEPTH 4
+
+// Waits with a short spin, then yields, then sleeps, so an idle stage costs
+// little CPU without adding latency when its queue refills quickly.
+class backoff
+{
+  private:
+    unsigned int m_count;
+
+  public:
+    backoff() : m_count(0)
+    {
+    }
+    void pause()
+    {
+        if (m_count >= 128)
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        else if (m_count >= 64)
+            std::this_thread::yield();
+        m_count++;
+    }
+};
+
+// Bounded lock-free ring for exactly one producer and one consumer thread.
+template <typename T>
+class spsc_queue
+{
+  private:
+    std::vector<T> m_items;
+    std::atomic<size_t> m_head; // next slot to pop, owned by the consumer
+    std::atomic<size_t> m_tail; // next slot to push, owned by the producer
+
+  public:
+    explicit spsc_queue(size_t capacity)
+        : m_items(capacity + 1), m_head(0), m_tail(0)
+    {
+    }
+
+    bool try_push(const T& item)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t next = (tail + 1) % m_items.size();
+        if (next == m_head.load(std::memory_order_acquire))
+            return false;
+        m_items[tail] = item;
+        m_tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T& item)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return false;
+        item = m_items[head];
+        m_head.store((head + 1) % m_items.size(), std::memory_order_release);
+        return true;
+    }
+
+    // Blocking variants give up once abort is set by a failing stage
+    bool push(const T& item, const std::atomic<bool>& abort)
+    {
+        backoff wait;
+        while (!try_push(item))
+        {
+            if (abort.load())
+                return false;
+            wait.pause();
+        }
+        return true;
+    }
+
+    bool pop(T& item, const std::atomic<bool>& abort)
+    {
+        backoff wait;
+        while (!try_pop(item))
+        {
+            if (abort.load())
+                return false;
+            wait.pause();
+        }
+        return true;
+    }
+};
+
+// A record read into a slot: size bytes of sequence text at offset in the
+// input, or in the slot's in_buffer if copied is set
+struct slot_record
+{
+    size_t offset;
+    size_t size;
+    bool copied;
+};
+
+// A reusable buffer set that travels reader -> enclave -> writer and back.
+// Buffers keep their capacity between trips so steady state allocates nothing.
+struct pipeline_slot
+{
+    size_t index;                      // position of the chunk in the input
+    bool last;                         // set by the reader on the final chunk
+    const unsigned char* in;           // input data, mapped or in in_buffer
+    size_t in_size;
+    std::vector<unsigned char> in_buffer;
+    std::vector<slot_record> records;  // records read into the slot
+    std::vector<char> names;           // names of the scored records, if named
+    std::vector<size_t> name_ends;     // end of each record's name in names
+    std::vector<unsigned char> out;    // enclave output for the chunk
+    size_t out_size;
+    std::vector<float> scores;         // score rows produced for the chunk
+    std::vector<unsigned char> sealed; // or the sealed chunks holding them
+};
+
+// Runs read -> process -> write over a pool of PIPELINE_DEPTH slots. Reading
+// and writing happen on their own threads while the calling thread makes the
+// ecalls, so wall time approaches that of the slowest stage. Chunks are
+// written in input order. Each callback returns 0 on success; the reader
+// marks the final chunk by setting slot.last, and the processor may set it to
+// end the run early, in which case chunks read past it are dropped.
+template <typename Reader, typename Processor, typename Writer>
+int run_pipeline(Reader read, Processor process, Writer write)
+{
+    std::vector<pipeline_slot> slots(PIPELINE_DEPTH);
+    spsc_queue<pipeline_slot*> free_slots(PIPELINE_DEPTH);
+    spsc_queue<pipeline_slot*> read_slots(PIPELINE_DEPTH);
+    spsc_queue<pipeline_slot*> done_slots(PIPELINE_DEPTH);
+    std::atomic<bool> failed(false);
+    std::atomic<bool> stopped(false); // no more chunks are wanted
+
+    for (size_t i = 0; i < slots.size(); i++)
+        free_slots.try_push(&slots[i]);
+
+    std::thread reader([&]() {
+        pipeline_slot* slot = NULL;
+        for (size_t index = 0; free_slots.pop(slot, stopped); index++)
+        {
+            slot->index = index;
+            slot->last = false;
+            slot->in = NULL;
+            slot->in_size = 0;
+            slot->out_size = 0;
+            slot->records.clear();
+            slot->names.clear();
+            slot->name_ends.clear();
+            slot->scores.clear();
+            slot->sealed.clear();
+            if (read(*slot) != 0)
+            {
+                failed = true;
+                return;
+            }
+            bool last = slot->last;
+            if (!read_slots.push(slot, stopped) || last)
+                return;
+        }
+    });
+
+    std::thread writer([&]() {
+        pipeline_slot* slot = NULL;
+        while (done_slots.pop(slot, failed))
+        {
+            bool last = slot->last;
+            if (write(*slot) != 0)
+            {
+                failed = true;
+                return;
+            }
+            if (!free_slots.push(slot, failed) || last)
+                return;
+        }
+    });
+
+    pipeline_slot* slot = NULL;
+    while (read_slots.pop(slot, failed))
+    {
+        if (process(*slot) != 0)
+        {
+            failed = true;
+            break;
+        }
+        bool last = slot->last;
+        if (!done_slots.push(slot, failed) || last)
+            break;
+    }
+    stopped = true;
+
+    reader.join();
+    writer.join();
+    return failed ? 1 : 0;
+}
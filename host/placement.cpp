@@ -0,0 +1,182 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#define _CRT_SECURE_NO_WARNINGS
+#include "placement.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include <algorithm>
+
+#ifdef __linux__
+// Parses a cpulist such as "0-15,32-47"
+static std::vector<int> read_cpulist(const char* path)
+{
+    std::vector<int> cpus;
+    char buffer[4096];
+    FILE* file = fopen(path, "r");
+
+    if (!file)
+        return cpus;
+    if (fgets(buffer, sizeof(buffer), file))
+    {
+        char* p = buffer;
+        while (*p >= '0' && *p <= '9')
+        {
+            long first = strtol(p, &p, 10);
+            long last = first;
+            if (*p == '-')
+                last = strtol(p + 1, &p, 10);
+            for (long cpu = first; cpu <= last; cpu++)
+                cpus.push_back((int)cpu);
+            if (*p == ',')
+                p++;
+        }
+    }
+    fclose(file);
+    return cpus;
+}
+#endif
+
+std::vector<std::vector<int> > numa_nodes()
+{
+    std::vector<std::vector<int> > nodes;
+#ifdef __linux__
+    const char* dir_path = "/sys/devices/system/node";
+    std::vector<int> numbers;
+    DIR* dir = opendir(dir_path);
+    struct dirent* entry;
+
+    while (dir && (entry = readdir(dir)) != NULL)
+    {
+        int number = 0;
+        char end = 0;
+        if (sscanf(entry->d_name, "node%d%c", &number, &end) == 1)
+            numbers.push_back(number);
+    }
+    if (dir)
+        closedir(dir);
+    std::sort(numbers.begin(), numbers.end());
+    for (size_t i = 0; i < numbers.size(); i++)
+    {
+        char path[256];
+        snprintf(path, sizeof(path), "%s/node%d/cpulist", dir_path, numbers[i]);
+        std::vector<int> cpus = read_cpulist(path);
+        // memory-only nodes have no CPUs to run on
+        if (!cpus.empty())
+            nodes.push_back(cpus);
+    }
+#endif
+    if (nodes.empty())
+        nodes.push_back(std::vector<int>());
+    return nodes;
+}
+
+int pin_thread(const std::vector<int>& cpus)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (size_t i = 0; i < cpus.size(); i++)
+    {
+        if (cpus[i] >= 0 && cpus[i] < CPU_SETSIZE)
+            CPU_SET(cpus[i], &set);
+    }
+    if (CPU_COUNT(&set) == 0)
+        return 1;
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0 ? 0 : 1;
+#else
+    (void)cpus;
+    return 1;
+#endif
+}
+
+worker_group::worker_group() : m_round(0), m_busy(0), m_stop(false)
+{
+}
+
+worker_group::~worker_group()
+{
+    stop();
+}
+
+void worker_group::start(const std::vector<std::vector<int> >& cpus)
+{
+    stop();
+    m_stop = false;
+    m_round = 0;
+    for (size_t i = 0; i < cpus.size(); i++)
+        m_threads.push_back(std::thread(&worker_group::work, this, i, cpus[i]));
+}
+
+void worker_group::work(size_t index, std::vector<int> cpus)
+{
+    unsigned long seen = 0;
+
+    // Unpinned, the worker still runs its jobs; it just may move between
+    // nodes
+    if (!cpus.empty())
+        pin_thread(cpus);
+    for (;;)
+    {
+        std::function<void(size_t)> job;
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+            while (!m_stop && m_round == seen)
+                m_wake.wait(lock);
+            if (m_stop)
+                return;
+            seen = m_round;
+            job = m_job;
+        }
+        job(index);
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            if (--m_busy == 0)
+                m_idle.notify_all();
+        }
+    }
+}
+
+void worker_group::run(const std::function<void(size_t)>& job)
+{
+    post(job);
+    wait();
+}
+
+void worker_group::post(const std::function<void(size_t)>& job)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (m_threads.empty())
+        return;
+    m_job = job;
+    m_busy = m_threads.size();
+    m_round++;
+    m_wake.notify_all();
+}
+
+void worker_group::wait()
+{
+    std::unique_lock<std::mutex> lock(m_lock);
+    while (m_busy > 0)
+        m_idle.wait(lock);
+    m_job = std::function<void(size_t)>();
+}
+
+void worker_group::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stop = true;
+        m_wake.notify_all();
+    }
+    for (size_t i = 0; i < m_threads.size(); i++)
+        m_threads[i].join();
+    m_threads.clear();
+}
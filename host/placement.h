@@ -0,0 +1,59 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <stddef.h>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Returns the CPUs of each NUMA node, from /sys/devices/system/node. A host
+// without that information is taken to be one node, with an empty CPU list.
+std::vector<std::vector<int> > numa_nodes();
+
+// Restricts the calling thread to cpus; returns non-zero if that fails or
+// is not supported
+int pin_thread(const std::vector<int>& cpus);
+
+// worker_group keeps a thread per worker, each pinned to a set of CPUs for
+// its whole life, and runs jobs on all of them at once. A worker that owns
+// an enclave makes every ecall into it, so the enclave's host memory and
+// the threads that call it stay on one NUMA node.
+class worker_group
+{
+  private:
+    std::vector<std::thread> m_threads;
+    std::mutex m_lock;
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;
+    std::function<void(size_t)> m_job;
+    unsigned long m_round; // jobs started so far
+    size_t m_busy;         // workers still running the current job
+    bool m_stop;
+
+    void work(size_t index, std::vector<int> cpus);
+
+  public:
+    worker_group();
+    ~worker_group();
+    // Starts a worker for each entry of cpus, pinned to those CPUs; an empty
+    // entry leaves the worker unpinned
+    void start(const std::vector<std::vector<int> >& cpus);
+    // Runs job(i) on worker i, for every worker, and waits for all of them
+    void run(const std::function<void(size_t)>& job);
+    // As run(), without waiting; wait() waits for the job to finish
+    void post(const std::function<void(size_t)>& job);
+    void wait();
+    void stop();
+    size_t size() const
+    {
+        return m_threads.size();
+    }
+
+  private:
+    worker_group(const worker_group&);
+    worker_group& operator=(const worker_group&);
+};
@@ -0,0 +1,60 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include "recindex.h"
+
+#include <string.h>
+#include "../shared.h"
+
+// Records the start of every record the parser finds
+struct index_sink
+{
+    record_indexer* indexer;
+
+    int bases(const unsigned char*, size_t)
+    {
+        return 0;
+    }
+    int record(uint64_t start, const char*)
+    {
+        indexer->add_record(start);
+        return 0;
+    }
+};
+
+record_indexer::record_indexer(size_t stride)
+    : m_stride(stride), m_records(0)
+{
+}
+
+void record_indexer::add_record(uint64_t offset)
+{
+    if (m_records % m_stride == 0)
+        m_offsets.push_back(offset);
+    m_records++;
+}
+
+// Records without bases are skipped by the framer and so are not counted.
+// Malformed text is left for the enclave to report when it is scored, but
+// the parse error is returned for callers that cannot wait for that.
+int record_indexer::add_text(const unsigned char* text, size_t size)
+{
+    index_sink sink = {this};
+    return m_parser.parse(text, size, sink) != 0 ? 1 : 0;
+}
+
+int record_indexer::finish_text()
+{
+    index_sink sink = {this};
+    return m_parser.finish(sink) != 0 ? 1 : 0;
+}
+
+std::vector<unsigned char> record_indexer::serialize() const
+{
+    size_t size = m_offsets.size() * RECORD_INDEX_ENTRY_SIZE;
+    std::vector<unsigned char> out(
+        size + (CIPHER_BLOCK_SIZE - size % CIPHER_BLOCK_SIZE) % CIPHER_BLOCK_SIZE);
+    if (size > 0)
+        memcpy(&out[0], m_offsets.data(), size);
+    return out;
+}
@@ -0,0 +1,50 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "../seqformat.h"
+
+// record_indexer collects the record index written after the encrypted data
+// (see shared.h): the plaintext offset of every stride-th record. Records are
+// either reported one at a time with add_record() or found in sequence text
+// by add_text(), which parses it the way the enclave's framer does.
+class record_indexer
+{
+  private:
+    size_t m_stride;
+    std::vector<uint64_t> m_offsets;
+    uint64_t m_records;
+    seq_text_parser m_parser;
+
+  public:
+    explicit record_indexer(size_t stride);
+    void add_record(uint64_t offset);
+    // add_text() and finish_text() return non-zero if the text is not valid
+    // sequence text
+    int add_text(const unsigned char* text, size_t size);
+    // Completes the last record of the text
+    int finish_text();
+    uint64_t records() const
+    {
+        return m_records;
+    }
+    size_t stride() const
+    {
+        return m_stride;
+    }
+    // The index entries, zero padded to a whole number of cipher blocks
+    std::vector<unsigned char> serialize() const;
+    size_t entries() const
+    {
+        return m_offsets.size();
+    }
+    // The offset of record entry * stride
+    uint64_t offset(size_t entry) const
+    {
+        return m_offsets[entry];
+    }
+};
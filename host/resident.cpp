@@ -0,0 +1,233 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include "resident.h"
+
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include "pipeline.h"
+
+#include "fileencryptor_u.h"
+
+// An idle worker waits this long at most before polling its ring again, in
+// case a wakeup was missed
+#define RESIDENT_IDLE_WAIT_MS 10
+
+// The rings of running resident_scorers, so that hcall_ringidle only ever
+// waits on a ring the host made
+static std::mutex ring_registry_lock;
+static std::vector<resident_ring*> ring_registry;
+
+void hcall_ringidle(void* ring, uint64_t seen)
+{
+    resident_ring* found = NULL;
+    {
+        std::lock_guard<std::mutex> lock(ring_registry_lock);
+        for (size_t i = 0; i < ring_registry.size(); i++)
+        {
+            if ((void*)&ring_registry[i]->ring == ring)
+                found = ring_registry[i];
+        }
+    }
+    if (!found)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return;
+    }
+
+    // submit() checks waiting after moving submit_tail, and this checks
+    // submit_tail after setting waiting, so one of them sees the other
+    std::unique_lock<std::mutex> lock(found->lock);
+    found->ring.waiting.store(1);
+    if (found->ring.submit_tail.load() == seen && !found->ring.stop.load())
+        found->wake.wait_for(lock, std::chrono::milliseconds(RESIDENT_IDLE_WAIT_MS));
+    found->ring.waiting.store(0);
+}
+
+resident_scorer::resident_scorer() : m_workers(NULL), m_next_tag(0)
+{
+}
+
+resident_scorer::~resident_scorer()
+{
+    stop();
+}
+
+int resident_scorer::start(
+    worker_group& workers,
+    const std::vector<oe_enclave_t*>& enclaves,
+    const std::vector<size_t>& modelsets)
+{
+    stop();
+    if (workers.size() == 0 || enclaves.size() != workers.size() ||
+        modelsets.size() != workers.size())
+        return 1;
+    for (size_t l = 0; l < workers.size(); l++)
+    {
+        resident_ring* r = new resident_ring;
+        r->ring.submit_head.store(0);
+        r->ring.submit_tail.store(0);
+        r->ring.done_head.store(0);
+        r->ring.done_tail.store(0);
+        r->ring.stop.store(0);
+        r->ring.waiting.store(0);
+        r->exited.store(false);
+        memset(r->ring.requests, 0, sizeof(r->ring.requests));
+        memset(r->ring.completions, 0, sizeof(r->ring.completions));
+        m_rings.push_back(r);
+    }
+    {
+        std::lock_guard<std::mutex> lock(ring_registry_lock);
+        ring_registry.insert(ring_registry.end(), m_rings.begin(), m_rings.end());
+    }
+    m_modelsets = modelsets;
+    m_in_flight.assign(m_rings.size(), 0);
+    m_results.assign(m_rings.size(), 0);
+    m_done.clear();
+    m_workers = &workers;
+
+    // The lanes stay in the enclave until stop()
+    std::vector<oe_enclave_t*> lane_enclaves = enclaves;
+    workers.post([this, lane_enclaves](size_t l) {
+        int ret = -1;
+        if (ecall_scoreworker(lane_enclaves[l], &ret, &m_rings[l]->ring) != OE_OK)
+            ret = -1;
+        m_results[l] = ret;
+        m_rings[l]->exited.store(true, std::memory_order_release);
+    });
+    return 0;
+}
+
+int resident_scorer::stop()
+{
+    int ret = 0;
+    if (m_rings.empty())
+        return 0;
+    for (size_t l = 0; l < m_rings.size(); l++)
+    {
+        std::lock_guard<std::mutex> lock(m_rings[l]->lock);
+        m_rings[l]->ring.stop.store(1);
+        m_rings[l]->wake.notify_one();
+    }
+    m_workers->wait();
+    {
+        std::lock_guard<std::mutex> lock(ring_registry_lock);
+        for (size_t l = 0; l < m_rings.size(); l++)
+        {
+            for (size_t i = 0; i < ring_registry.size(); i++)
+            {
+                if (ring_registry[i] == m_rings[l])
+                {
+                    ring_registry.erase(ring_registry.begin() + (long)i);
+                    break;
+                }
+            }
+        }
+    }
+    for (size_t l = 0; l < m_rings.size(); l++)
+    {
+        if (m_results[l] != 0)
+            ret = 1;
+        delete m_rings[l];
+    }
+    m_rings.clear();
+    m_workers = NULL;
+    return ret;
+}
+
+// Moves the completions on every ring to m_done; returns true if there were
+// any
+bool resident_scorer::reap()
+{
+    bool found = false;
+    for (size_t l = 0; l < m_rings.size(); l++)
+    {
+        score_ring& ring = m_rings[l]->ring;
+        uint64_t head = ring.done_head.load(std::memory_order_relaxed);
+        uint64_t tail = ring.done_tail.load(std::memory_order_acquire);
+        for (; head != tail; head++)
+        {
+            const score_completion_t& done = ring.completions[head % SCORE_RING_SLOTS];
+            m_done[done.tag] = done;
+            m_in_flight[l]--;
+            found = true;
+        }
+        ring.done_head.store(head, std::memory_order_release);
+    }
+    return found;
+}
+
+score_ticket resident_scorer::submit(const score_request_t& request)
+{
+    backoff wait;
+    size_t lane = 0;
+
+    for (;;)
+    {
+        bool found = false;
+        for (size_t l = 0; l < m_rings.size(); l++)
+        {
+            if (m_rings[l]->exited.load(std::memory_order_acquire))
+                continue;
+            if (!found || m_in_flight[l] < m_in_flight[lane])
+                lane = l;
+            found = true;
+        }
+        if (!found)
+        {
+            // no worker is left to take it
+            score_ticket ticket = {m_rings.size(), m_next_tag++};
+            score_completion_t done = {ticket.tag, -1, 0};
+            m_done[ticket.tag] = done;
+            return ticket;
+        }
+        if (m_in_flight[lane] < RESIDENT_RING_DEPTH)
+            break;
+        if (!reap())
+            wait.pause();
+    }
+
+    score_ring& ring = m_rings[lane]->ring;
+    uint64_t tail = ring.submit_tail.load(std::memory_order_relaxed);
+    score_ticket ticket = {lane, m_next_tag++};
+    score_request_t& slot = ring.requests[tail % SCORE_RING_SLOTS];
+    slot = request;
+    slot.tag = ticket.tag;
+    slot.modelset = m_modelsets[lane];
+    m_in_flight[lane]++;
+    ring.submit_tail.store(tail + 1);
+    if (ring.waiting.load())
+    {
+        std::lock_guard<std::mutex> lock(m_rings[lane]->lock);
+        m_rings[lane]->wake.notify_one();
+    }
+    return ticket;
+}
+
+score_completion_t resident_scorer::wait(const score_ticket& ticket)
+{
+    backoff wait;
+    for (;;)
+    {
+        std::map<uint64_t, score_completion_t>::iterator it = m_done.find(ticket.tag);
+        if (it != m_done.end())
+        {
+            score_completion_t done = it->second;
+            m_done.erase(it);
+            return done;
+        }
+        // Checked before reaping: a worker that had exited has made all the
+        // completions it will, so once they are reaped the ticket is lost
+        bool exited = ticket.lane < m_rings.size() &&
+                      m_rings[ticket.lane]->exited.load(std::memory_order_acquire);
+        if (reap())
+            continue;
+        if (exited)
+        {
+            score_completion_t done = {ticket.tag, -1, 0};
+            return done;
+        }
+        wait.pause();
+    }
+}
@@ -0,0 +1,82 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <openenclave/host.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <vector>
+#include "../scorering.h"
+#include "placement.h"
+
+// Requests queued per resident worker: enough that a worker finds its next
+// request as it finishes one, few enough that new requests still go to
+// whichever worker gets free first
+#define RESIDENT_RING_DEPTH 2
+
+// A score_ring with what the host needs to wake its worker. The ring comes
+// first: its address is what the enclave sees. exited is set once the
+// worker's ecall has returned, so that nothing waits on it any longer.
+struct resident_ring
+{
+    score_ring ring;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::atomic<bool> exited;
+};
+
+// A request submitted to a resident worker, to be waited for
+struct score_ticket
+{
+    size_t lane;
+    uint64_t tag;
+};
+
+// resident_scorer keeps a resident scoring worker (see scorering.h) on each
+// lane of a worker_group, in that lane's enclave, for as long as it runs.
+// Requests are submitted to the worker with the fewest in flight and their
+// completions reaped from the rings, with no ecall per request.
+class resident_scorer
+{
+  private:
+    std::vector<resident_ring*> m_rings;
+    std::vector<size_t> m_modelsets; // of each lane's enclave
+    std::vector<size_t> m_in_flight;
+    std::vector<int> m_results;      // of ecall_scoreworker on each lane
+    std::map<uint64_t, score_completion_t> m_done; // reaped, not yet waited for
+    worker_group* m_workers;
+    uint64_t m_next_tag;
+
+    bool reap();
+
+  public:
+    resident_scorer();
+    ~resident_scorer();
+    // Starts a worker on each lane of workers, lane l entering enclaves[l]
+    // and scoring with its model set modelsets[l]
+    int start(worker_group& workers,
+              const std::vector<oe_enclave_t*>& enclaves,
+              const std::vector<size_t>& modelsets);
+    // Stops the workers; returns non-zero if any of them failed
+    int stop();
+    bool started() const
+    {
+        return !m_rings.empty();
+    }
+    // Submits request, less its model set, which is the lane's, to a worker
+    // still running; waits while every such worker has RESIDENT_RING_DEPTH
+    // requests queued. If no worker is left, the ticket completes with -1.
+    score_ticket submit(const score_request_t& request);
+    // Waits for the completion of ticket, spinning first, then sleeping.
+    // The result is -1 if the ticket's worker exited without completing it.
+    score_completion_t wait(const score_ticket& ticket);
+
+  private:
+    resident_scorer(const resident_scorer&);
+    resident_scorer& operator=(const resident_scorer&);
+};
@@ -0,0 +1,151 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include "scheduler.h"
+
+#include <algorithm>
+
+size_t model_window_size(const deepbind_model_t& model)
+{
+    return (size_t)(model.detector_len * 1.5);
+}
+
+double model_window_cost(const deepbind_model_t& model)
+{
+    double n = (double)model_window_size(model);
+    double m = (double)model.detector_len;
+    double d = (double)model.num_detectors;
+    double hidden1 = model.has_avg_pooling ? 2 * d : d;
+    double hidden2 = model.num_hidden ? (double)model.num_hidden : 1;
+    // convolution and pooling over the window and its padding, then the
+    // hidden layers
+    double cost = d * (n + m - 1) * (m + 1) + hidden1 * hidden2 + hidden2;
+    return model.reverse_complement ? 2 * cost : cost;
+}
+
+uint64_t model_windows(const deepbind_model_t& model, uint64_t length)
+{
+    uint64_t window = model_window_size(model);
+    return length <= window ? 1 : length - window + 1;
+}
+
+length_profile::length_profile()
+    : m_counts(LENGTH_PROFILE_EXACT, 0), m_long_records(0), m_long_bases(0)
+{
+}
+
+void length_profile::add(uint64_t length)
+{
+    if (length < LENGTH_PROFILE_EXACT)
+        m_counts[(size_t)length]++;
+    else
+    {
+        m_long_records++;
+        m_long_bases += length;
+    }
+}
+
+uint64_t length_profile::records() const
+{
+    uint64_t records = m_long_records;
+    for (size_t i = 0; i < m_counts.size(); i++)
+        records += m_counts[i];
+    return records;
+}
+
+uint64_t length_profile::bases() const
+{
+    uint64_t bases = m_long_bases;
+    for (size_t i = 0; i < m_counts.size(); i++)
+        bases += m_counts[i] * i;
+    return bases;
+}
+
+double length_profile::windows(const deepbind_model_t& model) const
+{
+    uint64_t window = model_window_size(model);
+    double windows = 0;
+    for (size_t i = 0; i < m_counts.size(); i++)
+        windows += (double)m_counts[i] * (double)model_windows(model, i);
+    // a long record has length - window + 1 windows unless the window is
+    // longer still
+    if (window < LENGTH_PROFILE_EXACT)
+        windows += (double)m_long_bases - (double)m_long_records * (double)(window - 1);
+    else
+        windows += (double)m_long_records; // rough: one window each
+    return windows;
+}
+
+std::vector<size_t> split_models(const std::vector<double>& costs, size_t groups)
+{
+    std::vector<size_t> starts;
+    double total = 0;
+    double sum = 0;
+
+    for (size_t i = 0; i < costs.size(); i++)
+        total += costs[i];
+    if (groups > costs.size())
+        groups = costs.size();
+    starts.push_back(0);
+    // a range ends once it reaches its share of the total cost, leaving at
+    // least one model for each range after it
+    for (size_t i = 0; i < costs.size() && starts.size() < groups; i++)
+    {
+        sum += costs[i];
+        size_t left = costs.size() - (i + 1);
+        if ((sum >= total * (double)starts.size() / (double)groups && left > 0) ||
+            left == groups - starts.size())
+            starts.push_back(i + 1);
+    }
+    starts.push_back(costs.size());
+    return starts;
+}
+
+static bool task_more(const score_task& a, const score_task& b)
+{
+    return a.cost > b.cost;
+}
+
+void task_queues::deal(std::vector<score_task> tasks, size_t lanes)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_queues.assign(lanes, std::deque<score_task>());
+    m_left.assign(lanes, 0);
+    std::stable_sort(tasks.begin(), tasks.end(), task_more);
+    for (size_t t = 0; t < tasks.size(); t++)
+    {
+        size_t lane = (size_t)(std::min_element(m_left.begin(), m_left.end()) - m_left.begin());
+        m_queues[lane].push_back(tasks[t]);
+        m_left[lane] += tasks[t].cost;
+    }
+}
+
+bool task_queues::next(size_t lane, score_task* task)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    size_t from = lane;
+
+    if (m_queues[lane].empty())
+    {
+        bool found = false;
+        for (size_t i = 0; i < m_queues.size(); i++)
+        {
+            if (!m_queues[i].empty() && (!found || m_left[i] > m_left[from]))
+            {
+                from = i;
+                found = true;
+            }
+        }
+        if (!found)
+            return false;
+        *task = m_queues[from].back();
+        m_queues[from].pop_back();
+    }
+    else
+    {
+        *task = m_queues[lane].front();
+        m_queues[lane].pop_front();
+    }
+    m_left[from] -= task->cost;
+    return true;
+}
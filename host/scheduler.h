@@ -0,0 +1,75 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include "../shared.h"
+
+// Cost model of scoring with a DeepBind model, in multiply-adds, following
+// deepbind::scan_encoded in the enclave: a sequence longer than the model's
+// window (1.5 detector lengths) is scored window by window, and each window
+// pays for the convolution over it and its padding, the pooling and the
+// hidden layers. Reverse complement models score the sequence twice.
+
+// Bases in one window of model
+size_t model_window_size(const deepbind_model_t& model);
+// Cost of scoring one window, times two for reverse complement models
+double model_window_cost(const deepbind_model_t& model);
+// Windows scored for a sequence of length bases
+uint64_t model_windows(const deepbind_model_t& model, uint64_t length);
+
+// length_profile keeps the record lengths of an input compactly, enough to
+// sum model_windows() over its records for any model
+#define LENGTH_PROFILE_EXACT 256
+class length_profile
+{
+  private:
+    std::vector<uint64_t> m_counts; // records of each length below LENGTH_PROFILE_EXACT
+    uint64_t m_long_records;        // and of the rest, with their bases
+    uint64_t m_long_bases;
+
+  public:
+    length_profile();
+    void add(uint64_t length);
+    uint64_t records() const;
+    uint64_t bases() const;
+    // Windows the records come to for model
+    double windows(const deepbind_model_t& model) const;
+};
+
+// Splits models [0, costs.size()) into at most groups consecutive ranges of
+// about the same total cost. Returns the first model of each range, then
+// costs.size().
+std::vector<size_t> split_models(const std::vector<double>& costs, size_t groups);
+
+// A piece of a predict batch: the models of one group for records
+// [first, first + count) of the batch
+struct score_task
+{
+    size_t group;
+    size_t first;
+    size_t count;
+    double cost;
+};
+
+// task_queues deals tasks to lanes, the threads that score them, longest
+// first to the lane with the least work so far. A lane takes its own tasks
+// from the front of its queue; once they are gone it steals from the back
+// of the queue with the most work left, which makes up for costs that were
+// estimated wrongly. Tasks are whole ecalls, so a single lock is enough.
+class task_queues
+{
+  private:
+    std::vector<std::deque<score_task> > m_queues;
+    std::vector<double> m_left; // estimated cost queued per lane
+    std::mutex m_lock;
+
+  public:
+    void deal(std::vector<score_task> tasks, size_t lanes);
+    bool next(size_t lane, score_task* task);
+};
@@ -0,0 +1,248 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#define _CRT_SECURE_NO_WARNINGS
+#include "scorefile.h"
+
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+size_t score_group_size(const score_file_header_t& header, size_t rows)
+{
+    size_t value_size =
+        header.encoding == SCORE_ENCODING_FLOAT16 ? sizeof(uint16_t) : sizeof(float);
+    size_t size = sizeof(score_group_header_t) + 2 * header.columns * sizeof(float) +
+                  (size_t)header.columns * rows * value_size;
+    return (size + 7) & ~(size_t)7;
+}
+
+// IEEE 754 binary16 with round to nearest even; out of range values become
+// infinity and NaN stays NaN
+uint16_t float_to_half(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t exponent = (bits >> 23) & 0xff;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (exponent == 0xff)
+        return (uint16_t)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    int e = (int)exponent - 127 + 15;
+    if (e >= 31)
+        return (uint16_t)(sign | 0x7c00);
+    if (e <= 0)
+    {
+        // subnormal half, or zero
+        if (e < -10)
+            return (uint16_t)sign;
+        mantissa |= 0x800000;
+        uint32_t shift = (uint32_t)(14 - e);
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1)))
+            half++;
+        return (uint16_t)(sign | half);
+    }
+    uint32_t half = ((uint32_t)e << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        half++; // may carry into the exponent, up to infinity
+    return (uint16_t)(sign | half);
+}
+
+float half_to_float(uint16_t half)
+{
+    uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1f;
+    uint32_t mantissa = half & 0x3ff;
+    uint32_t bits;
+
+    if (exponent == 0x1f)
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    else if (exponent != 0)
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    else if (mantissa == 0)
+        bits = sign;
+    else
+    {
+        // subnormal half: normalize
+        exponent = 127 - 15 + 1;
+        while (!(mantissa & 0x400))
+        {
+            mantissa <<= 1;
+            exponent--;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+    }
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+score_file_writer::score_file_writer() : m_file(NULL)
+{
+    memset(&m_header, 0, sizeof(m_header));
+}
+
+// Starts a new score file
+int score_file_writer::open(
+    FILE* file,
+    const model_id_t* ids,
+    size_t columns,
+    unsigned int encoding)
+{
+    m_file = file;
+    memset(&m_header, 0, sizeof(m_header));
+    m_header.magic = SCORE_FILE_MAGIC;
+    m_header.version = SCORE_FILE_VERSION;
+    m_header.columns = (uint32_t)columns;
+    m_header.encoding = encoding;
+    m_header.group_rows = SCORE_GROUP_ROWS;
+    m_rows.clear();
+    if (fwrite(&m_header, 1, sizeof(m_header), m_file) != sizeof(m_header) ||
+        (columns > 0 && fwrite(ids, sizeof(model_id_t), columns, m_file) != columns))
+        return 1;
+    return 0;
+}
+
+// Continues a score file already holding rows rows, with file positioned at
+// its end
+int score_file_writer::resume(FILE* file, uint64_t rows)
+{
+    long end = ftell(file);
+    m_file = file;
+    m_rows.clear();
+    if (end < 0 || fseek(file, 0, SEEK_SET) != 0 ||
+        fread(&m_header, 1, sizeof(m_header), file) != sizeof(m_header) ||
+        fseek(file, end, SEEK_SET) != 0)
+        return 1;
+    if (m_header.magic != SCORE_FILE_MAGIC || m_header.version != SCORE_FILE_VERSION)
+        return 1;
+    m_header.rows = rows;
+    return 0;
+}
+
+// Allocates disk space for about rows more rows up front, where the system
+// supports it; finish() cuts off what is not used
+void score_file_writer::reserve(uint64_t rows)
+{
+#if defined(__linux__)
+    long start = ftell(m_file);
+    uint64_t groups = (rows + m_header.group_rows - 1) / m_header.group_rows;
+    if (start >= 0 && groups > 0)
+        posix_fallocate(
+            fileno(m_file),
+            (off_t)start,
+            (off_t)(groups * score_group_size(m_header, m_header.group_rows)));
+#else
+    (void)rows;
+#endif
+}
+
+int score_file_writer::add_rows(const float* scores, size_t rows)
+{
+    size_t columns = m_header.columns;
+    size_t group_values = (size_t)m_header.group_rows * columns;
+
+    if (columns == 0)
+        return 0;
+    m_rows.insert(m_rows.end(), scores, scores + rows * columns);
+    while (m_rows.size() >= group_values)
+    {
+        if (write_group() != 0)
+            return 1;
+    }
+    return 0;
+}
+
+// Writes the first group_rows buffered rows, or all of them if fewer, as one
+// row group
+int score_file_writer::write_group()
+{
+    size_t columns = m_header.columns;
+    size_t rows = m_rows.size() / columns;
+    bool half = m_header.encoding == SCORE_ENCODING_FLOAT16;
+    score_group_header_t group = {0, 0};
+
+    if (rows > m_header.group_rows)
+        rows = m_header.group_rows;
+    group.rows = (uint32_t)rows;
+
+    m_group.assign(score_group_size(m_header, rows), 0);
+    unsigned char* p = &m_group[0];
+    memcpy(p, &group, sizeof(group));
+    float* minimum = (float*)(p + sizeof(group));
+    float* maximum = minimum + columns;
+    unsigned char* values = (unsigned char*)(maximum + columns);
+
+    for (size_t c = 0; c < columns; c++)
+    {
+        float lo = m_rows[c];
+        float hi = m_rows[c];
+        for (size_t r = 0; r < rows; r++)
+        {
+            float score = m_rows[r * columns + c];
+            lo = score < lo ? score : lo;
+            hi = score > hi ? score : hi;
+            if (half)
+            {
+                uint16_t bits = float_to_half(score);
+                memcpy(values + (c * rows + r) * sizeof(bits), &bits, sizeof(bits));
+            }
+            else
+            {
+                memcpy(values + (c * rows + r) * sizeof(score), &score, sizeof(score));
+            }
+        }
+        minimum[c] = lo;
+        maximum[c] = hi;
+    }
+
+    if (fwrite(&m_group[0], 1, m_group.size(), m_file) != m_group.size())
+        return 1;
+    m_rows.erase(m_rows.begin(), m_rows.begin() + (long)(rows * columns));
+    m_header.rows += rows;
+    return 0;
+}
+
+// Writes the rows buffered so far as a short row group, so that the file
+// holds every row added
+int score_file_writer::flush()
+{
+    if (!m_rows.empty() && write_group() != 0)
+        return 1;
+    return fflush(m_file) == 0 ? 0 : 1;
+}
+
+// Flushes the last rows, drops space reserved but not used and records the
+// row count in the header. Files that cannot be rewound keep a count of 0.
+int score_file_writer::finish()
+{
+    struct stat st;
+    long end;
+
+    if (flush() != 0)
+        return 1;
+    if (fstat(fileno(m_file), &st) != 0 || (st.st_mode & S_IFMT) != S_IFREG)
+        return 0;
+    if ((end = ftell(m_file)) < 0)
+        return 1;
+#ifndef _WIN32
+    if (ftruncate(fileno(m_file), (off_t)end) != 0)
+        return 1;
+#endif
+    if (fseek(m_file, 0, SEEK_SET) != 0 ||
+        fwrite(&m_header, 1, sizeof(m_header), m_file) != sizeof(m_header) ||
+        fseek(m_file, end, SEEK_SET) != 0)
+        return 1;
+    return fflush(m_file) == 0 ? 0 : 1;
+}
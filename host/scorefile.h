@@ -0,0 +1,72 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include "../shared.h"
+
+// Binary score files hold the same scores as the tab separated text, in a
+// form other tools can map and read without parsing. The file is a
+// score_file_header_t, then columns model_id_t values naming the models, then
+// row groups of up to group_rows rows each:
+//   score_group_header_t
+//   float min[columns], float max[columns]   per model statistics
+//   columns x rows scores, model by model (float32, or float16 bits)
+//   zero padding to a multiple of 8 bytes
+// All values are little endian. rows is filled in once the file is complete;
+// until then, readers stop at the end of the file or at a group of 0 rows.
+#define SCORE_FILE_MAGIC 0x46435853 // "SXCF"
+#define SCORE_FILE_VERSION 1
+#define SCORE_ENCODING_FLOAT32 0
+#define SCORE_ENCODING_FLOAT16 1
+#define SCORE_GROUP_ROWS 8192
+
+typedef struct _score_file_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t columns;
+    uint32_t encoding;
+    uint32_t group_rows;
+    uint32_t reserved;
+    uint64_t rows;
+} score_file_header_t;
+
+typedef struct _score_group_header
+{
+    uint32_t rows;
+    uint32_t reserved;
+} score_group_header_t;
+
+// Size of a row group of rows rows, including its header and padding
+size_t score_group_size(const score_file_header_t& header, size_t rows);
+
+uint16_t float_to_half(float value);
+float half_to_float(uint16_t half);
+
+// score_file_writer collects score rows and writes them to a binary score
+// file a whole row group at a time, in one write per group.
+class score_file_writer
+{
+  private:
+    FILE* m_file;
+    score_file_header_t m_header;
+    std::vector<float> m_rows;          // buffered rows, row by row
+    std::vector<unsigned char> m_group; // the group being written
+
+  public:
+    score_file_writer();
+    int open(FILE* file, const model_id_t* ids, size_t columns, unsigned int encoding);
+    int resume(FILE* file, uint64_t rows);
+    void reserve(uint64_t rows);
+    int add_rows(const float* scores, size_t rows);
+    int flush();
+    int finish();
+
+  private:
+    int write_group();
+};
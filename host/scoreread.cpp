@@ -0,0 +1,138 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+// Converts a binary score file (see scorefile.h) to the tab separated text
+// that decrypt writes, without an enclave:
+//   score-reader [--precision=<digits>|shortest] score-file [dest-file]
+
+#define _CRT_SECURE_NO_WARNINGS
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mapped_file.h"
+#include "scorefile.h"
+#include "textwriter.h"
+
+static float read_score(const score_file_header_t& header, const unsigned char* values, size_t index)
+{
+    if (header.encoding == SCORE_ENCODING_FLOAT16)
+    {
+        uint16_t half;
+        memcpy(&half, values + index * sizeof(half), sizeof(half));
+        return half_to_float(half);
+    }
+    float score;
+    memcpy(&score, values + index * sizeof(score), sizeof(score));
+    return score;
+}
+
+static int usage()
+{
+    fprintf(
+        stderr,
+        "Usage: score-reader [--precision=<digits>|shortest] score-file [dest-file]\n");
+    return 1;
+}
+
+int main(int argc, const char* argv[])
+{
+    mapped_file file;
+    score_file_header_t header;
+    FILE* out = stdout;
+    int precision = DEFAULT_SCORE_PRECISION;
+    const unsigned char* data;
+    size_t size;
+    size_t pos;
+    uint64_t rows = 0;
+    int ret = 0;
+
+    if (argc > 1 && strncmp(argv[1], "--precision=", 12) == 0)
+    {
+        const char* value = argv[1] + 12;
+        char* end = NULL;
+        unsigned long n = strtoul(value, &end, 10);
+        if (strcmp(value, "shortest") == 0)
+            precision = SCORE_PRECISION_SHORTEST;
+        else if (end != value && *end == '\0' && n <= MAX_SCORE_PRECISION)
+            precision = (int)n;
+        else
+            return usage();
+        argv++;
+        argc--;
+    }
+    if (argc < 2 || argc > 3)
+        return usage();
+    if (file.open(argv[1]) != 0)
+    {
+        fprintf(stderr, "open %s failed\n", argv[1]);
+        return 1;
+    }
+    data = file.data();
+    size = file.size();
+    if (size >= sizeof(header))
+        memcpy(&header, data, sizeof(header));
+    if (size < sizeof(header) || header.magic != SCORE_FILE_MAGIC ||
+        header.version != SCORE_FILE_VERSION ||
+        (header.encoding != SCORE_ENCODING_FLOAT32 &&
+         header.encoding != SCORE_ENCODING_FLOAT16) ||
+        (size - sizeof(header)) / sizeof(model_id_t) < header.columns)
+    {
+        fprintf(stderr, "%s is not a score file\n", argv[1]);
+        return 1;
+    }
+    if (argc == 3 && !(out = fopen(argv[2], "w")))
+    {
+        fprintf(stderr, "fopen %s failed\n", argv[2]);
+        return 1;
+    }
+
+    text_writer text(out, precision);
+    for (size_t c = 0; c < header.columns; c++)
+    {
+        model_id_t id;
+        memcpy(&id, data + sizeof(header) + c * sizeof(id), sizeof(id));
+        if (c > 0)
+            text.put('\t');
+        text.put_model_id(id);
+    }
+    text.put('\n');
+
+    pos = sizeof(header) + header.columns * sizeof(model_id_t);
+    while (header.columns > 0 && size - pos >= sizeof(score_group_header_t))
+    {
+        score_group_header_t group;
+        memcpy(&group, data + pos, sizeof(group));
+        if (group.rows == 0)
+            break;
+        size_t group_size = score_group_size(header, group.rows);
+        if (group.rows > header.group_rows || group_size > size - pos)
+        {
+            fprintf(stderr, "%s: row group at %zu is damaged\n", argv[1], pos);
+            ret = 1;
+            break;
+        }
+        const unsigned char* values =
+            data + pos + sizeof(group) + 2 * header.columns * sizeof(float);
+        for (size_t r = 0; r < group.rows; r++)
+        {
+            for (size_t c = 0; c < header.columns; c++)
+            {
+                if (c > 0)
+                    text.put('\t');
+                text.put_score(read_score(header, values, c * group.rows + r));
+            }
+            text.put('\n');
+        }
+        rows += group.rows;
+        pos += group_size;
+    }
+    if (header.rows != 0 && rows != header.rows)
+    {
+        fprintf(stderr, "%s: expected %llu rows, found %llu\n", argv[1],
+                (unsigned long long)header.rows, (unsigned long long)rows);
+        ret = 1;
+    }
+    if (text.flush() != 0 || (out != stdout && fclose(out) != 0))
+        ret = 1;
+    return ret;
+}
@@ -0,0 +1,225 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include "seqpack.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "../shared.h"
+
+#define UNKNOWN_CODE 4
+#define INVALID_CODE 5
+#define BLANK_CODE 6
+
+// Maps a character to its 2-bit base index (as deepbind::base2index does),
+// UNKNOWN_CODE for 'N', BLANK_CODE for ignorable blanks and INVALID_CODE for
+// anything else
+static unsigned char char2code(unsigned char c)
+{
+    switch (c)
+    {
+        case 'a':
+        case 'A':
+            return 0;
+        case 'c':
+        case 'C':
+            return 1;
+        case 'g':
+        case 'G':
+            return 2;
+        case 't':
+        case 'T':
+        case 'u':
+        case 'U':
+            return 3;
+        case 'n':
+        case 'N':
+            return UNKNOWN_CODE;
+        case ' ':
+        case '\t':
+        case '\r':
+            return BLANK_CODE;
+    }
+    return INVALID_CODE;
+}
+
+static void put_uint32(std::vector<unsigned char>& out, size_t pos, uint32_t value)
+{
+    memcpy(&out[pos], &value, sizeof(value));
+}
+
+sequence_packer::sequence_packer()
+    : m_line_number(0), m_records(0), m_offset(0), m_indexer(NULL)
+{
+}
+
+int sequence_packer::pack_line(
+    const char* line,
+    size_t size,
+    std::vector<unsigned char>& out)
+{
+    std::vector<uint32_t> runs; // start, length pairs of 'N' runs
+    size_t start = out.size();
+    uint32_t length = 0;
+
+    m_line_number++;
+
+    // Reserve room for the record header and the worst-case base bytes; the
+    // run table is inserted once it is known
+    out.resize(start + PACKED_RECORD_HEADER_SIZE + (size + 3) / 4);
+    unsigned char* bases = &out[start + PACKED_RECORD_HEADER_SIZE];
+    memset(bases, 0, (size + 3) / 4);
+
+    for (size_t i = 0; i < size; i++)
+    {
+        unsigned char code = char2code((unsigned char)line[i]);
+        if (code == BLANK_CODE)
+            continue;
+        if (code == INVALID_CODE && i == 0 && (line[i] == '>' || line[i] == '@'))
+        {
+            // Packed records have no room for names
+            fprintf(
+                stderr,
+                "Host: --packed takes one sequence per line; encrypt FASTA "
+                "and FASTQ files without it\n");
+            return 1;
+        }
+        if (code == INVALID_CODE)
+        {
+            fprintf(
+                stderr,
+                "Host: line %zu: '%c' is not a valid base\n",
+                m_line_number,
+                line[i]);
+            return 1;
+        }
+        if (code == UNKNOWN_CODE)
+        {
+            if (!runs.empty() && runs[runs.size() - 2] + runs.back() == length)
+                runs.back()++;
+            else
+            {
+                runs.push_back(length);
+                runs.push_back(1);
+            }
+        }
+        else
+        {
+            bases[length / 4] |= (unsigned char)(code << (2 * (length % 4)));
+        }
+        length++;
+    }
+
+    if (length == 0)
+    {
+        // blank lines are not records
+        out.resize(start);
+        return 0;
+    }
+
+    out.resize(start + PACKED_RECORD_HEADER_SIZE + (length + 3) / 4);
+    put_uint32(out, start, length);
+    put_uint32(out, start + sizeof(uint32_t), (uint32_t)(runs.size() / 2));
+    if (!runs.empty())
+    {
+        out.insert(
+            out.begin() + (long)(start + PACKED_RECORD_HEADER_SIZE),
+            (const unsigned char*)runs.data(),
+            (const unsigned char*)(runs.data() + runs.size()));
+    }
+    if (m_indexer)
+        m_indexer->add_record(m_offset);
+    m_offset += out.size() - start;
+    m_records++;
+    return 0;
+}
+
+int sequence_packer::feed(
+    const char* text,
+    size_t size,
+    bool eof,
+    std::vector<unsigned char>& out)
+{
+    size_t pos = 0;
+
+    while (pos < size)
+    {
+        const char* start = text + pos;
+        const char* newline = (const char*)memchr(start, '\n', size - pos);
+        size_t len = newline ? (size_t)(newline - start) : size - pos;
+
+        if (!newline)
+        {
+            m_line.append(start, len);
+            break;
+        }
+        if (m_line.empty())
+        {
+            if (pack_line(start, len, out) != 0)
+                return 1;
+        }
+        else
+        {
+            m_line.append(start, len);
+            if (pack_line(m_line.data(), m_line.size(), out) != 0)
+                return 1;
+            m_line.clear();
+        }
+        pos += len + 1;
+    }
+
+    if (eof && !m_line.empty())
+    {
+        if (pack_line(m_line.data(), m_line.size(), out) != 0)
+            return 1;
+        m_line.clear();
+    }
+    return 0;
+}
+
+int sequence_unpacker::feed(
+    const unsigned char* data,
+    size_t size,
+    bool eof,
+    std::string& out)
+{
+    static const char bases[] = "ACGT";
+
+    m_carry.insert(m_carry.end(), data, data + size);
+
+    size_t pos = 0;
+    while (m_carry.size() - pos >= PACKED_RECORD_HEADER_SIZE)
+    {
+        const unsigned char* record = &m_carry[pos];
+        uint32_t length;
+        uint32_t runs;
+        memcpy(&length, record, sizeof(length));
+        memcpy(&runs, record + sizeof(length), sizeof(runs));
+        if (length > MAX_PACKED_RECORD_LENGTH || runs > length)
+            return 1;
+
+        size_t header = PACKED_RECORD_HEADER_SIZE + (size_t)runs * PACKED_RUN_SIZE;
+        size_t need = header + (length + 3) / 4;
+        if (m_carry.size() - pos < need)
+            break;
+
+        size_t first = out.size();
+        out.resize(first + length + 1);
+        for (uint32_t i = 0; i < length; i++)
+            out[first + i] = bases[(record[header + i / 4] >> (2 * (i % 4))) & 3];
+        for (uint32_t r = 0; r < runs; r++)
+        {
+            uint32_t run[2];
+            memcpy(run, record + PACKED_RECORD_HEADER_SIZE + r * PACKED_RUN_SIZE, sizeof(run));
+            if (run[0] > length || run[1] > length - run[0])
+                return 1;
+            memset(&out[first + run[0]], 'N', run[1]);
+        }
+        out[first + length] = '\n';
+        pos += need;
+    }
+    m_carry.erase(m_carry.begin(), m_carry.begin() + (long)pos);
+
+    // a packed stream must end on a record boundary
+    return eof && !m_carry.empty() ? 1 : 0;
+}
@@ -0,0 +1,55 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "recindex.h"
+
+// sequence_packer turns sequence text (one sequence per line) into the packed
+// records described in shared.h. Text may be fed in pieces of any size; an
+// unfinished line is carried over to the next call.
+class sequence_packer
+{
+  private:
+    std::string m_line;       // unfinished line carried across feeds
+    size_t m_line_number;
+    size_t m_records;
+    uint64_t m_offset;        // packed bytes produced so far
+    record_indexer* m_indexer;
+
+  public:
+    sequence_packer();
+    // Reports the offset of every packed record to indexer
+    void set_indexer(record_indexer* indexer)
+    {
+        m_indexer = indexer;
+    }
+    // Appends the packed form of every line completed by text to out; the
+    // last line is completed when eof is set. Returns 0, or 1 if the text
+    // holds a character that is not a base.
+    int feed(const char* text, size_t size, bool eof, std::vector<unsigned char>& out);
+    size_t records() const
+    {
+        return m_records;
+    }
+
+  private:
+    int pack_line(const char* line, size_t size, std::vector<unsigned char>& out);
+};
+
+// sequence_unpacker turns packed records back into sequence text, one
+// upper case sequence per line. Data may be fed in pieces of any size.
+class sequence_unpacker
+{
+  private:
+    std::vector<unsigned char> m_carry; // unfinished record carried across feeds
+
+  public:
+    // Appends the text of every record completed by data to out. Returns 0,
+    // or 1 if the data is not a valid packed stream.
+    int feed(const unsigned char* data, size_t size, bool eof, std::string& out);
+};
@@ -0,0 +1,170 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#define _CRT_SECURE_NO_WARNINGS
+#include "shards.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#include "mapped_file.h"
+
+#define SHARD_COPY_SIZE (1024 * 1024)
+
+std::string shard_file(const std::string& base, size_t index)
+{
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".shard%zu", index);
+    return base + suffix;
+}
+
+int fork_shards(size_t count, std::vector<long>* pids)
+{
+#ifndef _WIN32
+    pids->clear();
+    // Output buffered before the fork would be written by every worker
+    fflush(NULL);
+    for (size_t i = 0; i < count; i++)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+            return (int)i;
+        if (pid < 0)
+        {
+            for (size_t j = 0; j < pids->size(); j++)
+                stop_shard((*pids)[j]);
+            pids->clear();
+            return -1;
+        }
+        pids->push_back((long)pid);
+    }
+    return (int)count;
+#else
+    (void)count;
+    (void)pids;
+    return -1;
+#endif
+}
+
+int wait_shard(long pid)
+{
+#ifndef _WIN32
+    int status = 0;
+    while (waitpid((pid_t)pid, &status, 0) < 0)
+    {
+        if (errno != EINTR)
+            return 1;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : 1;
+#else
+    (void)pid;
+    return 1;
+#endif
+}
+
+void stop_shard(long pid)
+{
+#ifndef _WIN32
+    kill((pid_t)pid, SIGTERM);
+    wait_shard(pid);
+#else
+    (void)pid;
+#endif
+}
+
+int merge_text_shard(FILE* dest, const char* path, bool keep_header)
+{
+    FILE* file = fopen(path, "rb");
+    std::vector<char> buffer(SHARD_COPY_SIZE);
+    bool in_header = !keep_header;
+    int ret = 0;
+
+    if (!file)
+        return 1;
+    for (;;)
+    {
+        size_t n = fread(&buffer[0], 1, buffer.size(), file);
+        size_t start = 0;
+        if (n == 0)
+            break;
+        if (in_header)
+        {
+            const char* newline = (const char*)memchr(&buffer[0], '\n', n);
+            if (!newline)
+                continue;
+            start = (size_t)(newline - &buffer[0]) + 1;
+            in_header = false;
+        }
+        if (fwrite(&buffer[start], 1, n - start, dest) != n - start)
+        {
+            ret = 1;
+            break;
+        }
+    }
+    if (ferror(file))
+        ret = 1;
+    fclose(file);
+    return ret;
+}
+
+shard_merger::shard_merger(FILE* dest)
+    : m_dest(dest), m_started(false)
+{
+    memset(&m_header, 0, sizeof(m_header));
+}
+
+int shard_merger::add(const char* path)
+{
+    mapped_file file;
+    score_file_header_t header;
+    size_t start;
+
+    if (file.open(path) != 0 || file.size() < sizeof(header))
+        return 1;
+    memcpy(&header, file.data(), sizeof(header));
+    start = sizeof(header) + (size_t)header.columns * sizeof(model_id_t);
+    if (header.magic != SCORE_FILE_MAGIC || header.version != SCORE_FILE_VERSION ||
+        file.size() < start || (m_started && header.columns != m_header.columns))
+        return 1;
+
+    if (!m_started)
+    {
+        // The rows of the merged file are only known at the end
+        score_file_header_t first = header;
+        first.rows = 0;
+        if (fwrite(&first, 1, sizeof(first), m_dest) != sizeof(first) ||
+            fwrite(file.data() + sizeof(header), 1, start - sizeof(header), m_dest) !=
+                start - sizeof(header))
+            return 1;
+        m_header = first;
+        m_started = true;
+    }
+    if (fwrite(file.data() + start, 1, file.size() - start, m_dest) != file.size() - start)
+        return 1;
+    m_header.rows += header.rows;
+    return 0;
+}
+
+int shard_merger::finish()
+{
+    struct stat st;
+    long end;
+
+    if (fflush(m_dest) != 0)
+        return 1;
+    if (!m_started || fstat(fileno(m_dest), &st) != 0 ||
+        (st.st_mode & S_IFMT) != S_IFREG)
+        return 0;
+    if ((end = ftell(m_dest)) < 0 || fseek(m_dest, 0, SEEK_SET) != 0 ||
+        fwrite(&m_header, 1, sizeof(m_header), m_dest) != sizeof(m_header) ||
+        fseek(m_dest, end, SEEK_SET) != 0)
+        return 1;
+    return fflush(m_dest) == 0 ? 0 : 1;
+}
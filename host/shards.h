@@ -0,0 +1,57 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "scorefile.h"
+
+// Sharded runs (--shards=<n>) split the records of a decrypt or predict run
+// into consecutive shards. Each shard is scored by a worker process with its
+// own enclave and model set, into a score file of its own, and the
+// coordinator merges the shard files into the output in input order.
+#define MAX_SHARDS 64
+
+// Predict shards of an uncompressed sequence file start at every
+// SHARD_INDEX_STRIDE-th record, whose text offsets the coordinator collects
+// while counting the records
+#define SHARD_INDEX_STRIDE 64
+
+// Returns the name of the score file of shard index: <base>.shard<index>
+std::string shard_file(const std::string& base, size_t index);
+
+// Forks a worker for each of count shards, returning the shard index in the
+// worker and count in the coordinator, which gets the worker process ids in
+// pids. Returns -1 if no worker could be started; workers started by then
+// are stopped.
+int fork_shards(size_t count, std::vector<long>* pids);
+
+// Waits for a worker and returns 0 if it succeeded
+int wait_shard(long pid);
+
+// Stops a worker that is no longer wanted and waits for it
+void stop_shard(long pid);
+
+// Appends the text score file at path to dest; keep_header keeps its first
+// line, the model ids, which every shard file starts with
+int merge_text_shard(FILE* dest, const char* path, bool keep_header);
+
+// shard_merger appends binary score files (see scorefile.h) to one file:
+// the header and model ids of the first, then the row groups of each in
+// turn. The row count in the header is set by finish() when dest is a
+// regular file, as score_file_writer does.
+class shard_merger
+{
+  private:
+    FILE* m_dest;
+    score_file_header_t m_header; // of the first file, counting all rows
+    bool m_started;
+
+  public:
+    explicit shard_merger(FILE* dest);
+    int add(const char* path);
+    int finish();
+};
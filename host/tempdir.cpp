@@ -0,0 +1,68 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#define _CRT_SECURE_NO_WARNINGS
+#include "tempdir.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+std::string make_temp_dir()
+{
+    const char* dir = getenv("TMPDIR");
+    std::string path = std::string(dir && *dir ? dir : "/tmp") + "/sgxdb-XXXXXX";
+    std::vector<char> name(path.begin(), path.end());
+
+    name.push_back('\0');
+#ifdef _WIN32
+    if (_mktemp_s(&name[0], name.size()) != 0 || _mkdir(&name[0]) != 0)
+        return std::string();
+#else
+    // mkdtemp creates the directory with mode 0700
+    if (!mkdtemp(&name[0]))
+        return std::string();
+#endif
+    return std::string(&name[0]);
+}
+
+void remove_temp_dir(const std::string& dir)
+{
+    if (dir.empty())
+        return;
+#ifdef _WIN32
+    struct _finddata_t entry;
+    intptr_t find = _findfirst((dir + "/*").c_str(), &entry);
+    if (find != -1)
+    {
+        do
+        {
+            if (!(entry.attrib & _A_SUBDIR))
+                remove((dir + "/" + entry.name).c_str());
+        } while (_findnext(find, &entry) == 0);
+        _findclose(find);
+    }
+    _rmdir(dir.c_str());
+#else
+    DIR* d = opendir(dir.c_str());
+    if (d)
+    {
+        struct dirent* entry;
+        while ((entry = readdir(d)) != NULL)
+        {
+            if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+                unlink((dir + "/" + entry->d_name).c_str());
+        }
+        closedir(d);
+    }
+    rmdir(dir.c_str());
+#endif
+}
@@ -0,0 +1,17 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <string>
+
+// Scratch files of decrypted data, such as the score files of --shards
+// workers, go in a directory that only the current user can enter, so that
+// no one else can read them or plant a link in their place.
+
+// Creates $TMPDIR/sgxdb-XXXXXX, or under /tmp, with a unique name and mode
+// 0700. Returns its path, or an empty string on failure.
+std::string make_temp_dir();
+
+// Removes dir, made by make_temp_dir, with the files in it
+void remove_temp_dir(const std::string& dir);
@@ -0,0 +1,164 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#define _CRT_SECURE_NO_WARNINGS
+#include "textwriter.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <cmath>
+
+using namespace std;
+
+static const double powers_of_ten[MAX_SCORE_PRECISION + 1] =
+    {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+
+// Largest scaled value printed through the integer path
+#define MAX_SCALED_SCORE 9.0e18
+
+// Rounds scaled, a non-negative double, to the nearest integer with ties to
+// even, as printf does
+static uint64_t round_scaled(double scaled)
+{
+    uint64_t q = (uint64_t)scaled;
+    double rest = scaled - (double)q;
+    if (rest > 0.5 || (rest == 0.5 && (q & 1)))
+        q++;
+    return q;
+}
+
+// Returns the fewest digits after the point that identify magnitude, a
+// positive finite float, among its neighbours, or -1 if more than
+// MAX_SCORE_PRECISION are needed. The digits for d decimals name the float
+// if they lie closer to it than half the gap to the next float either side.
+static int shortest_precision(float magnitude)
+{
+    double value = magnitude;
+    double gap_up = (double)nextafterf(magnitude, INFINITY) - value;
+    double gap_down = value - (double)nextafterf(magnitude, 0.0f);
+
+    for (int digits = 0; digits <= MAX_SCORE_PRECISION; digits++)
+    {
+        double scaled = value * powers_of_ten[digits];
+        if (scaled >= MAX_SCALED_SCORE)
+            return -1;
+        double q = (double)round_scaled(scaled);
+        if (q >= scaled ? q - scaled < gap_up / 2 * powers_of_ten[digits]
+                        : scaled - q < gap_down / 2 * powers_of_ten[digits])
+            return digits;
+    }
+    return -1;
+}
+
+// A float has 24 significant bits and 10^9 = 2^9 * 5^9 needs 21 more, so the
+// scaled value below is exact in a double. Its integer part and the rest are
+// then exact too, and rounding them matches printf's rounding of the exact
+// binary value digit for digit.
+size_t format_score(float score, int precision, char* out)
+{
+    int digits = precision;
+    double magnitude = fabs((double)score);
+    char* p = out;
+
+    if (!std::isfinite(score))
+        return (size_t)snprintf(out, MAX_SCORE_TEXT, "%f", (double)score);
+    if (precision == SCORE_PRECISION_SHORTEST)
+    {
+        digits = score == 0.0f ? 0 : shortest_precision((float)magnitude);
+        if (digits < 0)
+            return (size_t)snprintf(out, MAX_SCORE_TEXT, "%.9g", (double)score);
+    }
+    double scaled = magnitude * powers_of_ten[digits];
+    if (scaled >= MAX_SCALED_SCORE)
+        return (size_t)snprintf(out, MAX_SCORE_TEXT, "%.*f", digits, (double)score);
+
+    uint64_t q = round_scaled(scaled);
+    uint64_t whole = q / (uint64_t)powers_of_ten[digits];
+    uint64_t fraction = q % (uint64_t)powers_of_ten[digits];
+    char text[24];
+    size_t length = 0;
+
+    if (std::signbit(score))
+        *p++ = '-';
+    do
+    {
+        text[length++] = (char)('0' + whole % 10);
+        whole /= 10;
+    } while (whole > 0);
+    while (length > 0)
+        *p++ = text[--length];
+    if (digits > 0)
+    {
+        *p++ = '.';
+        for (int i = digits - 1; i >= 0; i--)
+        {
+            p[i] = (char)('0' + fraction % 10);
+            fraction /= 10;
+        }
+        p += digits;
+    }
+    return (size_t)(p - out);
+}
+
+text_writer::text_writer(FILE* file, int precision)
+    : m_file(file), m_precision(precision),
+      m_buffer(TEXT_WRITER_BUFFER_SIZE), m_used(0), m_failed(false)
+{
+}
+
+void text_writer::set_file(FILE* file)
+{
+    m_file = file;
+}
+
+void text_writer::drain()
+{
+    if (m_used > 0 && fwrite(&m_buffer[0], 1, m_used, m_file) != m_used)
+        m_failed = true;
+    m_used = 0;
+}
+
+void text_writer::reserve(size_t size)
+{
+    if (m_buffer.size() - m_used < size)
+        drain();
+}
+
+void text_writer::write(const void* data, size_t size)
+{
+    if (size >= m_buffer.size())
+    {
+        drain();
+        if (fwrite(data, 1, size, m_file) != size)
+            m_failed = true;
+        return;
+    }
+    reserve(size);
+    memcpy(&m_buffer[m_used], data, size);
+    m_used += size;
+}
+
+void text_writer::put_model_id(const model_id_t& id)
+{
+    reserve(MAX_SCORE_TEXT);
+    m_used += (size_t)snprintf(
+        &m_buffer[m_used], MAX_SCORE_TEXT, "D%05d.%03d", id.major, id.minor);
+}
+
+void text_writer::put_score(float score)
+{
+    reserve(MAX_SCORE_TEXT);
+    m_used += format_score(score, m_precision, &m_buffer[m_used]);
+}
+
+// Hands everything buffered to the file and flushes it. Returns non-zero if
+// any write since the last flush failed.
+int text_writer::flush()
+{
+    bool failed;
+    drain();
+    failed = m_failed || fflush(m_file) != 0;
+    m_failed = false;
+    return failed ? 1 : 0;
+}
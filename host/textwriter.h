@@ -0,0 +1,54 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdio.h>
+#include <vector>
+#include "../shared.h"
+
+// Digits after the decimal point of text scores. The default gives the same
+// text as printf("%f"); SCORE_PRECISION_SHORTEST gives the fewest digits, up
+// to MAX_SCORE_PRECISION, that read back as the same float.
+#define DEFAULT_SCORE_PRECISION 6
+#define MAX_SCORE_PRECISION 9
+#define SCORE_PRECISION_SHORTEST -1
+
+#define TEXT_WRITER_BUFFER_SIZE (1024 * 1024)
+
+// text_writer formats tab separated score text into a buffer of its own and
+// hands it to the file in TEXT_WRITER_BUFFER_SIZE writes. Nothing reaches the
+// file before flush() unless the buffer fills up.
+class text_writer
+{
+  private:
+    FILE* m_file;
+    int m_precision;
+    std::vector<char> m_buffer;
+    size_t m_used;
+    bool m_failed; // a write to the file failed; reported by flush()
+
+  public:
+    text_writer(FILE* file = NULL, int precision = DEFAULT_SCORE_PRECISION);
+    void set_file(FILE* file);
+    void put(char c)
+    {
+        if (m_used == m_buffer.size())
+            drain();
+        m_buffer[m_used++] = c;
+    }
+    void write(const void* data, size_t size);
+    void put_model_id(const model_id_t& id);
+    void put_score(float score);
+    int flush();
+
+  private:
+    void reserve(size_t size);
+    void drain();
+};
+
+// Formats score as text_writer does into out, which must hold
+// MAX_SCORE_TEXT bytes, and returns the length written (no terminator)
+#define MAX_SCORE_TEXT 64
+size_t format_score(float score, int precision, char* out);
@@ -0,0 +1,62 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#ifndef _SCORERING_H
+#define _SCORERING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include "shared.h"
+
+// Resident scoring workers. A host thread enters the enclave once with
+// ecall_scoreworker and stays there, taking score requests from a ring in
+// host memory and putting completions on a second ring, until the host sets
+// stop. Requests are submitted and completions reaped without a transition;
+// a worker that finds nothing to do spins for a while and then waits in
+// hcall_ringidle until the host submits more.
+//
+// Each ring has one producer and one consumer: the host submits requests
+// and the worker takes them; the worker completes them and the host reaps
+// them. The host keeps at most SCORE_RING_SLOTS requests in flight, so the
+// completion ring cannot overflow. Everything in the ring is written by the
+// host, so the worker copies each request in and checks it before use.
+#define SCORE_RING_SLOTS 16
+#define SCORE_RING_SPIN 4096 // empty polls before a worker waits on the host
+
+// Scores the sequences at spans[0..count) with models [firstmodel,
+// firstmodel + modelcount) of modelset, writing row r of the scores at
+// scores + r * stride
+typedef struct _score_request
+{
+    uint64_t tag;
+    size_t modelset;
+    size_t firstmodel;
+    size_t modelcount;
+    const seq_span_t* spans;
+    size_t count;
+    float* scores;
+    size_t stride;
+} score_request_t;
+
+// result is as from ecall_scoremodels: the sequences scored, or -1
+typedef struct _score_completion
+{
+    uint64_t tag;
+    int result;
+    size_t badpos;
+} score_completion_t;
+
+struct score_ring
+{
+    std::atomic<uint64_t> submit_head; // requests taken, by the worker
+    std::atomic<uint64_t> submit_tail; // requests submitted, by the host
+    std::atomic<uint64_t> done_head;   // completions reaped, by the host
+    std::atomic<uint64_t> done_tail;   // completions made, by the worker
+    std::atomic<uint32_t> stop;        // set by the host to end the worker
+    std::atomic<uint32_t> waiting;     // the worker is in hcall_ringidle
+    score_request_t requests[SCORE_RING_SLOTS];
+    score_completion_t completions[SCORE_RING_SLOTS];
+};
+
+#endif /* _SCORERING_H */
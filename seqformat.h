@@ -0,0 +1,398 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#ifndef _SEQFORMAT_H
+#define _SEQFORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Sequence text comes in one of three formats, told apart by the first
+// character of the text that is not a newline:
+//   lines  one sequence per line
+//   FASTA  a '>' header line, then sequence lines up to the next header;
+//          lines starting with ';' are comments, and the file may start
+//          with them
+//   FASTQ  a '@' header line, sequence lines, a '+' line, then quality lines
+//          until they hold as many characters as the sequence
+// Blanks (space, tab, carriage return) in sequence text are not bases. A
+// record without bases, such as a blank line, is skipped. The name of a
+// FASTA or FASTQ record is its header line up to the first blank, without
+// the '>' or '@'.
+//
+// The host and the enclave both parse sequence text with seq_text_parser,
+// so that they count and number records the same way.
+#define SEQ_FORMAT_UNKNOWN 0
+#define SEQ_FORMAT_LINES 1
+#define SEQ_FORMAT_FASTA 2
+#define SEQ_FORMAT_FASTQ 3
+
+// Record names longer than this are cut short
+#define MAX_RECORD_NAME_SIZE 255
+
+// Scans over sequence text. With SSE2 they test 16 bytes at a time; the
+// enclave's C library has no vectorised memchr, and inlined they also beat
+// a library call on the short lines of FASTA files.
+#if defined(__SSE2__)
+static inline int seq_blank_mask(__m128i v)
+{
+    __m128i blank = _mm_or_si128(
+        _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+        _mm_or_si128(
+            _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')),
+            _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+    return _mm_movemask_epi8(blank);
+}
+#endif
+
+static inline bool seq_is_blank(unsigned char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// Returns the first newline in data[0..size), or NULL if there is none
+static inline const unsigned char* seq_find_newline(const unsigned char* data, size_t size)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, newline));
+        if (mask != 0)
+            return data + i + __builtin_ctz((unsigned int)mask);
+    }
+#endif
+    for (; i < size; i++)
+    {
+        if (data[i] == '\n')
+            return data + i;
+    }
+    return NULL;
+}
+
+// Returns the offset of the first blank in data[0..size), or size
+static inline size_t seq_find_blank(const unsigned char* data, size_t size)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 16 <= size; i += 16)
+    {
+        int mask = seq_blank_mask(_mm_loadu_si128((const __m128i*)(data + i)));
+        if (mask != 0)
+            return i + (size_t)__builtin_ctz((unsigned int)mask);
+    }
+#endif
+    for (; i < size; i++)
+    {
+        if (seq_is_blank(data[i]))
+            return i;
+    }
+    return size;
+}
+
+// Returns the first newline in data[0..size), or NULL if there is none, and
+// sets *bases to the number of characters before it that are not blanks.
+// Sequence and quality lines are split and counted in this one pass.
+static inline const unsigned char* seq_scan_line(
+    const unsigned char* data,
+    size_t size,
+    size_t* bases)
+{
+    size_t blanks = 0;
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        unsigned int lines = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline));
+        unsigned int blank = (unsigned int)seq_blank_mask(v);
+        if (lines != 0)
+        {
+            unsigned int end = (unsigned int)__builtin_ctz(lines);
+            blanks += (size_t)__builtin_popcount(blank & ((1u << end) - 1));
+            *bases = i + end - blanks;
+            return data + i + end;
+        }
+        blanks += (size_t)__builtin_popcount(blank);
+    }
+#endif
+    for (; i < size; i++)
+    {
+        if (data[i] == '\n')
+        {
+            *bases = i - blanks;
+            return data + i;
+        }
+        blanks += seq_is_blank(data[i]) ? 1 : 0;
+    }
+    *bases = size - blanks;
+    return NULL;
+}
+
+// seq_text_parser splits sequence text into records, regardless of how the
+// text is cut into pieces. It hands each piece of a record to a sink:
+//   int bases(const unsigned char* data, size_t size)
+//       sequence text of the current record, with any blanks in it
+//   int record(uint64_t start, const char* name)
+//       the record is complete; start is the offset of its first line in
+//       the text and name its name, or NULL in the lines format
+// A non-zero return value from the sink stops parsing and is returned to
+// the caller. Malformed text makes parse() and finish() return -1.
+class seq_text_parser
+{
+  private:
+    enum line_kind
+    {
+        LINE_BASES,
+        LINE_NAME,
+        LINE_SKIP,
+        LINE_QUALITY
+    };
+    enum fastq_phase
+    {
+        PHASE_HEADER,
+        PHASE_SEQUENCE,
+        PHASE_QUALITY
+    };
+
+    int m_format;
+    line_kind m_line;
+    fastq_phase m_phase;
+    bool m_line_start;   // the next character starts a line
+    bool m_in_name;      // the name on the header line is not over yet
+    bool m_in_record;
+    uint64_t m_offset;   // text parsed so far
+    uint64_t m_record_start;
+    uint64_t m_bases;    // bases in the current record
+    uint64_t m_quality;  // FASTQ quality characters in the current record
+    size_t m_name_size;
+    char m_name[MAX_RECORD_NAME_SIZE + 1];
+
+    void start_record(uint64_t start)
+    {
+        m_in_record = true;
+        m_record_start = start;
+        m_bases = 0;
+        m_quality = 0;
+        m_name_size = 0;
+    }
+
+    template <typename Sink>
+    int end_record(Sink& sink)
+    {
+        bool scored = m_in_record && m_bases > 0;
+        m_in_record = false;
+        m_bases = 0;
+        m_quality = 0;
+        m_name[m_name_size] = '\0';
+        return scored ? sink.record(m_record_start, named() ? m_name : NULL) : 0;
+    }
+
+    // Picks the kind of the line starting with c at offset start. Returns
+    // non-zero if the sink stopped at the end of the previous record or the
+    // line cannot appear here.
+    template <typename Sink>
+    int begin_line(unsigned char c, uint64_t start, Sink& sink)
+    {
+        int ret = 0;
+        if (m_format == SEQ_FORMAT_UNKNOWN)
+            m_format = c == '>' || c == ';' ? SEQ_FORMAT_FASTA
+                               : c == '@' ? SEQ_FORMAT_FASTQ : SEQ_FORMAT_LINES;
+        switch (m_format)
+        {
+            case SEQ_FORMAT_FASTA:
+                if (c == '>')
+                {
+                    ret = end_record(sink);
+                    if (ret != 0)
+                        return ret;
+                    start_record(start);
+                    m_line = LINE_NAME;
+                    m_in_name = true;
+                }
+                else if (c == ';')
+                    m_line = LINE_SKIP;
+                else if (!m_in_record)
+                    return -1;
+                else
+                    m_line = LINE_BASES;
+                break;
+            case SEQ_FORMAT_FASTQ:
+                if (m_phase == PHASE_HEADER)
+                {
+                    if (c != '@')
+                        return -1;
+                    start_record(start);
+                    m_line = LINE_NAME;
+                    m_in_name = true;
+                    m_phase = PHASE_SEQUENCE;
+                }
+                else if (m_phase == PHASE_SEQUENCE && c == '+')
+                {
+                    m_line = LINE_SKIP;
+                    m_phase = PHASE_QUALITY;
+                }
+                else
+                    m_line = m_phase == PHASE_QUALITY ? LINE_QUALITY : LINE_BASES;
+                break;
+            default:
+                start_record(start);
+                m_line = LINE_BASES;
+                break;
+        }
+        return 0;
+    }
+
+    // Ends the current line; a line ends a lines-format record, and the
+    // quality line that matches the sequence length ends a FASTQ record
+    template <typename Sink>
+    int end_line(Sink& sink)
+    {
+        m_line_start = true;
+        if (m_format == SEQ_FORMAT_LINES)
+            return end_record(sink);
+        if (m_format == SEQ_FORMAT_FASTQ && m_phase == PHASE_QUALITY &&
+            m_line != LINE_BASES && m_quality >= m_bases)
+        {
+            m_phase = PHASE_HEADER;
+            return end_record(sink);
+        }
+        return 0;
+    }
+
+  public:
+    seq_text_parser()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        m_format = SEQ_FORMAT_UNKNOWN;
+        m_line = LINE_SKIP;
+        m_phase = PHASE_HEADER;
+        m_line_start = true;
+        m_in_name = false;
+        m_in_record = false;
+        m_offset = 0;
+        m_record_start = 0;
+        m_bases = 0;
+        m_quality = 0;
+        m_name_size = 0;
+    }
+
+    int format() const
+    {
+        return m_format;
+    }
+
+    bool named() const
+    {
+        return m_format == SEQ_FORMAT_FASTA || m_format == SEQ_FORMAT_FASTQ;
+    }
+
+    // Parses data[0..size). If used is given, it receives the number of
+    // bytes parsed, which is less than size if the sink stopped early;
+    // parsing can continue from there.
+    template <typename Sink>
+    int parse(const unsigned char* data, size_t size, Sink& sink, size_t* used = NULL)
+    {
+        size_t pos = 0;
+        int ret = 0;
+
+        while (pos < size)
+        {
+            if (m_line_start)
+            {
+                if (data[pos] == '\n')
+                {
+                    // an empty line
+                    pos++;
+                    ret = m_format == SEQ_FORMAT_UNKNOWN ? 0 : end_line(sink);
+                    if (ret != 0)
+                        break;
+                    continue;
+                }
+                ret = begin_line(data[pos], m_offset + pos, sink);
+                if (ret != 0)
+                    break;
+                m_line_start = false;
+                if (m_line == LINE_NAME)
+                    pos++; // the '>' or '@'
+            }
+
+            const unsigned char* start = data + pos;
+            const unsigned char* newline = NULL;
+            size_t line_bases = 0;
+            if (m_line == LINE_BASES || m_line == LINE_QUALITY)
+                newline = seq_scan_line(start, size - pos, &line_bases);
+            else
+                newline = seq_find_newline(start, size - pos);
+            size_t len = newline ? (size_t)(newline - start) : size - pos;
+
+            switch (m_line)
+            {
+                case LINE_BASES:
+                    m_bases += line_bases;
+                    ret = len > 0 ? sink.bases(start, len) : 0;
+                    break;
+                case LINE_NAME:
+                    for (size_t i = 0; i < len && m_in_name; i++)
+                    {
+                        m_in_name = !seq_is_blank(start[i]);
+                        if (m_in_name && m_name_size < MAX_RECORD_NAME_SIZE)
+                            m_name[m_name_size++] = (char)start[i];
+                    }
+                    break;
+                case LINE_QUALITY:
+                    m_quality += line_bases;
+                    break;
+                default:
+                    break;
+            }
+            if (ret != 0)
+            {
+                pos += len;
+                break;
+            }
+            pos += len;
+            if (newline)
+            {
+                pos++;
+                ret = end_line(sink);
+                if (ret != 0)
+                    break;
+            }
+        }
+
+        m_offset += pos;
+        if (used)
+            *used = pos;
+        return ret;
+    }
+
+    // Completes the last record at the end of the text
+    template <typename Sink>
+    int finish(Sink& sink)
+    {
+        int ret = 0;
+        if (!m_line_start)
+        {
+            ret = end_line(sink);
+            if (ret != 0)
+                return ret;
+        }
+        if (m_format == SEQ_FORMAT_FASTQ && m_phase != PHASE_HEADER)
+            return -1;
+        return end_record(sink);
+    }
+};
+
+#endif /* _SEQFORMAT_H */
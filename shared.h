@@ -1,49 +1,206 @@
-// Copyright (c) Open Enclave SDK contributors.
-// Licensed under the MIT License.
-
-#ifndef _ARGS_H
-#define _ARGS_H
-
-#define HASH_VALUE_SIZE_IN_BYTES 32 // sha256 hashing algorithm
-#define ENCRYPTION_KEY_SIZE 256     // AES256-CBC encryption algorithm
-#define ENCRYPTION_KEY_SIZE_IN_BYTES (ENCRYPTION_KEY_SIZE / 8)
-#define IV_SIZE 16 // determined by AES256-CBC
-#define SALT_SIZE_IN_BYTES IV_SIZE
-#define MAX_SEQ_SIZE 1024
-
-// encryption_header_t contains encryption metadata used for decryption
-// file_data_size: this is the size of the data in an input file, excluding the
-// header digest: this field contains hash value of a password
-// encrypted_key: this is the encrypted version of the encryption key used for
-//                encrypting and decrypting the data
-// salt: The salt value used in deriving the password key.
-//       It is also used as the IV for the encryption/decryption of the data.
-typedef struct _encryption_header
-{
-    size_t file_data_size;
-    unsigned char digest[HASH_VALUE_SIZE_IN_BYTES];
-    unsigned char encrypted_key[ENCRYPTION_KEY_SIZE_IN_BYTES];
-    unsigned char salt[SALT_SIZE_IN_BYTES];
-} encryption_header_t;
-
-typedef struct {
-	int major;
-	int minor;
-} model_id_t;
-
-typedef struct {
-	model_id_t id;
-	int reverse_complement;
-	int num_detectors;
-	int detector_len;
-	int has_avg_pooling;
-	int num_hidden;
-	float* detectors;
-	float* thresholds;
-	float* weights1;
-	float* biases1;
-	float* weights2;
-	float* biases2;
-} deepbind_model_t;
-
-#endif /* _ARGS_H */
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#ifndef _ARGS_H
+#define _ARGS_H
+
+#define HASH_VALUE_SIZE_IN_BYTES 32 // sha256 hashing algorithm
+#define ENCRYPTION_KEY_SIZE 256     // AES256-CBC encryption algorithm
+#define ENCRYPTION_KEY_SIZE_IN_BYTES (ENCRYPTION_KEY_SIZE / 8)
+#define IV_SIZE 16 // determined by AES256-CBC
+#define SALT_SIZE_IN_BYTES IV_SIZE
+#define MAX_SEQ_SIZE 1024
+#define CIPHER_BLOCK_SIZE 16 // AES block size; CBC input must be a multiple
+
+// Streaming ecalls take [user_check] host buffers of up to
+// MAX_STREAM_CHUNK_SIZE bytes, copying each chunk into enclave memory once.
+#define DEFAULT_STREAM_CHUNK_SIZE (4 * 1024 * 1024)
+#define MAX_STREAM_CHUNK_SIZE (16 * 1024 * 1024)
+
+#define ENCRYPTION_HEADER_MAGIC 0x42445853 // "SXDB"
+#define ENCRYPTION_HEADER_VERSION 5
+
+// PBKDF2-HMAC-SHA256 iterations used to derive the password key. The count is
+// stored in each header, so it can be tuned per deployment.
+#define DEFAULT_KDF_ITERATIONS 100000
+#define MIN_KDF_ITERATIONS 1000
+#define MAX_KDF_ITERATIONS 10000000
+
+// encryption_header_t flags
+#define ENCRYPTION_FLAG_PACKED 0x1 // data holds packed sequence records
+#define ENCRYPTION_FLAG_STREAMED 0x2 // sizes are in the trailer (see below)
+
+// encryption_header_t contains encryption metadata used for decryption
+// magic, version: identify the file format; checked before decryption
+// flags: ENCRYPTION_FLAG_* values describing the encrypted data
+// index_stride: records between record index entries (see below)
+// kdf_iterations: PBKDF2 iterations used to derive the password key
+// file_data_size: this is the size of the data in an input file, excluding the
+// header
+// record_count: number of records in the data
+// index_offset: offset of the encrypted record index from the end of the
+//               header, i.e. the size of the padded encrypted data
+// index_entries: number of entries in the record index
+// digest: this field contains hash value of a password
+// encrypted_key: this is the encrypted version of the encryption key used for
+//                encrypting and decrypting the data
+// salt: per file random value used as the IV for the encrypted key and for
+//       the encryption/decryption of the data.
+// kdf_salt: The salt value used in deriving the password key. It is shared by
+//           the files encrypted in one enclave session, so the password key is
+//           derived once per session rather than once per file.
+// data_mac: HMAC-SHA256 of the padded plaintext of the data (not the record
+//           index), computed by the enclave while encrypting. Its key is
+//           derived from the data key, so it reveals nothing about the
+//           plaintext to anyone without the password.
+typedef struct _encryption_header
+{
+    unsigned int magic;
+    unsigned int version;
+    unsigned int flags;
+    unsigned int index_stride;
+    unsigned int kdf_iterations;
+    unsigned int reserved;
+    size_t file_data_size;
+    size_t record_count;
+    size_t index_offset;
+    size_t index_entries;
+    unsigned char digest[HASH_VALUE_SIZE_IN_BYTES];
+    unsigned char encrypted_key[ENCRYPTION_KEY_SIZE_IN_BYTES];
+    unsigned char salt[SALT_SIZE_IN_BYTES];
+    unsigned char kdf_salt[SALT_SIZE_IN_BYTES];
+    unsigned char data_mac[HASH_VALUE_SIZE_IN_BYTES];
+} encryption_header_t;
+
+// A file written to a pipe goes out before its size is known. Its header has
+// ENCRYPTION_FLAG_STREAMED set and file_data_size, record_count, index_offset,
+// index_entries and data_mac left zero; the encrypted data is followed by an
+// encryption_trailer_t instead of a record index.
+// magic: ENCRYPTION_TRAILER_MAGIC
+// file_data_size, record_count, data_mac: as in the header; the MAC covers
+//           the padding, so the data length it implies is authenticated too
+#define ENCRYPTION_TRAILER_MAGIC 0x4c525453 // "STRL"
+typedef struct _encryption_trailer
+{
+    unsigned int magic;
+    unsigned int reserved;
+    size_t file_data_size;
+    size_t record_count;
+    unsigned char data_mac[HASH_VALUE_SIZE_IN_BYTES];
+} encryption_trailer_t;
+
+// Packed sequence records (ENCRYPTION_FLAG_PACKED) store each base in 2 bits
+// instead of an ASCII byte. Each record is laid out as
+//   uint32 length      number of bases
+//   uint32 runs        number of runs of unknown ('N') bases
+//   runs x { uint32 start, uint32 length }
+//   (length + 3) / 4 bytes of 2-bit base indices, first base in the low bits;
+//   bases inside an 'N' run are stored as 0
+// All integers are little endian.
+#define PACKED_RECORD_HEADER_SIZE 8
+#define PACKED_RUN_SIZE 8
+#define MAX_PACKED_RECORD_LENGTH (1u << 30)
+
+// The record index follows the encrypted data and is encrypted with the same
+// key, continuing its CBC chain. Entry i is the little endian uint64 plaintext
+// offset of record i * index_stride; entries are zero padded to a whole cipher
+// block. Because CBC decryption of a block only needs the ciphertext block
+// before it, any record can be reached by decrypting from the block holding
+// the nearest entry at or before it.
+#define RECORD_INDEX_STRIDE 1024
+#define RECORD_INDEX_ENTRY_SIZE 8
+
+// Sealed scores. After ecall_sealscores, the score rows of a session (one
+// float per model, little endian) are kept in the enclave and leave it in
+// chunks of up to SEALED_CHUNK_SIZE bytes, each encrypted with AES-256-GCM
+// under a key derived from the data key of the file being scored. A chunk is
+// a sealed_chunk_header_t followed by size bytes of ciphertext.
+// flags: SEALED_CHUNK_LAST marks the final chunk of a run, which may be empty
+// rows, columns: score rows in the chunk and models per row
+// nonce: the GCM nonce
+// sequence: chunk number within the run, so that chunks cannot be dropped or
+//           reordered unnoticed
+// tag: GCM tag; everything before it in the header is authenticated too
+#define SEALED_CHUNK_SIZE (1024 * 1024)
+#define SEALED_CHUNK_MAGIC 0x4b484353 // "SCHK"
+#define SEALED_CHUNK_LAST 0x1
+#define SEALED_NONCE_SIZE 12
+#define SEALED_TAG_SIZE 16
+typedef struct _sealed_chunk_header
+{
+    unsigned int magic;
+    unsigned int flags;
+    unsigned int rows;
+    unsigned int columns;
+    unsigned int size;
+    unsigned char nonce[SEALED_NONCE_SIZE];
+    unsigned long long sequence;
+    unsigned char tag[SEALED_TAG_SIZE];
+} sealed_chunk_header_t;
+
+// A sealed score file starts with a sealed_scores_header_t holding a copy of
+// the header of the scored file, from which the enclave recovers the key,
+// then columns model_id_t values naming the models, then the chunks.
+#define SEALED_SCORES_MAGIC 0x53435853 // "SXCS"
+#define SEALED_SCORES_VERSION 1
+typedef struct _sealed_scores_header
+{
+    unsigned int magic;
+    unsigned int version;
+    unsigned int columns;
+    unsigned int reserved;
+    encryption_header_t key;
+} sealed_scores_header_t;
+
+// framer_stats_t reports the progress of the in-enclave record framer over
+// the file being decrypted
+// records: complete records scored so far
+// bytes: plaintext bytes consumed so far
+// carry: bytes of an unfinished record held in the enclave for the next chunk
+typedef struct _framer_stats
+{
+    size_t records;
+    size_t bytes;
+    size_t carry;
+} framer_stats_t;
+
+typedef struct {
+	int major;
+	int minor;
+} model_id_t;
+
+// A sequence in host memory for ecall_scorebatch, which copies it into the
+// enclave. A batch holds at most MAX_SCORE_BATCH sequences.
+#define MAX_SCORE_BATCH 4096
+typedef struct _seq_span
+{
+    const unsigned char* data;
+    size_t size;
+} seq_span_t;
+
+// What ecall_benchmark times, for the host's bench operation
+// BENCH_ECALL: nothing; the ecall returns at once
+// BENCH_OCALL: one empty ocall per iteration
+// BENCH_APPLY_MODEL: one model applied to the whole sequence as one window
+// BENCH_SCAN_MODEL: one model scanned over the sequence, as scoring does
+#define BENCH_ECALL 0
+#define BENCH_OCALL 1
+#define BENCH_APPLY_MODEL 2
+#define BENCH_SCAN_MODEL 3
+
+typedef struct {
+	model_id_t id;
+	int reverse_complement;
+	int num_detectors;
+	int detector_len;
+	int has_avg_pooling;
+	int num_hidden;
+	float* detectors;
+	float* thresholds;
+	float* weights1;
+	float* biases1;
+	float* weights2;
+	float* biases2;
+} deepbind_model_t;
+
+#endif /* _ARGS_H */